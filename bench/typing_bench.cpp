@@ -0,0 +1,405 @@
+// Замер цикла набора без терминала: синтетические или записанные нажатия
+// прогоняются через TypingEngine с NullRenderer и RecordingRenderer
+#include "typing_engine.h"
+#include "null_renderer.h"
+#include "recording_renderer.h"
+#include "text_provider.h"
+#include "keyboard_layout.h"
+#include "keystroke_log.h"
+#include "text_stream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Доля ошибочных нажатий в синтетическом потоке
+    const double DEFAULT_ERROR_RATE = 0.05;
+    // Нажатий в одном раунде длинного текста: дальше ESC и новый документ
+    const uint64_t LONG_TEXT_ROUND_KEYS = 100000;
+
+    // Нажатия из заранее подготовленного массива; ожидания нет никогда
+    class ReplayInput : public InputSource
+    {
+    public:
+        void reset(const std::vector<wint_t> &keys, size_t first)
+        {
+            keys_ = &keys;
+            pos_ = first;
+        }
+
+        bool waitChar(wint_t &ch, int /* timeout_ms */) override
+        {
+            // Поток кончился раньше текста - выходим из раунда
+            ch = pos_ < keys_->size() ? (*keys_)[pos_++] : 27;
+            return true;
+        }
+
+        size_t consumed() const { return pos_; }
+
+    private:
+        const std::vector<wint_t> *keys_ = nullptr;
+        size_t pos_ = 0;
+    };
+
+    // Нажатия для длинного текста: символы документа читает второй поток по тому же корпусу
+    // (перенос на последовательность символов не влияет), ошибки - как в generateKeys.
+    // После limit нажатий или в конце документа - ESC
+    class StreamInput : public InputSource
+    {
+    public:
+        StreamInput(const TextProvider &provider, double error_rate)
+            : stream_(provider), mistake_(error_rate), gen_(42) {}
+
+        void reset(size_t first_line, uint64_t limit)
+        {
+            stream_.reset(first_line);
+            line_.chars.clear();
+            pos_ = 0;
+            pending_ = 0;
+            consumed_ = 0;
+            limit_ = limit;
+        }
+
+        bool waitChar(wint_t &ch, int /* timeout_ms */) override
+        {
+            ch = 27;
+            if (consumed_ >= limit_)
+                return true;
+            if (pending_)
+            {
+                ch = pending_;
+                pending_ = 0;
+            }
+            else
+            {
+                if (pos_ >= line_.length())
+                {
+                    if (!stream_.nextLine(TypingEngine::STREAM_MAX_WIDTH, line_))
+                        return true;
+                    pos_ = 0;
+                }
+                wint_t c = static_cast<wint_t>(line_.chars[pos_++]);
+                ch = c;
+                if (mistake_(gen_))
+                {
+                    ch = c + 1 == 27 ? 'x' : c + 1;
+                    pending_ = c;
+                }
+            }
+            consumed_++;
+            return true;
+        }
+
+        uint64_t consumed() const { return consumed_; }
+
+    private:
+        TextStream stream_;
+        DecodedText line_;
+        size_t pos_ = 0;
+        wint_t pending_ = 0;
+        uint64_t consumed_ = 0;
+        uint64_t limit_ = 0;
+        std::bernoulli_distribution mistake_;
+        std::mt19937 gen_;
+    };
+
+    // Один раунд: текст и нажатия, которые его наберут
+    struct Round
+    {
+        DecodedText text;
+        std::vector<wint_t> keys;
+    };
+
+    bool isExitKey(wint_t c)
+    {
+        return c == 27 || c == 'q' || c == 'Q';
+    }
+
+    // Нажатия для текста: правильный символ, перед которым с вероятностью error_rate идет ошибочный
+    void generateKeys(const DecodedText &text, double error_rate, std::mt19937 &gen, std::vector<wint_t> &keys)
+    {
+        std::bernoulli_distribution mistake(error_rate);
+        keys.clear();
+        for (wchar_t c : text.chars)
+        {
+            if (mistake(gen))
+            {
+                wint_t wrong = static_cast<wint_t>(c) + 1;
+                if (isExitKey(wrong))
+                    wrong = 'x';
+                keys.push_back(wrong);
+            }
+            keys.push_back(static_cast<wint_t>(c));
+        }
+    }
+
+    // Раунды из журнала нажатий: текст восстанавливается по ожидаемым символам,
+    // нажатия берутся как были. Прерванные сессии пропускаются
+    std::vector<Round> loadReplay(const std::string &filename)
+    {
+        std::vector<Round> rounds;
+        FILE *file = std::fopen(filename.c_str(), "rb");
+        if (!file)
+        {
+            throw std::runtime_error("Не удалось открыть журнал " + filename);
+        }
+
+        std::map<uint64_t, std::pair<std::wstring, std::vector<wint_t>>> sessions;
+        KeystrokeBlockHeader header;
+        while (std::fread(&header, sizeof(header), 1, file) == 1)
+        {
+            if (std::memcmp(header.magic, "KLOG", 4) != 0)
+                break;
+
+            std::vector<KeystrokeEvent> events(header.event_count);
+            if (std::fread(events.data(), sizeof(KeystrokeEvent), events.size(), file) != events.size())
+                break;
+
+            auto &[chars, keys] = sessions[header.session_id];
+            chars.resize(header.text_length, L' ');
+            for (const KeystrokeEvent &event : events)
+            {
+                if (event.position < chars.size())
+                    chars[event.position] = static_cast<wchar_t>(event.expected);
+                keys.push_back(event.actual);
+            }
+
+            if (header.flags & KeystrokeLog::KEYSTROKE_BLOCK_LAST)
+            {
+                if (!(header.flags & KeystrokeLog::KEYSTROKE_BLOCK_ABORTED) && !chars.empty())
+                {
+                    Round round;
+                    std::string utf8;
+                    encodeUtf8(chars, utf8);
+                    round.text.assign(utf8);
+                    round.keys = std::move(keys);
+                    rounds.push_back(std::move(round));
+                }
+                sessions.erase(header.session_id);
+            }
+        }
+        std::fclose(file);
+        return rounds;
+    }
+
+    struct Result
+    {
+        uint64_t keys = 0;
+        uint64_t rounds = 0;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        double seconds = 0;
+        // Задержка от ввода до конца сброса кадра по данным движка
+        uint64_t p50_ns = 0;
+        uint64_t p99_ns = 0;
+    };
+
+    void clearOutput(NullRenderer &) {}
+    void clearOutput(RecordingRenderer &renderer) { renderer.clearOutput(); }
+
+    // Прогоняет раунды по кругу, пока не наберется target нажатий
+    template <typename RendererT>
+    Result run(RendererT &renderer, const std::vector<Round> &rounds, uint64_t target)
+    {
+        LatencyProfile latency;
+        TypingEngine engine(renderer, nullptr, &latency);
+        ReplayInput input;
+        Result result;
+
+        auto start = Clock::now();
+        for (size_t i = 0; result.keys < target; i = (i + 1) % rounds.size())
+        {
+            const Round &round = rounds[i];
+            const KeyboardLayout &layout = KeyboardLayout::forText(round.text.chars);
+
+            engine.begin(round.text, layout, round.keys[0], Clock::now());
+            input.reset(round.keys, 1);
+            engine.run(input);
+            clearOutput(renderer);
+
+            result.keys += input.consumed();
+            result.rounds++;
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const LatencyHistogram &total = latency.histogram(LatencyProfile::STAGE_TOTAL);
+        result.p50_ns = total.percentile(0.5);
+        result.p99_ns = total.percentile(0.99);
+        return result;
+    }
+
+    // Длинный текст: раунды по LONG_TEXT_ROUND_KEYS нажатий с разных абзацев корпуса
+    template <typename RendererT>
+    Result runLongText(RendererT &renderer, const TextProvider &provider, double error_rate, uint64_t target)
+    {
+        LatencyProfile latency;
+        TypingEngine engine(renderer, nullptr, &latency);
+        TextStream stream(provider);
+        StreamInput input(provider, error_rate);
+        std::mt19937 gen(7);
+        std::uniform_int_distribution<size_t> pick(0, provider.size() - 1);
+        DecodedText paragraph;
+        Result result;
+
+        auto start = Clock::now();
+        while (result.keys < target)
+        {
+            size_t first_line = pick(gen);
+            stream.reset(first_line);
+            input.reset(first_line, std::min(LONG_TEXT_ROUND_KEYS, target - result.keys));
+            wint_t first_key;
+            input.waitChar(first_key, -1);
+            provider.getText(first_line, paragraph);
+            const KeyboardLayout &layout = KeyboardLayout::forText(paragraph.chars);
+
+            engine.begin(stream, layout, first_key, Clock::now());
+            engine.run(input);
+            clearOutput(renderer);
+
+            result.keys += input.consumed();
+            result.rounds++;
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const LatencyHistogram &total = latency.histogram(LatencyProfile::STAGE_TOTAL);
+        result.p50_ns = total.percentile(0.5);
+        result.p99_ns = total.percentile(0.99);
+        return result;
+    }
+
+    void printResult(const char *renderer, const std::string &source, const Result &result, bool bytes)
+    {
+        double ns_per_key = result.seconds * 1e9 / result.keys;
+        std::printf("%-10s %-10s %10llu нажатий %8llu раундов %8.3f с %12.0f нажатий/с %8.1f нс/нажатие"
+                    " p50 %6llu нс p99 %6llu нс",
+                    renderer, source.c_str(),
+                    static_cast<unsigned long long>(result.keys),
+                    static_cast<unsigned long long>(result.rounds),
+                    result.seconds, result.keys / result.seconds, ns_per_key,
+                    static_cast<unsigned long long>(result.p50_ns),
+                    static_cast<unsigned long long>(result.p99_ns));
+        if (bytes)
+        {
+            std::printf(" %7.1f байт/нажатие", static_cast<double>(result.bytes) / result.keys);
+        }
+        std::printf("\n");
+    }
+
+    void bench(const std::string &source, const std::vector<Round> &rounds, uint64_t target)
+    {
+        if (rounds.empty())
+        {
+            std::cerr << source << ": нет раундов" << std::endl;
+            return;
+        }
+
+        NullRenderer null_renderer;
+        printResult("null", source, run(null_renderer, rounds, target), false);
+
+        RecordingRenderer recording;
+        Result result = run(recording, rounds, target);
+        result.frames = recording.getFrameCount();
+        result.bytes = recording.getTotalBytes();
+        printResult("recording", source, result, true);
+    }
+
+    void benchLongText(const std::string &filename, double error_rate, uint64_t target)
+    {
+        TextProvider provider(filename);
+        if (provider.size() == 0)
+        {
+            std::cerr << filename << ": нет текстов" << std::endl;
+            return;
+        }
+        std::string source = "long:" + TextProvider::getLanguageFromFile(filename);
+
+        NullRenderer null_renderer;
+        printResult("null", source, runLongText(null_renderer, provider, error_rate, target), false);
+
+        RecordingRenderer recording;
+        Result result = runLongText(recording, provider, error_rate, target);
+        result.frames = recording.getFrameCount();
+        result.bytes = recording.getTotalBytes();
+        printResult("recording", source, result, true);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t total_keys = 10000000;
+    double error_rate = DEFAULT_ERROR_RATE;
+    std::vector<std::string> replays;
+    std::vector<std::string> long_texts;
+    std::vector<std::string> corpora = {"data/english.txt", "data/russian.txt"};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+            total_keys = std::stoull(argv[++i]);
+        else if (std::strcmp(argv[i], "--error-rate") == 0 && i + 1 < argc)
+            error_rate = std::stod(argv[++i]);
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replays.push_back(argv[++i]);
+        else if (std::strcmp(argv[i], "--long-text") == 0 && i + 1 < argc)
+            long_texts.push_back(argv[++i]);
+        else
+        {
+            std::cerr << "Использование: " << argv[0]
+                      << " [--keys N] [--error-rate P] [--replay stats/<язык>_keystrokes.bin]"
+                      << " [--long-text <корпус>]" << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        // Нажатия делятся поровну между источниками
+        if (!long_texts.empty())
+        {
+            for (const std::string &corpus : long_texts)
+            {
+                benchLongText(corpus, error_rate, total_keys / long_texts.size());
+            }
+            return 0;
+        }
+        size_t sources = replays.empty() ? corpora.size() : replays.size();
+        uint64_t per_source = total_keys / sources;
+
+        if (replays.empty())
+        {
+            std::mt19937 gen(42);
+            for (const std::string &corpus : corpora)
+            {
+                TextProvider provider(corpus);
+                std::vector<Round> rounds(std::min<size_t>(provider.size(), 1000));
+                for (Round &round : rounds)
+                {
+                    provider.getRandomText(round.text);
+                    generateKeys(round.text, error_rate, gen, round.keys);
+                }
+                bench(TextProvider::getLanguageFromFile(corpus), rounds, per_source);
+            }
+        }
+        else
+        {
+            for (const std::string &replay : replays)
+            {
+                bench(replay, loadReplay(replay), per_source);
+            }
+        }
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,506 @@
+// Самопроверка без терминала (make check): обработка нажатия не выделяет память, а форматы
+// на диске проходят круг записи и чтения. Файлы статистики создаются во временном каталоге,
+// корпуса только читаются. Код возврата 1 - хотя бы одна проверка не прошла
+#include "alloc_counter.h"
+#include "corpus_ingest.h"
+#include "history_chart.h"
+#include "keyboard_layout.h"
+#include "keystroke_log.h"
+#include "null_renderer.h"
+#include "recording_renderer.h"
+#include "stats_store.h"
+#include "stats_summary.h"
+#include "stats_writer.h"
+#include "text_provider.h"
+#include "typing_engine.h"
+#include "word_sampler.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Доля ошибочных нажатий в потоке проверки выделений, как в typing_bench
+    const double ERROR_RATE = 0.05;
+    // Раундов на корпус: первый проход прогревает буферы, выделения считаются со второго
+    const size_t ROUNDS = 200;
+    // Выборок при проверке таблицы псевдонимов и допуск по доле слова
+    const int SAMPLES = 1000000;
+    const double SAMPLE_TOLERANCE = 0.005;
+
+    int g_failures = 0;
+    // Записи моложе окна сжатия, иначе StatsWriter свернет их при первой же записи
+    const int64_t g_base = std::time(nullptr) - 3600;
+
+    void expect(bool ok, const std::string &what)
+    {
+        std::printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+        if (!ok)
+            ++g_failures;
+    }
+
+    void writeFile(const std::string &filename, std::string_view data)
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+        if (!file)
+            throw std::runtime_error("Не удалось записать " + filename);
+    }
+
+    SessionStats makeRecord(int i)
+    {
+        SessionStats record{};
+        record.timestamp = g_base + i * 60;
+        record.cpm = 150.0 + 7.25 * i;
+        record.accuracy = 90.0 + (i % 10);
+        record.errors = i % 4;
+        record.total_chars = 40 + i;
+        record.duration = 20 + i % 7;
+        record.session_id = 1000 + i;
+        return record;
+    }
+
+    bool sameRecord(const SessionStats &a, const SessionStats &b)
+    {
+        return a.timestamp == b.timestamp && a.cpm == b.cpm && a.accuracy == b.accuracy &&
+               a.errors == b.errors && a.total_chars == b.total_chars && a.duration == b.duration;
+    }
+
+    // CRC-32 (IEEE, как у zlib) побитно, независимо от таблицы StatsWriter
+    uint32_t referenceCrc32(const std::string &bytes)
+    {
+        uint32_t crc = 0xFFFFFFFFu;
+        for (unsigned char c : bytes)
+        {
+            crc ^= c;
+            for (int k = 0; k < 8; ++k)
+                crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        return ~crc;
+    }
+
+    std::string walFrame(const SessionStats &record, const std::string &text, bool corrupt)
+    {
+        StatsWalFrame frame{};
+        std::memcpy(frame.magic, "TWAL", 4);
+        frame.record = record;
+        frame.text_length = static_cast<uint32_t>(text.size());
+        std::string payload(reinterpret_cast<const char *>(&frame.record), sizeof(frame.record));
+        frame.checksum = referenceCrc32(payload + text) ^ (corrupt ? 1u : 0u);
+        return std::string(reinterpret_cast<const char *>(&frame), sizeof(frame)) + text;
+    }
+
+    void appendFile(const std::string &filename, const std::string &data)
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::app);
+        file.write(data.data(), data.size());
+    }
+
+    // Нажатия для текста: правильный символ, перед которым с вероятностью ERROR_RATE идет ошибочный
+    void generateKeys(const DecodedText &text, std::mt19937 &gen, std::vector<wint_t> &keys)
+    {
+        std::bernoulli_distribution mistake(ERROR_RATE);
+        keys.clear();
+        for (wchar_t c : text.chars)
+        {
+            if (mistake(gen))
+            {
+                wint_t wrong = static_cast<wint_t>(c) + 1;
+                keys.push_back(wrong == 27 || wrong == 'q' || wrong == 'Q' ? 'x' : wrong);
+            }
+            keys.push_back(static_cast<wint_t>(c));
+        }
+    }
+
+    class ReplayInput : public InputSource
+    {
+    public:
+        void reset(const std::vector<wint_t> &keys, size_t first)
+        {
+            keys_ = &keys;
+            pos_ = first;
+        }
+
+        bool waitChar(wint_t &ch, int /* timeout_ms */) override
+        {
+            ch = pos_ < keys_->size() ? (*keys_)[pos_++] : 27;
+            return true;
+        }
+
+    private:
+        const std::vector<wint_t> *keys_ = nullptr;
+        size_t pos_ = 0;
+    };
+
+    // Раунды корпуса через движок с журналом нажатий и замером задержек, как в сессии
+    template <typename RendererT>
+    void checkAllocations(RendererT &renderer, const char *name, const std::string &corpus)
+    {
+        TextProvider provider(corpus);
+        std::mt19937 gen(42);
+        std::vector<DecodedText> texts(std::min<size_t>(provider.size(), ROUNDS));
+        std::vector<std::vector<wint_t>> keys(texts.size());
+        for (size_t i = 0; i < texts.size(); ++i)
+        {
+            provider.getText(i, texts[i]);
+            generateKeys(texts[i], gen, keys[i]);
+        }
+
+        KeystrokeLog log("check");
+        LatencyProfile latency;
+        TypingEngine engine(renderer, &log, &latency);
+        ReplayInput input;
+        uint64_t keystrokes = 0;
+        uint64_t allocations = 0;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            uint64_t keys_before = engine.keystrokeCount();
+            uint64_t allocations_before = engine.keystrokeAllocations();
+            for (size_t i = 0; i < texts.size(); ++i)
+            {
+                if (keys[i].empty())
+                    continue;
+                engine.begin(texts[i], KeyboardLayout::forText(texts[i].chars), keys[i][0], Clock::now());
+                input.reset(keys[i], 1);
+                engine.run(input);
+                // Сервер отправляет и убирает вывод после каждого чтения; здесь - после раунда
+                if constexpr (std::is_same_v<RendererT, RecordingRenderer>)
+                    renderer.clearOutput();
+            }
+            keystrokes = engine.keystrokeCount() - keys_before;
+            allocations = engine.keystrokeAllocations() - allocations_before;
+        }
+
+        expect(keystrokes > 0 && allocations == 0,
+               std::string("нажатия без выделений памяти (") + name + ", " +
+                   TextProvider::getLanguageFromFile(corpus) + "): " + std::to_string(allocations) +
+                   " выделений на " + std::to_string(keystrokes) + " нажатий");
+    }
+
+    // Журнал предзаписи: кадры переносятся в хранилище, повтор сессии отбрасывается,
+    // а кадр с неверной контрольной суммой и все за ним отрезаются
+    void checkWal()
+    {
+        const std::string key = "wal";
+        StatsWriter &writer = StatsWriter::shared();
+        writer.submit(key, makeRecord(0), "alpha");
+        writer.submit(key, makeRecord(1), "beta");
+        writer.flush();
+        writer.submit(key, makeRecord(0), "alpha");
+        writer.flush();
+        {
+            StatsStore store(key);
+            expect(store.size() == 2 && sameRecord(store.at(0), makeRecord(0)) &&
+                       sameRecord(store.at(1), makeRecord(1)) && store.loadText(store.at(1)) == "beta",
+                   "журнал: записи и тексты перенесены, повтор сессии отброшен");
+        }
+
+        std::string wal = StatsWriter::getWalFilename(key);
+        uint64_t valid_end = std::filesystem::file_size(wal) + sizeof(StatsWalFrame) + 5;
+        appendFile(wal, walFrame(makeRecord(2), "gamma", false) + walFrame(makeRecord(3), "delta", true) +
+                            walFrame(makeRecord(4), "omega", false));
+        writer.refreshSummary(key);
+        writer.flush();
+
+        StatsStore store(key);
+        expect(store.size() == 3 && sameRecord(store.at(2), makeRecord(2)) && store.loadText(store.at(2)) == "gamma",
+               "журнал: кадр с верной CRC32 перенесен при восстановлении");
+        expect(std::filesystem::file_size(wal) == valid_end && store.walApplied() == valid_end,
+               "журнал: хвост с неверной CRC32 отрезан");
+        StatsSummary summary(key);
+        expect(summary.count() == 3, "журнал: сводка пересчитана после восстановления");
+    }
+
+    // Хранилище версии 1 (записи по 48 байт без session_id) переписывается в версию 2
+    void checkStoreUpgrade()
+    {
+        struct SessionStatsV1
+        {
+            int64_t timestamp;
+            double cpm;
+            double accuracy;
+            uint32_t errors;
+            uint32_t total_chars;
+            uint32_t duration;
+            uint32_t text_length;
+            uint64_t text_offset;
+        };
+        static_assert(sizeof(SessionStatsV1) == 48, "SessionStatsV1 must stay 48 bytes");
+
+        const std::string key = "v1";
+        std::vector<SessionStatsV1> old(3);
+        std::string texts;
+        for (size_t i = 0; i < old.size(); ++i)
+        {
+            SessionStats record = makeRecord(static_cast<int>(i));
+            std::string text = "text " + std::to_string(i);
+            old[i] = {record.timestamp, record.cpm, record.accuracy, record.errors, record.total_chars,
+                      record.duration, static_cast<uint32_t>(text.size()), texts.size()};
+            texts += text;
+        }
+        StatsStoreHeader header{};
+        std::memcpy(header.magic, "TSTB", 4);
+        header.version = 1;
+        header.record_size = sizeof(SessionStatsV1);
+        header.record_count = old.size();
+        header.blob_size = texts.size();
+        header.first_timestamp = old.front().timestamp;
+        header.last_timestamp = old.back().timestamp;
+        writeFile(StatsStore::getStoreFilename(key),
+                  std::string(reinterpret_cast<const char *>(&header), sizeof(header)) +
+                      std::string(reinterpret_cast<const char *>(old.data()), old.size() * sizeof(SessionStatsV1)));
+        writeFile(StatsStore::getTextsFilename(key), texts);
+
+        StatsStore store(key);
+        bool same = store.size() == old.size() && store.header().version == StatsStore::FORMAT_VERSION;
+        for (size_t i = 0; same && i < old.size(); ++i)
+        {
+            same = sameRecord(store.at(i), makeRecord(static_cast<int>(i))) && store.at(i).session_id == 0 &&
+                   store.loadText(store.at(i)) == "text " + std::to_string(i);
+        }
+        expect(same, "хранилище: версия 1 переписана в версию 2 без потерь");
+    }
+
+    // Выгрузка в CSV и перенос обратно: значения без потерь, повтор строки переносится один раз
+    void checkCsvImport()
+    {
+        std::ostringstream csv;
+        {
+            StatsStore source("csv_source");
+            for (int i = 0; i < 4; ++i)
+                source.append(makeRecord(i), i == 2 ? "with \"quotes\", comma" : "text " + std::to_string(i));
+            source.exportCsv(csv);
+        }
+        std::string lines = csv.str();
+        std::string first_line = lines.substr(0, lines.find('\n') + 1);
+        writeFile(StatsStore::getCsvFilename("csv"), lines + first_line);
+
+        // Новое хранилище переносит CSV при первом открытии
+        StatsStore store("csv");
+        bool same = store.size() == 4;
+        for (size_t i = 0; same && i < store.size(); ++i)
+            same = sameRecord(store.at(i), makeRecord(static_cast<int>(i)));
+        expect(same, "CSV: перенос сохраняет значения, повтор строки отброшен");
+        expect(same && store.loadText(store.at(2)) == "with \"quotes\", comma", "CSV: текст с кавычками и запятой");
+    }
+
+    // Сводка: после sync совпадает со средним и дисперсией в два прохода, перечитывается
+    // с диска как есть, а испорченная пересчитывается
+    void checkSummary()
+    {
+        const std::string key = "summary";
+        const int count = 50;
+        StatsStore store(key);
+        for (int i = 0; i < count; ++i)
+            store.append(makeRecord(i), "x");
+
+        double mean = 0;
+        for (int i = 0; i < count; ++i)
+            mean += makeRecord(i).cpm / count;
+        double variance = 0;
+        for (int i = 0; i < count; ++i)
+            variance += (makeRecord(i).cpm - mean) * (makeRecord(i).cpm - mean) / (count - 1);
+
+        StatsSummary summary(key);
+        summary.sync(store);
+        const StatsSummaryData &data = summary.data();
+        expect(data.record_count == static_cast<uint64_t>(count) && std::fabs(data.cpm.mean - mean) < 1e-9 &&
+                   std::fabs(data.cpm.variance(count) - variance) < 1e-6 * variance &&
+                   data.cpm.min == makeRecord(0).cpm && data.cpm.max == makeRecord(count - 1).cpm,
+               "сводка: среднее и дисперсия сходятся с подсчетом в два прохода");
+
+        StatsSummary reloaded(key);
+        expect(reloaded.catchUp(store) && std::memcmp(&reloaded.data(), &data, sizeof(data)) == 0,
+               "сводка: файл перечитывается без изменений");
+
+        // Число записей в файле не сходится с историей - сводка не годится и пересчитывается
+        std::string filename = StatsSummary::getSummaryFilename(key);
+        int fd = open(filename.c_str(), O_WRONLY | O_CLOEXEC);
+        uint64_t wrong = count + 7;
+        bool corrupted = fd >= 0 &&
+                         pwrite(fd, &wrong, sizeof(wrong), offsetof(StatsSummaryData, record_count)) ==
+                             static_cast<ssize_t>(sizeof(wrong));
+        if (fd >= 0)
+            close(fd);
+        StatsSummary stale(key);
+        bool rejected = corrupted && !stale.catchUp(store);
+        stale.sync(store);
+        expect(rejected && stale.count() == static_cast<uint64_t>(count) && std::fabs(stale.data().cpm.mean - mean) < 1e-9,
+               "сводка: испорченный файл отвергнут и пересчитан");
+    }
+
+    // LTTB: столбцов не больше ширины, огибающая min/max точная, а в столбце со всплеском
+    // выбран узел, который его содержит
+    void checkDownsampling()
+    {
+        const size_t points = 10000;
+        const size_t columns = 80;
+        const size_t spike = 4321;
+        auto baseline = [](size_t i) { return 200.0f + 50.0f * std::sin(i * 0.01f); };
+        HistoryChart chart;
+        float lowest = 1e9f;
+        float highest = 0;
+        for (size_t i = 0; i < points; ++i)
+        {
+            float value = i == spike ? 2000.0f : baseline(i);
+            lowest = std::min(lowest, value);
+            highest = std::max(highest, value);
+            chart.append(value, 1, value, value);
+        }
+
+        std::vector<HistoryChart::Column> out;
+        chart.downsample(0, points, columns, out);
+        float out_min = 1e9f;
+        float out_max = 0;
+        bool last_marked = !out.empty() && out.back().last;
+        for (size_t c = 0; c < out.size(); ++c)
+        {
+            out_min = std::min(out_min, out[c].min);
+            out_max = std::max(out_max, out[c].max);
+            last_marked = last_marked && (c + 1 == out.size() || !out[c].last);
+        }
+        expect(!out.empty() && out.size() <= columns && last_marked,
+               "график: не больше столбца на колонку, последняя точка в последнем столбце");
+        expect(out_min == lowest && out_max == highest, "график: огибающая min/max точная");
+
+        bool spike_chosen = false;
+        for (size_t c = 0; c < out.size(); ++c)
+        {
+            if (out[c].max != 2000.0f)
+                continue;
+            float neighbours = 0;
+            for (size_t i = c * points / out.size(); i < (c + 1) * points / out.size(); ++i)
+                neighbours = std::max(neighbours, i == spike ? 0.0f : baseline(i));
+            spike_chosen = out[c].value > neighbours;
+        }
+        expect(spike_chosen, "график: в столбце со всплеском LTTB выбирает узел со всплеском");
+
+        chart.downsample(0, 10, columns, out);
+        bool exact = out.size() == 10;
+        for (size_t i = 0; exact && i < out.size(); ++i)
+            exact = out[i].value == baseline(i);
+        expect(exact, "график: короткий ряд выводится без прореживания");
+    }
+
+    // Таблица псевдонимов: доли выборки сходятся с частотами списка слов
+    void checkAliasSampling(const std::string &corpus)
+    {
+        std::filesystem::create_directories("data/words");
+        writeFile(WordSampler::getWordsFilename("check"), "alpha 1\nbeta 2\ngamma 3\ndelta 10\nepsilon 84\n");
+        TextProvider provider(corpus);
+        WordSampler sampler(provider, "check");
+
+        std::vector<int> hits(sampler.size());
+        std::mt19937_64 gen(7);
+        for (int i = 0; i < SAMPLES; ++i)
+            hits[sampler.sample(gen)]++;
+
+        uint64_t total = 0;
+        for (size_t word = 0; word < sampler.size(); ++word)
+            total += sampler.count(word);
+        double worst = 0;
+        for (size_t word = 0; word < sampler.size(); ++word)
+        {
+            double expected = static_cast<double>(sampler.count(word)) / total;
+            worst = std::max(worst, std::fabs(static_cast<double>(hits[word]) / SAMPLES - expected));
+        }
+        expect(sampler.size() == 5 && worst < SAMPLE_TOLERANCE,
+               "слова: доли выборки по таблице псевдонимов, худшее отклонение " + std::to_string(worst));
+    }
+
+    // Пополнение корпуса: повторы, символы не с раскладки и предложения вне длины отбрасываются
+    void checkIngest()
+    {
+        writeFile("raw.txt",
+                  "The quick brown fox jumps over the lazy dog.\n\n"
+                  "Pack my box with five dozen liquor jugs, please.\n\n"
+                  "The quick brown fox jumps over the lazy dog.\n\n"
+                  "Too short.\n\n"
+                  "This sentence has a Cyrillic word, \xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, inside it.\n");
+        CorpusIngest ingest(KeyboardLayout::qwerty(), CorpusIngest::DEFAULT_MIN_LENGTH, CorpusIngest::DEFAULT_MAX_LENGTH, 2);
+        CorpusIngest::Stats stats = ingest.run({"raw.txt"}, "data/ingested.txt");
+
+        std::ifstream file("data/ingested.txt");
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(file, line);)
+            lines.push_back(line);
+        expect(stats.sentences == 5 && stats.duplicates == 1 && stats.dropped_layout == 1 &&
+                   stats.dropped_length == 1 && stats.written == 2 && lines.size() == 2,
+               "корпус: " + std::to_string(stats.written) + " из " + std::to_string(stats.sentences) +
+                   " предложений, повторов " + std::to_string(stats.duplicates) + ", не по раскладке " +
+                   std::to_string(stats.dropped_layout) + ", не по длине " + std::to_string(stats.dropped_length));
+        expect(TextProvider("data/ingested.txt").size() == 2, "корпус: индекс строк построен вместе с корпусом");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> corpora;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+            corpora.push_back(argv[++i]);
+        else
+        {
+            std::cerr << "Использование: " << argv[0] << " [--corpus <корпус>]..." << std::endl;
+            return 1;
+        }
+    }
+    if (corpora.empty())
+        corpora = {"data/english.txt", "data/russian.txt"};
+    for (std::string &corpus : corpora)
+        corpus = std::filesystem::absolute(corpus).string();
+
+    // Статистика пишется по относительным путям stats/..., поэтому работаем во временном каталоге
+    char directory[] = "/tmp/typing-check.XXXXXX";
+    if (!mkdtemp(directory) || chdir(directory) != 0)
+    {
+        std::cerr << "Не удалось создать временный каталог" << std::endl;
+        return 1;
+    }
+    std::filesystem::create_directories("data");
+
+    try
+    {
+        expect(alloc_counter::ENABLED, "подсчет выделений включен (сборка с -DTYPING_COUNT_ALLOCATIONS)");
+        for (const std::string &corpus : corpora)
+        {
+            NullRenderer null_renderer;
+            checkAllocations(null_renderer, "null", corpus);
+            RecordingRenderer recording;
+            checkAllocations(recording, "recording", corpus);
+        }
+        checkWal();
+        checkStoreUpgrade();
+        checkCsvImport();
+        checkSummary();
+        checkDownsampling();
+        checkAliasSampling(corpora.front());
+        checkIngest();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        ++g_failures;
+    }
+
+    std::error_code ignored;
+    std::filesystem::remove_all(directory, ignored);
+    std::printf("%s: %d ошибок\n", g_failures ? "FAIL" : "ok", g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,345 @@
+// Нагрузочный клиент сервера: сотни печатающих клиентов в одном цикле epoll.
+// Каждый разбирает экран старта, набирает текст с заданной скоростью и долей ошибок
+// и замеряет, через сколько после нажатия приходит ответный кадр
+#include "server_protocol.h"
+#include "latency_histogram.h"
+#include "decoded_text.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Маркеры экранов сервера
+    const std::string START_PROMPT = "Нажмите любую клавишу для начала";
+    const std::string RESULTS_PROMPT = "Нажмите ENTER для продолжения";
+
+    struct Options
+    {
+        std::string socket = DEFAULT_SERVER_SOCKET;
+        int clients = 200;
+        double seconds = 10;
+        double cpm = 300;
+        double error_rate = 0.03;
+        std::string language = "english";
+    };
+
+    enum class State
+    {
+        WaitStart,
+        Typing,
+        WaitResults
+    };
+
+    struct Typist
+    {
+        int fd = -1;
+        State state = State::WaitStart;
+        std::string received;
+        std::wstring text;
+        size_t position = 0;
+        bool mistake = false;              // следующим уйдет ошибочный символ
+        Clock::time_point next_key{};      // когда назначено следующее нажатие
+        Clock::time_point sent_at{};       // когда ушло нажатие, ждущее ответа
+        bool waiting_reply = false;
+    };
+
+    struct Totals
+    {
+        uint64_t keys = 0;
+        uint64_t rounds = 0;
+        uint64_t reconnects = 0;
+        LatencyHistogram latency;
+    };
+
+    int connectTo(const Options &options)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.socket.c_str(), sizeof(address.sun_path) - 1);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            throw std::runtime_error("Не удалось подключиться к " + options.socket);
+        }
+
+        ServerHello hello{};
+        std::memcpy(hello.magic, "TSRV", 4);
+        hello.version = SERVER_PROTOCOL_VERSION;
+        hello.flags = SERVER_HELLO_NO_STATS;
+        hello.rows = 40;
+        hello.cols = 120;
+        std::strncpy(hello.language, options.language.c_str(), sizeof(hello.language) - 1);
+        if (write(fd, &hello, sizeof(hello)) != sizeof(hello))
+        {
+            throw std::runtime_error("Сервер закрыл соединение");
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+
+    // Текст на экране старта - вторая центрированная строка после очистки экрана:
+    // ESC[2J, затем у каждой строки ESC[K ESC[y;xH и сам текст
+    bool parseStartText(const std::string &screen, std::wstring &text)
+    {
+        size_t pos = screen.rfind("\x1b[2J");
+        if (pos == std::string::npos)
+            return false;
+        for (int line = 0; line < 2; ++line)
+        {
+            pos = screen.find("\x1b[K", pos);
+            if (pos == std::string::npos)
+                return false;
+            pos += 3;
+        }
+        pos = screen.find('H', pos);
+        if (pos == std::string::npos)
+            return false;
+        size_t end = screen.find('\x1b', pos + 1);
+        decodeUtf8(std::string_view(screen).substr(pos + 1, end - pos - 1), text);
+        return !text.empty();
+    }
+
+    // RSS процесса сервера: его pid известен из SO_PEERCRED
+    long serverRssKb(int fd)
+    {
+        ucred cred{};
+        socklen_t length = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0)
+            return -1;
+        std::ifstream status("/proc/" + std::to_string(cred.pid) + "/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+                return std::stol(line.substr(6));
+        }
+        return -1;
+    }
+
+    bool sendKey(Typist &typist, wchar_t key)
+    {
+        std::string bytes;
+        encodeUtf8(std::wstring_view(&key, 1), bytes);
+        return write(typist.fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (flag == "--socket")
+            options.socket = argv[i + 1];
+        else if (flag == "--clients")
+            options.clients = std::stoi(argv[i + 1]);
+        else if (flag == "--seconds")
+            options.seconds = std::stod(argv[i + 1]);
+        else if (flag == "--cpm")
+            options.cpm = std::stod(argv[i + 1]);
+        else if (flag == "--error-rate")
+            options.error_rate = std::stod(argv[i + 1]);
+        else if (flag == "--language")
+            options.language = argv[i + 1];
+        else
+        {
+            std::cerr << "Использование: " << argv[0]
+                      << " [--socket путь] [--clients N] [--seconds S] [--cpm C] [--error-rate P] [--language язык]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        std::vector<Typist> typists(options.clients);
+        Totals totals;
+        std::mt19937 gen(7);
+        std::bernoulli_distribution mistake(options.error_rate);
+        // Интервал между нажатиями со случайным разбросом +-50%
+        auto interval = std::chrono::duration<double>(60.0 / options.cpm);
+        std::uniform_real_distribution<double> jitter(0.5, 1.5);
+
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        auto attach = [&](size_t index)
+        {
+            Typist &typist = typists[index];
+            typist = Typist();
+            typist.fd = connectTo(options);
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = index;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, typist.fd, &event);
+        };
+
+        // Память сервера до и после подключения всех клиентов
+        int probe = connectTo(options);
+        long rss_before = serverRssKb(probe);
+        close(probe);
+
+        for (size_t i = 0; i < typists.size(); ++i)
+        {
+            attach(i);
+        }
+
+        // Очередь следующих нажатий: (момент, клиент)
+        using Event = std::pair<Clock::time_point, size_t>;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> schedule;
+        auto scheduleNext = [&](size_t index, Clock::time_point now)
+        {
+            auto delay = std::chrono::duration_cast<Clock::duration>(interval * jitter(gen));
+            typists[index].next_key = now + delay;
+            schedule.push({now + delay, index});
+        };
+
+        auto start = Clock::now();
+        auto stop = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+        long rss_loaded = -1;
+        epoll_event events[256];
+
+        while (Clock::now() < stop)
+        {
+            auto now = Clock::now();
+            int timeout = 100;
+            if (!schedule.empty())
+            {
+                auto left = std::chrono::ceil<std::chrono::milliseconds>(schedule.top().first - now).count();
+                timeout = static_cast<int>(std::max<long long>(0, std::min<long long>(left, timeout)));
+            }
+
+            int count = epoll_wait(epoll_fd, events, 256, timeout);
+            now = Clock::now();
+            for (int e = 0; e < count; ++e)
+            {
+                size_t index = events[e].data.u64;
+                Typist &typist = typists[index];
+                char buffer[8192];
+                ssize_t n;
+                bool closed = false;
+                while ((n = read(typist.fd, buffer, sizeof(buffer))) > 0)
+                {
+                    typist.received.append(buffer, n);
+                }
+                if (n == 0 || (n < 0 && errno != EAGAIN))
+                    closed = true;
+
+                if (typist.waiting_reply)
+                {
+                    typist.waiting_reply = false;
+                    totals.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - typist.sent_at).count());
+                }
+
+                if (closed)
+                {
+                    // Сервер закрыл сессию (например, в тексте встретилась Q): подключаемся заново
+                    close(typist.fd);
+                    totals.reconnects++;
+                    attach(index);
+                    continue;
+                }
+
+                if (typist.state == State::WaitStart && typist.received.find(START_PROMPT) != std::string::npos)
+                {
+                    if (parseStartText(typist.received, typist.text))
+                    {
+                        typist.state = State::Typing;
+                        typist.position = 0;
+                        typist.received.clear();
+                        scheduleNext(index, now);
+                    }
+                }
+                else if (typist.state == State::WaitResults && typist.received.find(RESULTS_PROMPT) != std::string::npos)
+                {
+                    totals.rounds++;
+                    typist.state = State::WaitStart;
+                    typist.received.clear();
+                    sendKey(typist, L'\r');
+                }
+                else if (typist.state == State::Typing)
+                {
+                    typist.received.clear();
+                }
+            }
+
+            // Нажатия, срок которых наступил
+            while (!schedule.empty() && schedule.top().first <= now)
+            {
+                auto [schedule_time, index] = schedule.top();
+                schedule.pop();
+                Typist &typist = typists[index];
+                // Запись от прошлого подключения клиента
+                if (typist.state != State::Typing || typist.next_key != schedule_time)
+                    continue;
+
+                wchar_t expected = typist.text[typist.position];
+                wchar_t key = expected;
+                if (typist.mistake || !mistake(gen))
+                {
+                    typist.mistake = false;
+                    typist.position++;
+                }
+                else
+                {
+                    key = expected == L'~' ? L'`' : L'~';
+                    typist.mistake = true;
+                }
+
+                typist.sent_at = now;
+                typist.waiting_reply = true;
+                sendKey(typist, key);
+                totals.keys++;
+
+                if (typist.position >= typist.text.size())
+                    typist.state = State::WaitResults;
+                else
+                    scheduleNext(index, now);
+            }
+
+            if (rss_loaded < 0 && now - start > std::chrono::seconds(1))
+            {
+                rss_loaded = serverRssKb(typists[0].fd);
+            }
+        }
+
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("Клиентов: %d, %.1f с, скорость %.0f сим/мин, ошибок %.0f%%\n",
+                    options.clients, elapsed, options.cpm, options.error_rate * 100);
+        std::printf("Нажатий: %llu (%.0f/с), раундов: %llu, переподключений: %llu\n",
+                    static_cast<unsigned long long>(totals.keys), totals.keys / elapsed,
+                    static_cast<unsigned long long>(totals.rounds),
+                    static_cast<unsigned long long>(totals.reconnects));
+        std::printf("Отклик сервера: p50 %.1f мкс, p99 %.1f мкс, max %.1f мкс\n",
+                    totals.latency.percentile(0.5) / 1000.0, totals.latency.percentile(0.99) / 1000.0,
+                    totals.latency.max() / 1000.0);
+        if (rss_before > 0 && rss_loaded > 0)
+        {
+            std::printf("Память сервера: %ld КБ без клиентов, %ld КБ с клиентами, %.1f КБ на клиента\n",
+                        rss_before, rss_loaded, static_cast<double>(rss_loaded - rss_before) / options.clients);
+        }
+
+        for (Typist &typist : typists)
+            close(typist.fd);
+        close(epoll_fd);
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
+}
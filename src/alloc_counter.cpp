@@ -0,0 +1,42 @@
+#include "alloc_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef TYPING_COUNT_ALLOCATIONS
+
+namespace
+{
+    std::atomic<uint64_t> g_allocations{0};
+
+    void *countedAlloc(std::size_t size)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        if (size == 0)
+            size = 1;
+        if (void *ptr = std::malloc(size))
+            return ptr;
+        throw std::bad_alloc();
+    }
+}
+
+void *operator new(std::size_t size) { return countedAlloc(size); }
+void *operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+uint64_t alloc_counter::count()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t alloc_counter::count()
+{
+    return 0;
+}
+
+#endif
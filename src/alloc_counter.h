@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Подсчет выделений памяти через глобальный operator new.
+// Включается сборкой с -DTYPING_COUNT_ALLOCATIONS (make ALLOC_COUNT=1)
+namespace alloc_counter
+{
+#ifdef TYPING_COUNT_ALLOCATIONS
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    // Количество вызовов operator new с начала работы (0, если подсчет выключен)
+    uint64_t count();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Начальное состояние FNV-1a
+constexpr uint64_t FNV1A_SEED = 0xCBF29CE484222325ull;
+
+// FNV-1a по байтам; hash - состояние после предыдущих байтов, чтобы хэшировать частями
+inline uint64_t fnv1a(const void *data, size_t size, uint64_t hash = FNV1A_SEED)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+// Запись size байт целиком, с повтором после частичной записи и прерывания сигналом
+inline bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *ptr = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = write(fd, ptr, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+// То же с позиции offset (pwrite), без сдвига позиции дескриптора
+inline bool writeAll(int fd, const void *data, size_t size, off_t offset)
+{
+    const char *ptr = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = pwrite(fd, ptr, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        ptr += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
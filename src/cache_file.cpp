@@ -0,0 +1,76 @@
+#include "cache_file.h"
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CacheFile::~CacheFile()
+{
+    if (data_)
+    {
+        munmap(data_, size_);
+    }
+}
+
+int CacheFile::openHeader(const std::string &filename, void *header, size_t header_size)
+{
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (pread(fd, header, header_size, 0) != static_cast<ssize_t>(header_size))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool CacheFile::mapFile(int fd, size_t header_size, uint64_t size)
+{
+    struct stat st;
+    if (size == 0 || fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != size)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return false;
+
+    data_ = ptr;
+    size_ = size;
+    cursor_ = header_size;
+    return true;
+}
+
+void CacheFile::write(const std::string &filename, const void *header, size_t header_size,
+                      std::initializer_list<Section> sections)
+{
+    static const char zeros[8] = {};
+
+    // Свое имя временного файла у каждого процесса: два первых запуска не пишут в один файл
+    std::string tmp = filename + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return;
+        file.write(static_cast<const char *>(header), header_size);
+        for (const Section &section : sections)
+        {
+            file.write(static_cast<const char *>(section.data), section.bytes);
+            file.write(zeros, padded(section.bytes) - section.bytes);
+        }
+        if (!file)
+        {
+            file.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
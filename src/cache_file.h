@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+
+// Кэш, производный от корпуса (<файл>.idx, .ngram, .markov, .difficulty): заголовок формата,
+// за ним массивы, каждый дополнен нулями до 8 байт. Заголовок начинается полями magic, version,
+// file_size и file_mtime_ns; кэш другого формата или другой версии корпуса не берется.
+// Кэш отображается в память целиком и живет, пока жив CacheFile
+class CacheFile
+{
+public:
+    // Формат кэша и корпус (размер и время изменения), для которого он нужен
+    struct Stamp
+    {
+        const char *magic; // 4 символа
+        uint32_t version;
+        uint64_t file_size;
+        int64_t file_mtime_ns;
+    };
+
+    // Массив для записи за заголовком
+    struct Section
+    {
+        const void *data;
+        size_t bytes;
+    };
+
+    CacheFile() = default;
+    ~CacheFile();
+
+    CacheFile(const CacheFile &) = delete;
+    CacheFile &operator=(const CacheFile &) = delete;
+
+    template <typename Header>
+    static void stamp(Header &header, const Stamp &stamp)
+    {
+        std::memcpy(header.magic, stamp.magic, 4);
+        header.version = stamp.version;
+        header.file_size = stamp.file_size;
+        header.file_mtime_ns = stamp.file_mtime_ns;
+    }
+
+    // Отображает filename, если его заголовок подходит под stamp и размер файла равен
+    // expected_size(header); expected_size возвращает 0, если не подходят остальные поля заголовка
+    template <typename Header, typename ExpectedSize>
+    bool map(const std::string &filename, const Stamp &stamp, Header &header, ExpectedSize &&expected_size)
+    {
+        int fd = openHeader(filename, &header, sizeof(header));
+        if (fd < 0)
+            return false;
+        bool matches = std::memcmp(header.magic, stamp.magic, 4) == 0 &&
+                       header.version == stamp.version &&
+                       header.file_size == stamp.file_size &&
+                       header.file_mtime_ns == stamp.file_mtime_ns;
+        return mapFile(fd, sizeof(header), matches ? expected_size(header) : 0);
+    }
+
+    bool mapped() const { return data_ != nullptr; }
+
+    // Следующий массив за заголовком, в том же порядке, в каком они записаны
+    template <typename T>
+    const T *next(size_t count)
+    {
+        const T *array = reinterpret_cast<const T *>(static_cast<const char *>(data_) + cursor_);
+        cursor_ += padded(count * sizeof(T));
+        return array;
+    }
+
+    // Размер массива в файле вместе с дополнением
+    static size_t padded(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+    // Записывает заголовок и массивы во временный файл и переименовывает его в filename.
+    // Кэш необязателен: если записать не удалось (например, каталог только для чтения),
+    // вызывающий работает с построенными в памяти данными
+    static void write(const std::string &filename, const void *header, size_t header_size,
+                      std::initializer_list<Section> sections);
+
+private:
+    // Дескриптор файла с прочитанным заголовком или -1
+    static int openHeader(const std::string &filename, void *header, size_t header_size);
+    // Отображает файл размером ровно size (0 - не отображать) и закрывает fd
+    bool mapFile(int fd, size_t header_size, uint64_t size);
+
+    void *data_ = nullptr;
+    size_t size_ = 0;
+    size_t cursor_ = 0;
+};
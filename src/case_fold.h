@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+// Пары регистров латиницы, Latin-1 и кириллицы, включая украинские Є, І, Ї и Ґ.
+// Таблицы не зависят от локали: раскладки из файлов, очистка корпуса и ключи кэша n-грамм
+// одинаковы в любом окружении. Одни функции для всех, чтобы регистр везде совпадал
+constexpr uint32_t simpleLower(uint32_t c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c + 0x20;
+    if (c >= 0xC0 && c <= 0xDE && c != 0xD7) // À-Þ без знака умножения
+        return c + 0x20;
+    if (c >= 0x410 && c <= 0x42F) // А-Я
+        return c + 0x20;
+    if (c >= 0x400 && c <= 0x40F) // Ѐ-Џ, в том числе Ё, Є, І, Ї
+        return c + 0x50;
+    if (c == 0x490) // Ґ
+        return 0x491;
+    return c;
+}
+
+constexpr uint32_t simpleUpper(uint32_t c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 0x20;
+    if (c >= 0xE0 && c <= 0xFE && c != 0xF7)
+        return c - 0x20;
+    if (c >= 0x430 && c <= 0x44F)
+        return c - 0x20;
+    if (c >= 0x450 && c <= 0x45F)
+        return c - 0x50;
+    if (c == 0x491)
+        return 0x490;
+    return c;
+}
@@ -1,9 +1,17 @@
 #include "console_handler.h"
+#include "startup_profile.h"
 #include <ncurses.h>
 #include <clocale>
+#include <langinfo.h>
 #include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
-ConsoleHandler::ConsoleHandler()
+ConsoleHandler::ConsoleHandler(bool count_bytes) : count_bytes_(count_bytes)
 {
     initializeConsole();
 }
@@ -13,12 +21,27 @@ ConsoleHandler::~ConsoleHandler()
     restoreConsole();
 }
 
-void ConsoleHandler::initializeConsole()
+void ConsoleHandler::initializeLocale()
 {
+    // UTF-8 принудительно, только если локаль окружения его не дает
     std::setlocale(LC_ALL, "");
-    std::setlocale(LC_CTYPE, "en_US.UTF-8");
+    if (std::strcmp(nl_langinfo(CODESET), "UTF-8") != 0)
+        std::setlocale(LC_CTYPE, "en_US.UTF-8");
+}
+
+void ConsoleHandler::initializeConsole()
+{
+    initializeLocale();
+    StartupProfile::shared().mark("локаль");
+
+    // ESC без долгого ожидания продолжения escape-последовательности
+    set_escdelay(25);
 
-    initscr();
+    openTerminalPipe();
+    screen_ = newterm(nullptr, stdout, stdin);
+    if (!screen_)
+        throw std::runtime_error("Не удалось инициализировать терминал");
+    set_term(screen_);
     raw();
     keypad(stdscr, TRUE);
     noecho();
@@ -27,6 +50,9 @@ void ConsoleHandler::initializeConsole()
 
     getmaxyx(stdscr, screen_height_, screen_width_);
 
+    // Запас под строки интерфейса, чтобы вывод не выделял память во время набора
+    wide_buffer_.reserve(1024);
+
     use_default_colors();
 
     init_pair(COLOR_PAIR_DEFAULT, COLOR_WHITE, -1);
@@ -37,40 +63,215 @@ void ConsoleHandler::initializeConsole()
 
     attron(COLOR_PAIR(COLOR_PAIR_DEFAULT));
     refresh();
+    drainTerminal();
+    StartupProfile::shared().mark("ncurses");
 }
 
 void ConsoleHandler::restoreConsole()
 {
     endwin();
+    drainTerminal();
+    delscreen(screen_);
+    screen_ = nullptr;
+    closeTerminalPipe();
+}
+
+// ncurses пишет экран write(2) прямо в дескриптор своего FILE, мимо stdio, поэтому счетчик
+// на самом FILE ничего бы не увидел. Для подсчета байт (--render-stats), если stdout и stderr -
+// терминал, stdout подменяется каналом: ncurses пишет в канал (режимы и размер терминала берет
+// у stderr), а вывод переносится в терминал через FILE с подсчетом байт. Переносит его основной
+// поток после каждого сброса экрана, чтобы байты попали в свой кадр, и отдельный поток, пока
+// основной ждет в write(): перерисовка, не поместившаяся в канал, не блокирует ncurses
+void ConsoleHandler::openTerminalPipe()
+{
+    if (!count_bytes_ || !isatty(STDOUT_FILENO) || !isatty(STDERR_FILENO))
+        return;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+        return;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    int tty_fd = dup(STDOUT_FILENO);
+    cookie_io_functions_t io = {nullptr, &ConsoleHandler::writeTerminal, nullptr, nullptr};
+    terminal_ = tty_fd >= 0 ? fopencookie(this, "w", io) : nullptr;
+    if (!terminal_)
+    {
+        if (tty_fd >= 0)
+            close(tty_fd);
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    std::fflush(stdout);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+    tty_fd_ = tty_fd;
+    pipe_fd_ = fds[0];
+    relay_ = std::thread(&ConsoleHandler::relayTerminal, this);
+}
+
+void ConsoleHandler::closeTerminalPipe()
+{
+    if (!terminal_)
+        return;
+    // Возврат терминала на stdout закрывает единственный пишущий конец канала:
+    // поток переноса дочитывает остаток и завершается
+    std::fflush(stdout);
+    dup2(tty_fd_, STDOUT_FILENO);
+    relay_.join();
+    std::fclose(terminal_);
+    close(tty_fd_);
+    close(pipe_fd_);
+    terminal_ = nullptr;
+    tty_fd_ = -1;
+    pipe_fd_ = -1;
+}
+
+bool ConsoleHandler::drainTerminal()
+{
+    if (!terminal_)
+        return false;
+    std::lock_guard<std::mutex> lock(relay_mutex_);
+    char buffer[16384];
+    ssize_t n;
+    while ((n = read(pipe_fd_, buffer, sizeof(buffer))) > 0)
+    {
+        std::fwrite(buffer, 1, n, terminal_);
+    }
+    std::fflush(terminal_);
+    return n < 0 && (errno == EAGAIN || errno == EINTR);
+}
+
+void ConsoleHandler::relayTerminal()
+{
+    pollfd fd = {pipe_fd_, POLLIN, 0};
+    for (;;)
+    {
+        if (poll(&fd, 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (!drainTerminal())
+            return;
+    }
+}
+
+ssize_t ConsoleHandler::writeTerminal(void *cookie, const char *buffer, size_t size)
+{
+    ConsoleHandler *self = static_cast<ConsoleHandler *>(cookie);
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t written = write(self->tty_fd_, buffer + done, size - done);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return done > 0 ? done : -1;
+        }
+        done += written;
+    }
+    self->terminal_bytes_.fetch_add(done, std::memory_order_relaxed);
+    return done;
+}
+
+RenderCounters ConsoleHandler::getTotalCounters() const
+{
+    return {flushes_, terminal_bytes_.load(std::memory_order_relaxed)};
+}
+
+void ConsoleHandler::flush()
+{
+    // Внутри кадра изменения только накапливаются в stdscr
+    if (frame_depth_ > 0)
+        return;
+    refresh();
+    drainTerminal();
+    flushes_++;
+}
+
+void ConsoleHandler::beginFrame()
+{
+    if (frame_depth_++ == 0)
+    {
+        frame_start_ = getTotalCounters();
+    }
+}
+
+void ConsoleHandler::commitFrame()
+{
+    if (frame_depth_ == 0 || --frame_depth_ > 0)
+        return;
+
+    wnoutrefresh(stdscr);
+    doupdate();
+    drainTerminal();
+    flushes_++;
+    frames_++;
+
+    RenderCounters now = getTotalCounters();
+    last_frame_.flushes = now.flushes - frame_start_.flushes;
+    last_frame_.bytes = now.bytes - frame_start_.bytes;
+    frames_total_.flushes += last_frame_.flushes;
+    frames_total_.bytes += last_frame_.bytes;
 }
 
 void ConsoleHandler::clearScreen()
 {
     clear();
-    refresh();
+    flush();
 }
 
-void ConsoleHandler::displayText(const std::string &text, bool /* highlight */)
+void ConsoleHandler::displayText(std::string_view text, bool /* highlight */)
 {
     // Преобразуем строку в широкие символы для корректного отображения UTF-8
-    wchar_t *wstr = new wchar_t[text.length() * 2 + 1];
-    mbstowcs(wstr, text.c_str(), text.length() * 2);
-    addwstr(wstr);
-    delete[] wstr;
-    refresh();
+    decodeUtf8(text, wide_buffer_);
+    addnwstr(wide_buffer_.data(), wide_buffer_.size());
+    flush();
 }
 
-void ConsoleHandler::displayTextCentered(const std::string &text, int y_offset)
+void ConsoleHandler::displayTextCentered(std::string_view text, int y_offset)
 {
-    // Преобразуем строку в широкие символы
-    wchar_t *wstr = new wchar_t[text.length() * 2 + 1];
-    size_t len = mbstowcs(wstr, text.c_str(), text.length() * 2);
+    decodeUtf8(text, wide_buffer_);
 
     // Получаем реальную длину строки в терминале
-    int display_width = wcswidth(wstr, len);
+    int display_width = wcswidth(wide_buffer_.data(), wide_buffer_.size());
     if (display_width < 0)
-        display_width = len; // Если не удалось определить ширину
+        display_width = wide_buffer_.size(); // Если не удалось определить ширину
 
+    moveCentered(display_width, y_offset);
+    addnwstr(wide_buffer_.data(), wide_buffer_.size());
+    flush();
+}
+
+void ConsoleHandler::displayText(const DecodedText &text, size_t first, size_t last)
+{
+    if (first < last)
+    {
+        addnwstr(text.chars.data() + first, last - first);
+    }
+    flush();
+}
+
+void ConsoleHandler::displayTextCentered(const DecodedText &text, int y_offset)
+{
+    moveCentered(text.width, y_offset);
+    addnwstr(text.chars.data(), text.chars.size());
+    flush();
+}
+
+void ConsoleHandler::displayChar(wchar_t c)
+{
+    addnwstr(&c, 1);
+    flush();
+}
+
+void ConsoleHandler::moveCentered(int display_width, int y_offset)
+{
     int x = (screen_width_ - display_width) / 2;
     if (x < 0)
         x = 0;
@@ -83,22 +284,61 @@ void ConsoleHandler::displayTextCentered(const std::string &text, int y_offset)
 
     // Очищаем всю строку перед выводом
     move(y, 0);
-    addstr(std::string(screen_width_, ' ').c_str());
+    clrtoeol();
 
     // Выводим новый текст
     move(y, x);
-    addwstr(wstr);
-    delete[] wstr;
-    refresh();
 }
 
 wint_t ConsoleHandler::getChar()
 {
     wint_t ch;
-    get_wch(&ch);
+    prepareInput();
+    int result = get_wch(&ch);
+    if (result == KEY_CODE_YES)
+    {
+        ch = translateKey(ch);
+    }
     return ch;
 }
 
+bool ConsoleHandler::waitChar(wint_t &ch, int timeout_ms)
+{
+    prepareInput();
+    wtimeout(stdscr, timeout_ms);
+    int result = get_wch(&ch);
+    wtimeout(stdscr, -1);
+    if (result == KEY_CODE_YES)
+    {
+        ch = translateKey(ch);
+    }
+    return result != ERR;
+}
+
+void ConsoleHandler::prepareInput()
+{
+    // get_wch сам обновляет экран перед ожиданием клавиши, и его байты попали бы в следующий
+    // кадр; обновляем заранее и переносим вывод сами
+    if (terminal_ && frame_depth_ == 0)
+    {
+        refresh();
+        drainTerminal();
+    }
+}
+
+wint_t ConsoleHandler::translateKey(wint_t key)
+{
+    if (key == static_cast<wint_t>(KEY_F(2)))
+        return KEY_DEBUG_OVERLAY;
+    if (key == static_cast<wint_t>(KEY_RESIZE))
+    {
+        // ncurses уже обработал SIGWINCH и изменил размер stdscr; содержимое перерисуют виджеты
+        getmaxyx(stdscr, screen_height_, screen_width_);
+        return KEY_SCREEN_RESIZE;
+    }
+    return key;
+}
+
 void ConsoleHandler::setColor(int color)
 {
     attroff(A_COLOR); // Сбрасываем текущий цвет
@@ -120,14 +360,14 @@ void ConsoleHandler::setColor(int color)
     default:
         attron(COLOR_PAIR(COLOR_PAIR_DEFAULT));
     }
-    refresh();
+    flush();
 }
 
 void ConsoleHandler::resetColor()
 {
     attroff(A_COLOR | A_BOLD);
     attron(COLOR_PAIR(COLOR_PAIR_DEFAULT));
-    refresh();
+    flush();
 }
 
 std::pair<int, int> ConsoleHandler::getScreenSize()
@@ -138,5 +378,12 @@ std::pair<int, int> ConsoleHandler::getScreenSize()
 void ConsoleHandler::moveCursor(int y, int x)
 {
     move(y, x);
-    refresh();
-}
\ No newline at end of file
+    flush();
+}
+
+void ConsoleHandler::clearLine(int y)
+{
+    move(y, 0);
+    clrtoeol();
+    flush();
+}
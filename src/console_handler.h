@@ -1,17 +1,25 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <sys/types.h>
+#include "renderer.h"
 #define _XOPEN_SOURCE_EXTENDED 1
 #include <ncurses.h>
 
-class ConsoleHandler
+// Счетчики вывода в терминал: сколько раз сбрасывали экран и сколько байт ушло
+struct RenderCounters
 {
-public:
-    // Определения типов текста
-    static const int COLOR_TYPED = 1;   // Набранный текст
-    static const int COLOR_CURRENT = 2; // Текущий символ
-    static const int COLOR_ERROR = 3;   // Ошибки
-    static const int COLOR_UNTYPED = 4; // Ненабранный текст
+    uint64_t flushes = 0;
+    uint64_t bytes = 0;
+};
 
+class ConsoleHandler : public Renderer, public InputSource
+{
 private:
     // Цветовые пары для ncurses
     static const int COLOR_PAIR_DEFAULT = 1;
@@ -21,21 +29,75 @@ private:
     static const int COLOR_PAIR_UNTYPED = 5;
 
 public:
-    ConsoleHandler();
+    // count_bytes - считать байты вывода в терминал (--render-stats); без него вывод ncurses
+    // идет в терминал напрямую, и getTotalCounters().bytes остается нулем
+    explicit ConsoleHandler(bool count_bytes = false);
     ~ConsoleHandler();
 
-    void clearScreen();
-    void displayText(const std::string &text, bool highlight = false);
-    void displayTextCentered(const std::string &text, int y_offset = 0);
+    // Локаль окружения с UTF-8 для wcwidth и mbrtowc; нужна и без терминала (--serve)
+    static void initializeLocale();
+
+    void clearScreen() override;
+    void displayText(std::string_view text, bool highlight = false) override;
+    void displayTextCentered(std::string_view text, int y_offset = 0) override;
+    void displayText(const DecodedText &text, size_t first, size_t last) override;
+    void displayTextCentered(const DecodedText &text, int y_offset = 0) override;
+    void displayChar(wchar_t c) override;
     wint_t getChar();
-    void setColor(int color);
-    void resetColor();
-    std::pair<int, int> getScreenSize();
-    void moveCursor(int y, int x);
+    bool waitChar(wint_t &ch, int timeout_ms) override;
+    void setColor(int color) override;
+    void resetColor() override;
+    std::pair<int, int> getScreenSize() override;
+    void moveCursor(int y, int x) override;
+    void clearLine(int y) override;
+
+    // Кадр сбрасывается в терминал одним doupdate()
+    void beginFrame() override;
+    void commitFrame() override;
+
+    // Счетчики за все время, за последний завершенный кадр и сумма по всем кадрам
+    RenderCounters getTotalCounters() const;
+    const RenderCounters &getLastFrameCounters() const { return last_frame_; }
+    const RenderCounters &getFramesCounters() const { return frames_total_; }
+    uint64_t getFrameCount() const { return frames_; }
 
 private:
     void initializeConsole();
     void restoreConsole();
+    void flush();
+    // Канал вывода ncurses в терминал с подсчетом байт (если stdout и stderr - терминал)
+    void openTerminalPipe();
+    void closeTerminalPipe();
+    // Переносит накопленный в канале вывод ncurses в терминал; false - канал закрыт
+    bool drainTerminal();
+    // Поток переноса: ждет вывод в канале, пока основной поток занят
+    void relayTerminal();
+    // Сбрасывает изменения экрана до того, как get_wch начнет ждать клавишу
+    void prepareInput();
+    static ssize_t writeTerminal(void *cookie, const char *buffer, size_t size);
+    void moveCentered(int display_width, int y_offset);
+    // Служебные клавиши ncurses в коды InputSource; KEY_RESIZE обновляет размер экрана
+    wint_t translateKey(wint_t key);
+
     int screen_height_;
     int screen_width_;
-};
\ No newline at end of file
+
+    // Буфер для разбора UTF-8 строк интерфейса, переиспользуется между вызовами
+    std::wstring wide_buffer_;
+
+    SCREEN *screen_ = nullptr;
+    FILE *terminal_ = nullptr; // терминал для вывода из канала, считает байты
+    int tty_fd_ = -1;
+    int pipe_fd_ = -1;
+    std::atomic<uint64_t> terminal_bytes_{0};
+    bool count_bytes_;
+    std::thread relay_;
+    std::mutex relay_mutex_; // чтение канала и запись в терминал - из одного потока за раз
+
+    int frame_depth_ = 0;
+    uint64_t flushes_ = 0;
+    RenderCounters frame_start_;
+    RenderCounters last_frame_;
+    RenderCounters frames_total_;
+    uint64_t frames_ = 0;
+};
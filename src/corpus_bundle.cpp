@@ -0,0 +1,205 @@
+#include "corpus_bundle.h"
+#include "text_provider.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef TYPING_EMBED_CORPUS
+// Набор, вшитый при сборке: отдельная секция только для чтения, без копирования при запуске
+asm(".section .rodata.typing_corpus,\"a\",@progbits\n"
+    ".balign 64\n"
+    ".global typing_corpus_bundle_start\n"
+    "typing_corpus_bundle_start:\n"
+    ".incbin \"" TYPING_EMBED_CORPUS "\"\n"
+    ".global typing_corpus_bundle_end\n"
+    "typing_corpus_bundle_end:\n"
+    ".previous\n");
+extern "C" const char typing_corpus_bundle_start[];
+extern "C" const char typing_corpus_bundle_end[];
+#endif
+
+namespace
+{
+    uint64_t alignUp(uint64_t value)
+    {
+        return (value + 7) & ~uint64_t(7);
+    }
+}
+
+const CorpusBundle &CorpusBundle::shared()
+{
+    static const CorpusBundle &bundle = []() -> const CorpusBundle &
+    {
+        static CorpusBundle instance;
+#ifdef TYPING_EMBED_CORPUS
+        if (instance.attach(typing_corpus_bundle_start, typing_corpus_bundle_end - typing_corpus_bundle_start))
+        {
+            instance.embedded_ = true;
+            return instance;
+        }
+#endif
+        instance.mapFile(getBundleFilename());
+        return instance;
+    }();
+    return bundle;
+}
+
+CorpusBundle::~CorpusBundle()
+{
+    if (mapping_)
+    {
+        munmap(mapping_, mapping_size_);
+    }
+}
+
+std::string CorpusBundle::getBundleFilename()
+{
+    return "data/corpus.bundle";
+}
+
+bool CorpusBundle::mapFile(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CorpusBundleHeader)))
+    {
+        close(fd);
+        return false;
+    }
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return false;
+
+    mapping_ = ptr;
+    mapping_size_ = st.st_size;
+    if (!attach(static_cast<const char *>(ptr), st.st_size))
+    {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+        return false;
+    }
+    return true;
+}
+
+bool CorpusBundle::attach(const char *data, size_t size)
+{
+    // Набор - только ускорение: поврежденный или чужой просто не используется
+    CorpusBundleHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "TBND", 4) != 0 || header.version != FORMAT_VERSION ||
+        header.entry_size != sizeof(CorpusBundleEntry) || header.total_size > size ||
+        header.corpus_count > (size - sizeof(header)) / sizeof(CorpusBundleEntry))
+        return false;
+
+    std::vector<Corpus> corpora;
+    const CorpusBundleEntry *entries = reinterpret_cast<const CorpusBundleEntry *>(data + sizeof(header));
+    for (uint32_t i = 0; i < header.corpus_count; ++i)
+    {
+        const CorpusBundleEntry &entry = entries[i];
+        if (entry.text_offset > size || entry.text_size > size - entry.text_offset ||
+            entry.index_offset % 8 != 0 || entry.index_offset > size ||
+            entry.line_count > (size - entry.index_offset) / sizeof(uint64_t) || entry.line_count == 0 ||
+            entry.name[sizeof(entry.name) - 1] != '\0')
+            return false;
+        corpora.push_back({entry.name,
+                           std::string_view(data + entry.text_offset, entry.text_size),
+                           reinterpret_cast<const uint64_t *>(data + entry.index_offset),
+                           entry.line_count, entry.file_size, entry.file_mtime_ns});
+    }
+    corpora_.swap(corpora);
+    return true;
+}
+
+const CorpusBundle::Corpus *CorpusBundle::find(const std::string &filename) const
+{
+    std::string name = std::filesystem::path(filename).filename().string();
+    auto it = std::find_if(corpora_.begin(), corpora_.end(), [&name](const Corpus &corpus)
+                           { return corpus.name == name; });
+    if (it == corpora_.end())
+        return nullptr;
+
+    // Файла может не быть вовсе (вшитый набор), но измененный файл важнее упакованной копии
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0)
+    {
+        int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        if (static_cast<uint64_t>(st.st_size) != it->file_size || mtime_ns != it->file_mtime_ns)
+            return nullptr;
+    }
+    return &*it;
+}
+
+size_t CorpusBundle::pack(const std::string &directory, const std::string &filename)
+{
+    std::vector<std::string> files;
+    for (const auto &entry : std::filesystem::directory_iterator(directory))
+    {
+        if (entry.path().extension() == ".txt")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+
+    // Раскладка: заголовок, записи, затем текст и индекс каждого корпуса
+    CorpusBundleHeader header{};
+    std::memcpy(header.magic, "TBND", 4);
+    header.version = FORMAT_VERSION;
+    header.corpus_count = static_cast<uint32_t>(files.size());
+    header.entry_size = sizeof(CorpusBundleEntry);
+
+    std::vector<CorpusBundleEntry> entries(files.size());
+    std::string body;
+    uint64_t base = sizeof(header) + files.size() * sizeof(CorpusBundleEntry);
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        // Индекс строк строится тем же кодом, что и при обычной загрузке
+        TextProvider provider(files[i]);
+        std::string name = std::filesystem::path(files[i]).filename().string();
+        if (name.size() >= sizeof(entries[i].name))
+            throw std::runtime_error("Слишком длинное имя файла " + name);
+
+        CorpusBundleEntry &entry = entries[i];
+        std::memcpy(entry.name, name.c_str(), name.size() + 1);
+        entry.text_offset = base + body.size();
+        entry.text_size = provider.getData().size();
+        body += provider.getData();
+        body.resize(alignUp(base + body.size()) - base, '\0');
+        entry.index_offset = base + body.size();
+        entry.line_count = provider.size();
+        body.append(reinterpret_cast<const char *>(provider.getOffsets()), provider.size() * sizeof(uint64_t));
+        entry.file_size = provider.getFileSize();
+        entry.file_mtime_ns = provider.getFileMtimeNs();
+    }
+    header.total_size = base + body.size();
+
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Не удалось записать " + filename);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(CorpusBundleEntry));
+        file.write(body.data(), body.size());
+        if (!file)
+        {
+            file.close();
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Не удалось записать " + filename);
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        throw std::runtime_error("Не удалось записать " + filename);
+    return files.size();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Заголовок набора корпусов (data/corpus.bundle или вшитого в программу),
+// за ним corpus_count записей CorpusBundleEntry, тексты и индексы строк
+struct CorpusBundleHeader
+{
+    char magic[4]; // "TBND"
+    uint32_t version;
+    uint32_t corpus_count;
+    uint32_t entry_size; // sizeof(CorpusBundleEntry)
+    uint64_t total_size;
+    uint8_t padding[40];
+};
+static_assert(sizeof(CorpusBundleHeader) == 64, "CorpusBundleHeader must stay 64 bytes");
+
+// Корпус в наборе: текст как в файле и смещения начал непустых строк, как в <файл>.idx.
+// Смещения отсчитываются от начала набора
+struct CorpusBundleEntry
+{
+    char name[48]; // имя файла без каталога, например "english.txt"
+    uint64_t text_offset;
+    uint64_t text_size;
+    uint64_t index_offset; // line_count смещений uint64_t, выровнены по 8
+    uint64_t line_count;
+    uint64_t file_size;    // размер и время изменения исходного файла
+    int64_t file_mtime_ns; // на момент упаковки
+};
+static_assert(sizeof(CorpusBundleEntry) == 96, "CorpusBundleEntry must stay 96 bytes");
+
+// Заранее упакованные тексты всех языков: меню строится без сканирования data/,
+// а TextProvider берет текст и индекс строк прямо из отображенного набора.
+// Набор, вшитый в программу (make EMBED_CORPUS=1), важнее файла data/corpus.bundle.
+// Корпус, чей файл на диске изменился после упаковки, читается из файла
+class CorpusBundle
+{
+public:
+    static const uint32_t FORMAT_VERSION = 1;
+
+    struct Corpus
+    {
+        std::string name; // "english.txt"
+        std::string_view text;
+        const uint64_t *offsets;
+        size_t line_count;
+        uint64_t file_size;
+        int64_t file_mtime_ns;
+    };
+
+    // Набор процесса; пустой, если его нет или он поврежден
+    static const CorpusBundle &shared();
+
+    CorpusBundle() = default;
+    ~CorpusBundle();
+
+    CorpusBundle(const CorpusBundle &) = delete;
+    CorpusBundle &operator=(const CorpusBundle &) = delete;
+
+    bool empty() const { return corpora_.empty(); }
+    bool isEmbedded() const { return embedded_; }
+    const std::vector<Corpus> &corpora() const { return corpora_; }
+
+    // Корпус для файла data/<имя>.txt, если он есть в наборе и файл с тех пор не менялся
+    const Corpus *find(const std::string &filename) const;
+
+    // Упаковывает все <каталог>/*.txt в файл набора; возвращает число корпусов
+    static size_t pack(const std::string &directory, const std::string &filename);
+    static std::string getBundleFilename();
+
+private:
+    bool attach(const char *data, size_t size);
+    bool mapFile(const std::string &filename);
+
+    void *mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    bool embedded_ = false;
+    std::vector<Corpus> corpora_;
+};
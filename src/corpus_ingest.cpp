@@ -0,0 +1,569 @@
+#include "corpus_ingest.h"
+#include "byte_utils.h"
+#include "case_fold.h"
+#include "decoded_text.h"
+#include "text_provider.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Предложение в выходном тексте куска
+    struct Sentence
+    {
+        uint64_t hash;
+        uint32_t offset;
+        uint32_t size;
+        int bucket;
+    };
+
+    struct Chunk
+    {
+        const char *data;
+        size_t size;
+    };
+
+    // Выход рабочего потока по куску: прошедшие отбор предложения через \n и счетчики отбора
+    struct ChunkResult
+    {
+        std::string text;
+        std::vector<Sentence> sentences;
+        uint64_t found = 0;
+        uint64_t dropped_layout = 0;
+        uint64_t dropped_length = 0;
+        bool ready = false;
+    };
+
+    // Отображенный входной файл
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &filename)
+        {
+            int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                throw std::runtime_error("Не удалось открыть " + filename);
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Не удалось открыть " + filename);
+            }
+            size_ = st.st_size;
+            if (size_ > 0)
+            {
+                void *ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (ptr == MAP_FAILED)
+                {
+                    close(fd);
+                    throw std::runtime_error("Не удалось открыть " + filename);
+                }
+                // Каждый кусок читается один раз от начала к концу
+                madvise(ptr, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char *>(ptr);
+            }
+            close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (data_)
+                munmap(const_cast<char *>(data_), size_);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Составные формы для основы и комбинируемого знака: кириллица и Latin-1 (строчные - +0x20)
+    struct Composition
+    {
+        wchar_t base;
+        wchar_t mark;
+        wchar_t composed;
+    };
+
+    const Composition CYRILLIC_COMPOSITIONS[] = {
+        {L'и', 0x306, L'й'}, {L'И', 0x306, L'Й'}, {L'е', 0x308, L'ё'}, {L'Е', 0x308, L'Ё'},
+        {L'у', 0x306, L'ў'}, {L'У', 0x306, L'Ў'}, {L'і', 0x308, L'ї'}, {L'І', 0x308, L'Ї'},
+    };
+
+    const Composition LATIN_COMPOSITIONS[] = {
+        {'A', 0x300, 0xC0}, {'A', 0x301, 0xC1}, {'A', 0x302, 0xC2}, {'A', 0x303, 0xC3}, {'A', 0x308, 0xC4},
+        {'A', 0x30A, 0xC5}, {'C', 0x327, 0xC7}, {'E', 0x300, 0xC8}, {'E', 0x301, 0xC9}, {'E', 0x302, 0xCA},
+        {'E', 0x308, 0xCB}, {'I', 0x300, 0xCC}, {'I', 0x301, 0xCD}, {'I', 0x302, 0xCE}, {'I', 0x308, 0xCF},
+        {'N', 0x303, 0xD1}, {'O', 0x300, 0xD2}, {'O', 0x301, 0xD3}, {'O', 0x302, 0xD4}, {'O', 0x303, 0xD5},
+        {'O', 0x308, 0xD6}, {'U', 0x300, 0xD9}, {'U', 0x301, 0xDA}, {'U', 0x302, 0xDB}, {'U', 0x308, 0xDC},
+        {'Y', 0x301, 0xDD},
+    };
+
+    // Составной символ или 0, если такой формы нет
+    wchar_t compose(wchar_t base, wchar_t mark)
+    {
+        for (const auto &entry : CYRILLIC_COMPOSITIONS)
+        {
+            if (entry.base == base && entry.mark == mark)
+                return entry.composed;
+        }
+        for (const auto &entry : LATIN_COMPOSITIONS)
+        {
+            if (entry.mark != mark)
+                continue;
+            if (entry.base == base)
+                return entry.composed;
+            if (entry.base + 0x20 == base)
+                return entry.composed + 0x20;
+        }
+        if (base == L'y' && mark == 0x308)
+            return 0xFF;
+        return 0;
+    }
+
+    bool isCombining(wchar_t c)
+    {
+        return c >= 0x300 && c <= 0x36F;
+    }
+
+    bool isSpace(wchar_t c)
+    {
+        return c <= 0x20 || c == 0x85 || c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A) ||
+               c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+    }
+
+    bool isInvisible(wchar_t c)
+    {
+        return c == 0x7F || c == 0xAD || (c >= 0x200B && c <= 0x200D) || c == 0x2060 || c == 0xFEFF;
+    }
+
+    // Набираемая замена типографского символа; пустая - символ остается как есть
+    std::wstring_view replacement(wchar_t c)
+    {
+        switch (c)
+        {
+        case 0x2018: case 0x2019: case 0x201A: case 0x201B: case 0x2032: case 0x02BC:
+            return L"'";
+        case 0x201C: case 0x201D: case 0x201E: case 0x201F: case 0x00AB: case 0x00BB: case 0x2033:
+            return L"\"";
+        case 0x2010: case 0x2011: case 0x2012: case 0x2013: case 0x2014: case 0x2015: case 0x2212:
+            return L"-";
+        case 0x2026:
+            return L"...";
+        default:
+            return std::wstring_view();
+        }
+    }
+
+    // Регистр по общим таблицам case_fold.h, без зависимости от локали
+    bool isLower(wchar_t c)
+    {
+        return simpleUpper(c) != static_cast<uint32_t>(c) || c == 0xDF;
+    }
+
+    bool isUpper(wchar_t c)
+    {
+        return simpleLower(c) != static_cast<uint32_t>(c);
+    }
+
+    bool isTerminator(wchar_t c)
+    {
+        return c == L'.' || c == L'!' || c == L'?' || c == 0x2026;
+    }
+
+    // Закрывающие кавычки и скобки, которые остаются в предложении после точки
+    bool isClosing(wchar_t c)
+    {
+        return c == L'"' || c == L'\'' || c == L')' || c == 0xBB || c == 0x201D || c == 0x2019;
+    }
+
+    // Сокращения, после которых точка не завершает предложение
+    const wchar_t *const ABBREVIATIONS[] = {
+        L"Mr", L"Mrs", L"Ms", L"Dr", L"Prof", L"St", L"Jr", L"Sr", L"vs", L"etc", L"No",
+        L"т", L"г", L"гг", L"др", L"пр", L"им", L"ул", L"стр", L"см", L"проф",
+    };
+
+    bool isAbbreviation(std::wstring_view word)
+    {
+        return std::any_of(std::begin(ABBREVIATIONS), std::end(ABBREVIATIONS), [word](const wchar_t *abbreviation)
+                           { return word == abbreviation; });
+    }
+
+    bool isAsciiSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Конец куска, начинающегося с begin, не дальше end: после пустой строки (конец абзаца),
+    // иначе после строки, которая кончается точкой, иначе после пробела; в худшем случае
+    // на границе символа UTF-8. Ищется только в хвосте куска
+    size_t chunkEnd(const char *data, size_t size, size_t begin, size_t end)
+    {
+        const size_t SCAN_BYTES = 64 << 10;
+        size_t limit = end - std::min(end - begin - 1, SCAN_BYTES);
+        size_t line_end = 0;
+        size_t space = 0;
+        for (size_t i = end; i > limit; --i)
+        {
+            char c = data[i - 1];
+            if (c == '\n')
+            {
+                size_t next = i;
+                while (next < size && isAsciiSpace(data[next]))
+                    ++next;
+                if (next < size && data[next] == '\n')
+                    return next + 1;
+
+                size_t last = i - 1;
+                while (last > begin && isAsciiSpace(data[last - 1]))
+                    --last;
+                if (!line_end && last > begin && std::strchr(".!?", data[last - 1]))
+                    line_end = i;
+            }
+            if (!space && (c == ' ' || c == '\n'))
+                space = i;
+        }
+        if (line_end)
+            return line_end;
+        if (space)
+            return space;
+        while (end > begin + 1 && (static_cast<unsigned char>(data[end]) & 0xC0) == 0x80)
+            --end;
+        return end;
+    }
+
+    std::string bucketFilename(const std::string &output, int bucket)
+    {
+        return output + "." + std::to_string(bucket) + ".tmp";
+    }
+}
+
+CorpusIngest::CorpusIngest(const KeyboardLayout &layout, uint32_t min_length, uint32_t max_length, unsigned threads)
+    : layout_(layout), min_length_(min_length), max_length_(max_length),
+      threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      typeable_(LayoutTable::DIRECT_LIMIT, 0)
+{
+    // Цифры и эта пунктуация есть на верхнем ряду или в верхнем регистре любой раскладки,
+    // остальные знаки - только если у раскладки есть для них клавиша
+    for (wchar_t c : std::wstring_view(L" 0123456789!\"'(),-.:;?"))
+        typeable_[c] = 1;
+    for (int i = 0; i < layout_.keyCount(); ++i)
+    {
+        wchar_t label = layout_.key(i).label;
+        for (uint32_t c : {static_cast<uint32_t>(label), simpleLower(label), simpleUpper(label)})
+        {
+            if (c < LayoutTable::DIRECT_LIMIT)
+                typeable_[c] = 1;
+        }
+    }
+}
+
+bool CorpusIngest::typeable(wchar_t c) const
+{
+    if (static_cast<uint32_t>(c) < LayoutTable::DIRECT_LIMIT)
+        return typeable_[c] != 0;
+    return layout_.find(c) >= 0;
+}
+
+int CorpusIngest::bucket(size_t length)
+{
+    return static_cast<int>(std::min<size_t>(length / BUCKET_CHARS, BUCKET_COUNT - 1));
+}
+
+void CorpusIngest::segment(std::wstring_view text, std::vector<std::pair<size_t, size_t>> &out)
+{
+    out.clear();
+    const size_t NONE = std::wstring_view::npos;
+    size_t start = NONE;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        wchar_t c = text[i];
+        if (start == NONE)
+        {
+            if (!isSpace(c))
+                start = i;
+            continue;
+        }
+
+        if (c == L'\n')
+        {
+            size_t next = i + 1;
+            while (next < text.size() && text[next] != L'\n' && isSpace(text[next]))
+                ++next;
+            if (next < text.size() && text[next] == L'\n')
+            {
+                out.push_back({start, i});
+                start = NONE;
+                i = next;
+            }
+            continue;
+        }
+
+        if (!isTerminator(c))
+            continue;
+
+        size_t end = i + 1;
+        while (end < text.size() && isTerminator(text[end]))
+            ++end;
+        while (end < text.size() && isClosing(text[end]))
+            ++end;
+        if (end < text.size() && !isSpace(text[end]))
+        {
+            i = end - 1;
+            continue;
+        }
+
+        // Со строчной буквы предложение не начинается, а одна заглавная буква перед точкой -
+        // инициал ("J. R. R. Tolkien")
+        size_t next = end;
+        while (next < text.size() && isSpace(text[next]))
+            ++next;
+        size_t word = i;
+        while (word > start && !isSpace(text[word - 1]))
+            --word;
+        bool abbreviation = c == L'.' && end == i + 1 &&
+                            ((i - word == 1 && isUpper(text[word])) || isAbbreviation(text.substr(word, i - word)));
+        if ((next < text.size() && isLower(text[next])) || abbreviation)
+        {
+            i = end - 1;
+            continue;
+        }
+
+        out.push_back({start, end});
+        start = NONE;
+        i = end - 1;
+    }
+    if (start != NONE)
+        out.push_back({start, text.size()});
+}
+
+void CorpusIngest::normalize(std::wstring_view sentence, std::wstring &out)
+{
+    out.clear();
+    bool space = false;
+    for (wchar_t c : sentence)
+    {
+        if (isSpace(c))
+        {
+            space = true;
+            continue;
+        }
+        if (isInvisible(c))
+            continue;
+        if (isCombining(c) && !out.empty() && !space)
+        {
+            if (wchar_t composed = compose(out.back(), c))
+            {
+                out.back() = composed;
+                continue;
+            }
+        }
+
+        if (space && !out.empty())
+            out.push_back(L' ');
+        space = false;
+        std::wstring_view mapped = replacement(c);
+        if (mapped.empty())
+            out.push_back(c);
+        else
+            out.append(mapped);
+    }
+}
+
+CorpusIngest::Stats CorpusIngest::run(const std::vector<std::string> &inputs, const std::string &output)
+{
+    Stats stats;
+
+    // Чтение по кускам: файлы отображаются целиком, границы кусков ищутся только у их концов,
+    // а страницы читают сами рабочие потоки
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<Chunk> chunks;
+    for (const auto &input : inputs)
+    {
+        files.push_back(std::make_unique<MappedFile>(input));
+        const MappedFile &file = *files.back();
+        stats.bytes += file.size();
+        size_t pos = 0;
+        while (pos < file.size())
+        {
+            size_t end = pos + CHUNK_BYTES;
+            end = end >= file.size() ? file.size() : chunkEnd(file.data(), file.size(), pos, end);
+            chunks.push_back({file.data() + pos, end - pos});
+            pos = end;
+        }
+    }
+    stats.chunks = chunks.size();
+
+    std::vector<std::ofstream> buckets(BUCKET_COUNT);
+    auto removeBuckets = [&]()
+    {
+        for (int b = 0; b < BUCKET_COUNT; ++b)
+        {
+            buckets[b].close();
+            std::remove(bucketFilename(output, b).c_str());
+        }
+    };
+    for (int b = 0; b < BUCKET_COUNT; ++b)
+    {
+        buckets[b].open(bucketFilename(output, b), std::ios::binary | std::ios::trunc);
+        if (!buckets[b])
+        {
+            removeBuckets();
+            throw std::runtime_error("Не удалось записать " + output);
+        }
+    }
+
+    // Рабочие потоки берут куски по порядку, но уходят вперед записи не больше чем на window
+    // кусков, поэтому в памяти одновременно лишь несколько результатов
+    std::vector<ChunkResult> results(chunks.size());
+    std::atomic<size_t> next_chunk{0};
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t consumed = 0;
+    const size_t window = 4 * threads_;
+
+    auto work = [&]()
+    {
+        std::wstring chars;
+        std::wstring normalized;
+        std::vector<std::pair<size_t, size_t>> bounds;
+        for (size_t index; (index = next_chunk++) < chunks.size();)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]
+                             { return index < consumed + window; });
+            }
+
+            const Chunk &chunk = chunks[index];
+            ChunkResult &result = results[index];
+            decodeUtf8(std::string_view(chunk.data, chunk.size), chars);
+            segment(chars, bounds);
+            for (const auto &bound : bounds)
+            {
+                normalize(std::wstring_view(chars).substr(bound.first, bound.second - bound.first), normalized);
+                if (normalized.empty())
+                    continue;
+                ++result.found;
+                if (!std::all_of(normalized.begin(), normalized.end(), [this](wchar_t c)
+                                 { return typeable(c); }))
+                {
+                    ++result.dropped_layout;
+                    continue;
+                }
+                if (normalized.size() < min_length_ || normalized.size() > max_length_)
+                {
+                    ++result.dropped_length;
+                    continue;
+                }
+
+                size_t offset = result.text.size();
+                encodeUtf8(normalized, result.text);
+                size_t size = result.text.size() - offset;
+                result.sentences.push_back({fnv1a(result.text.data() + offset, size),
+                                            static_cast<uint32_t>(offset), static_cast<uint32_t>(size),
+                                            bucket(normalized.size())});
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                result.ready = true;
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned part = 0; part < threads_; ++part)
+        pool.emplace_back(work);
+
+    // Повторы отбрасываются в порядке входа: остается первое вхождение, результат
+    // не зависит от числа потоков
+    std::unordered_set<uint64_t> seen;
+    for (size_t index = 0; index < chunks.size(); ++index)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]
+                         { return results[index].ready; });
+        }
+
+        ChunkResult &result = results[index];
+        stats.sentences += result.found;
+        stats.dropped_layout += result.dropped_layout;
+        stats.dropped_length += result.dropped_length;
+        for (const auto &sentence : result.sentences)
+        {
+            if (!seen.insert(sentence.hash).second)
+            {
+                ++stats.duplicates;
+                continue;
+            }
+            buckets[sentence.bucket].write(result.text.data() + sentence.offset, sentence.size).put('\n');
+            ++stats.buckets[sentence.bucket];
+            ++stats.written;
+        }
+        std::string().swap(result.text);
+        std::vector<Sentence>().swap(result.sentences);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            consumed = index + 1;
+        }
+        changed.notify_all();
+    }
+    for (auto &thread : pool)
+        thread.join();
+    files.clear();
+
+    bool failed = std::any_of(buckets.begin(), buckets.end(), [](const std::ofstream &file)
+                              { return !file; });
+    if (failed || stats.written == 0)
+    {
+        removeBuckets();
+        throw std::runtime_error(failed ? "Не удалось записать " + output
+                                        : "Ни одно предложение не прошло отбор, " + output + " не изменен");
+    }
+
+    // Корзины подряд от коротких к длинным
+    std::string tmp = output + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        for (int b = 0; b < BUCKET_COUNT && file; ++b)
+        {
+            buckets[b].close();
+            std::ifstream part(bucketFilename(output, b), std::ios::binary);
+            if (stats.buckets[b] > 0)
+                file << part.rdbuf();
+        }
+        failed = !file;
+    }
+    removeBuckets();
+    if (failed || std::rename(tmp.c_str(), output.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Не удалось записать " + output);
+    }
+
+    // Индекс строк строится тем же кодом, что и при обычной загрузке, и кэшируется рядом
+    TextProvider provider(output);
+    return stats;
+}
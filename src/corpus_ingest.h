@@ -0,0 +1,65 @@
+#pragma once
+#include "keyboard_layout.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Конвейер пополнения корпуса из больших сырых текстов (книги, выгрузки) в UTF-8.
+// Входные файлы отображаются в память и режутся на куски по границам абзацев; каждый кусок
+// независимо от остальных проходит в рабочих потоках этапы: разбиение на предложения,
+// нормализация Unicode, отбор по раскладке (предложение с символом, которого нет на клавиатуре,
+// отбрасывается), отбор по длине и корзина длины, хеш предложения. Основной поток принимает
+// куски по порядку, отбрасывает повторы по хешу и дописывает предложения в файлы корзин.
+// Итоговый корпус - корзины от коротких предложений к длинным, по одному на строку,
+// индекс строк <файл>.idx строится сразу тем же кодом, что и при обычной загрузке
+class CorpusIngest
+{
+public:
+    // Кусок входного файла для одного рабочего потока
+    static const size_t CHUNK_BYTES = 4 << 20;
+    // Корзины длины по BUCKET_CHARS символов, последняя - все длиннее
+    static const uint32_t BUCKET_CHARS = 40;
+    static const int BUCKET_COUNT = 8;
+    // Диапазон длины предложений в символах, если --length не задан
+    static const uint32_t DEFAULT_MIN_LENGTH = 20;
+    static const uint32_t DEFAULT_MAX_LENGTH = 300;
+
+    struct Stats
+    {
+        uint64_t bytes = 0;
+        uint64_t chunks = 0;
+        uint64_t sentences = 0;       // найдено предложений
+        uint64_t dropped_layout = 0;  // символ не набирается на раскладке
+        uint64_t dropped_length = 0;  // вне диапазона длины
+        uint64_t duplicates = 0;
+        uint64_t written = 0;
+        uint64_t buckets[BUCKET_COUNT] = {};
+    };
+
+    // Раскладка не копируется и должна жить, пока идет run; threads = 0 - по числу ядер
+    CorpusIngest(const KeyboardLayout &layout, uint32_t min_length, uint32_t max_length, unsigned threads = 0);
+
+    // Прогоняет файлы inputs через конвейер и записывает корпус output (старый заменяется целиком)
+    // вместе с индексом строк; исключение, если файл не читается или корпус не записывается
+    Stats run(const std::vector<std::string> &inputs, const std::string &output);
+
+    // Границы предложений [начало, конец) в тексте. Перевод строки внутри абзаца - пробел,
+    // пустая строка завершает предложение
+    static void segment(std::wstring_view text, std::vector<std::pair<size_t, size_t>> &out);
+    // Составные символы (и + U+0306 -> й), типографские кавычки, тире и пробелы - в набираемые,
+    // невидимые символы убираются, пробелы схлопываются; out переиспользуется
+    static void normalize(std::wstring_view sentence, std::wstring &out);
+    // Набирается ли символ на раскладке: клавиши в любом регистре, пробел, цифры и общая для
+    // раскладок пунктуация верхнего ряда
+    bool typeable(wchar_t c) const;
+    static int bucket(size_t length);
+
+private:
+    const KeyboardLayout &layout_;
+    uint32_t min_length_;
+    uint32_t max_length_;
+    unsigned threads_;
+    // typeable для кодов до LayoutTable::DIRECT_LIMIT; остальные ищутся в раскладке
+    std::vector<uint8_t> typeable_;
+};
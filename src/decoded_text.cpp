@@ -0,0 +1,119 @@
+#include "decoded_text.h"
+#include <cwchar>
+
+namespace
+{
+    const wchar_t REPLACEMENT_CHAR = 0xFFFD;
+}
+
+wchar_t decodeUtf8Char(std::string_view text, size_t &pos)
+{
+    unsigned char lead = text[pos++];
+    if (lead < 0x80)
+        return lead;
+
+    int extra;
+    uint32_t cp;
+    if ((lead & 0xE0) == 0xC0)
+    {
+        extra = 1;
+        cp = lead & 0x1F;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        extra = 2;
+        cp = lead & 0x0F;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        extra = 3;
+        cp = lead & 0x07;
+    }
+    else
+    {
+        return REPLACEMENT_CHAR;
+    }
+
+    for (int i = 0; i < extra; ++i)
+    {
+        if (pos >= text.size() || (static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80)
+            return REPLACEMENT_CHAR;
+        cp = (cp << 6) | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+    }
+
+    // Отсекаем слишком длинные формы, суррогаты и значения за пределами Unicode
+    static const uint32_t min_for_length[] = {0, 0x80, 0x800, 0x10000};
+    if (cp < min_for_length[extra] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        return REPLACEMENT_CHAR;
+    return static_cast<wchar_t>(cp);
+}
+
+void decodeUtf8(std::string_view text, std::wstring &out)
+{
+    out.clear();
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        out.push_back(decodeUtf8Char(text, pos));
+    }
+}
+
+void DecodedText::assign(std::string_view text)
+{
+    utf8.assign(text.data(), text.size());
+    chars.clear();
+    widths.clear();
+    columns.clear();
+    byte_offsets.clear();
+    width = 0;
+
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        byte_offsets.push_back(static_cast<uint32_t>(pos));
+        wchar_t c = decodeUtf8Char(text, pos);
+
+        // Управляющие символы и неизвестные wcwidth занимают одну колонку
+        int w = wcwidth(c);
+        if (w < 0)
+            w = 1;
+        if (w == 0 && chars.empty())
+            w = 1;
+
+        columns.push_back(w == 0 ? columns.back() : width);
+        chars.push_back(c);
+        widths.push_back(static_cast<uint8_t>(w));
+        width += w;
+    }
+    byte_offsets.push_back(static_cast<uint32_t>(text.size()));
+}
+
+void encodeUtf8(std::wstring_view text, std::string &out)
+{
+    for (wchar_t c : text)
+    {
+        uint32_t cp = static_cast<uint32_t>(c);
+        if (cp < 0x80)
+        {
+            out.push_back(static_cast<char>(cp));
+        }
+        else if (cp < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Текст, заранее разобранный из UTF-8 в коды символов. Ширины в колонках терминала (wcwidth),
+// колонки и байтовые смещения считаются один раз, чтобы отрисовка не перекодировала текст
+struct DecodedText
+{
+    std::string utf8;                 // исходный текст
+    std::wstring chars;               // коды символов (wchar_t - UTF-32)
+    std::vector<uint8_t> widths;      // ширина каждого символа: 0 для комбинируемых, 2 для широких
+    std::vector<uint32_t> columns;    // колонка начала символа; комбинируемый стоит в колонке основы
+    std::vector<uint32_t> byte_offsets; // смещение символа в utf8, последний элемент - utf8.size()
+    uint32_t width = 0;               // ширина всего текста в колонках
+
+    size_t length() const { return chars.size(); }
+    bool empty() const { return chars.empty(); }
+
+    // Границы графемы (символ и следующие за ним комбинируемые), содержащей символ pos
+    size_t clusterStart(size_t pos) const
+    {
+        while (pos > 0 && widths[pos] == 0)
+            --pos;
+        return pos;
+    }
+    size_t clusterEnd(size_t pos) const
+    {
+        ++pos;
+        while (pos < chars.size() && widths[pos] == 0)
+            ++pos;
+        return pos;
+    }
+
+    // Разбирает UTF-8, переиспользуя уже выделенные буферы. Некорректные байты заменяются на U+FFFD
+    void assign(std::string_view text);
+};
+
+// Декодирует один символ, начиная с text[pos], и сдвигает pos за него
+wchar_t decodeUtf8Char(std::string_view text, size_t &pos);
+// Разбор UTF-8 в wchar_t без выделений памяти, если буфер уже достаточного размера
+void decodeUtf8(std::string_view text, std::wstring &out);
+// Кодирование символов в UTF-8 с дописыванием в out
+void encodeUtf8(std::wstring_view text, std::string &out);
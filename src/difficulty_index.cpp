@@ -0,0 +1,286 @@
+#include "difficulty_index.h"
+#include "byte_utils.h"
+#include "decoded_text.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    // Признаки символа в таблице: номер клавиши + 1 в младших битах (0 - не на клавиатуре)
+    const uint16_t KEY_MASK = 0x3F;
+    const uint16_t PUNCTUATION = 0x40;
+    const uint16_t RARE = 0x80;
+    static_assert(LayoutTable::MAX_KEYS < KEY_MASK, "key index must fit KEY_MASK");
+
+    // Значение составляющей, при котором она дает полный вклад, и ее вес (веса в сумме - 1)
+    const double LENGTH_FULL = 200;
+    const double RARE_FULL = 0.05;
+    const double PUNCTUATION_FULL = 0.15;
+    const double SAME_FINGER_FULL = 0.15;
+    const double ROW_JUMP_FULL = 0.10;
+    const double LENGTH_WEIGHT = 0.30;
+    const double RARE_WEIGHT = 0.20;
+    const double PUNCTUATION_WEIGHT = 0.15;
+    const double SAME_FINGER_WEIGHT = 0.20;
+    const double ROW_JUMP_WEIGHT = 0.15;
+
+    bool isSpace(wchar_t c)
+    {
+        return c <= 0x20 || c == 0xA0;
+    }
+
+    bool isPunctuation(uint32_t c)
+    {
+        return (c >= 0x21 && c <= 0x40 && !(c >= 'A' && c <= 'Z')) || (c >= 0x5B && c <= 0x60) ||
+               (c >= 0x7B && c <= 0x7E) || (c >= 0xA1 && c <= 0xBF) || (c >= 0x2010 && c <= 0x206F);
+    }
+
+    // ASCII без вызова общего декодера: в корпусах его большинство
+    inline wchar_t nextChar(std::string_view text, size_t &pos)
+    {
+        unsigned char byte = text[pos];
+        if (byte < 0x80)
+        {
+            ++pos;
+            return byte;
+        }
+        return decodeUtf8Char(text, pos);
+    }
+
+    double saturate(double value, double full)
+    {
+        return std::min(value / full, 1.0);
+    }
+
+    uint64_t layoutHash(const KeyboardLayout &layout)
+    {
+        // FNV-1a по подписям, рядам и пальцам клавиш
+        uint64_t hash = FNV1A_SEED;
+        for (int i = 0; i < layout.keyCount(); ++i)
+        {
+            const LayoutKey &key = layout.key(i);
+            uint32_t values[] = {static_cast<uint32_t>(key.label), static_cast<uint32_t>(key.row << 8 | key.finger)};
+            hash = fnv1a(values, sizeof(values), hash);
+        }
+        return hash;
+    }
+}
+
+DifficultyIndex::DifficultyIndex(const TextProvider &provider, const KeyboardLayout &layout, unsigned threads)
+{
+    std::string filename = getIndexFilename(provider.getFilename(), layout);
+    uint64_t hash = layoutHash(layout);
+    if (!load(filename, provider.getFileSize(), provider.getFileMtimeNs(), hash))
+    {
+        build(provider, layout, threads);
+        save(filename, provider.getFileSize(), provider.getFileMtimeNs(), hash);
+    }
+}
+
+std::string DifficultyIndex::getIndexFilename(const std::string &corpus_filename, const KeyboardLayout &layout)
+{
+    return corpus_filename + "." + layout.name() + ".difficulty";
+}
+
+float DifficultyIndex::combine(const Features &features)
+{
+    if (features.length == 0)
+        return 0;
+    double length = features.length;
+    double bigrams = std::max<uint32_t>(features.bigrams, 1);
+    double score = LENGTH_WEIGHT * saturate(length, LENGTH_FULL) +
+                   RARE_WEIGHT * saturate(features.rare / length, RARE_FULL) +
+                   PUNCTUATION_WEIGHT * saturate(features.punctuation / length, PUNCTUATION_FULL) +
+                   SAME_FINGER_WEIGHT * saturate(features.same_finger / bigrams, SAME_FINGER_FULL) +
+                   ROW_JUMP_WEIGHT * saturate(features.row_jumps / bigrams, ROW_JUMP_FULL);
+    return static_cast<float>(100 * score);
+}
+
+std::pair<size_t, size_t> DifficultyIndex::band(int band) const
+{
+    band = std::clamp(band, 1, BAND_COUNT);
+    size_t first = text_count_ * (band - 1) / BAND_COUNT;
+    size_t last = text_count_ * band / BAND_COUNT;
+    // В корпусе меньше текстов, чем полос: полоса - хотя бы один текст
+    if (first == last)
+    {
+        first = std::min(first, text_count_ - 1);
+        last = first + 1;
+    }
+    return {first, last};
+}
+
+std::pair<size_t, size_t> DifficultyIndex::range(float min_score, float max_score) const
+{
+    const float *first = std::lower_bound(sorted_scores_, sorted_scores_ + text_count_, min_score);
+    const float *last = std::upper_bound(first, sorted_scores_ + text_count_, max_score);
+    return {first - sorted_scores_, last - sorted_scores_};
+}
+
+uint32_t DifficultyIndex::pick(int band, uint64_t random, const std::vector<uint32_t> &recent) const
+{
+    if (text_count_ == 0)
+        return NONE;
+
+    auto [first, last] = this->band(band);
+    size_t size = last - first;
+    size_t start = random % size;
+    for (size_t i = 0; i < size; ++i)
+    {
+        uint32_t text = order_[first + (start + i) % size];
+        if (std::find(recent.begin(), recent.end(), text) == recent.end())
+            return text;
+    }
+    return order_[first + start];
+}
+
+bool DifficultyIndex::load(const std::string &filename, uint64_t file_size, int64_t mtime_ns, uint64_t layout_hash)
+{
+    DifficultyIndexHeader header;
+    CacheFile::Stamp stamp{"DIFF", FORMAT_VERSION, file_size, mtime_ns};
+    auto expected = [layout_hash](const DifficultyIndexHeader &h) -> uint64_t
+    {
+        if (h.layout_hash != layout_hash || h.text_count == 0)
+            return 0;
+        return sizeof(h) + 3 * CacheFile::padded(h.text_count * sizeof(uint32_t));
+    };
+    if (!cache_.map(filename, stamp, header, expected))
+        return false;
+
+    text_count_ = header.text_count;
+    scores_ = cache_.next<float>(text_count_);
+    order_ = cache_.next<uint32_t>(text_count_);
+    sorted_scores_ = cache_.next<float>(text_count_);
+    return true;
+}
+
+void DifficultyIndex::build(const TextProvider &provider, const KeyboardLayout &layout, unsigned threads)
+{
+    text_count_ = provider.size();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, std::max<size_t>(1, text_count_ / 1024));
+
+    auto runParallel = [threads](auto &&job)
+    {
+        std::vector<std::thread> pool;
+        for (unsigned part = 1; part < threads; ++part)
+            pool.emplace_back(job, part);
+        job(0);
+        for (auto &thread : pool)
+            thread.join();
+    };
+    auto partFirst = [&](unsigned part) { return text_count_ * part / threads; };
+
+    // Проход 1: частоты символов корпуса, чтобы знать, какие из них редкие
+    std::vector<std::vector<uint64_t>> part_counts(threads, std::vector<uint64_t>(LayoutTable::DIRECT_LIMIT, 0));
+    runParallel([&](unsigned part)
+                {
+                    auto &counts = part_counts[part];
+                    for (size_t text = partFirst(part); text < partFirst(part + 1); ++text)
+                    {
+                        std::string_view utf8 = provider.getText(text);
+                        for (size_t pos = 0; pos < utf8.size();)
+                        {
+                            wchar_t c = nextChar(utf8, pos);
+                            if (static_cast<uint32_t>(c) < LayoutTable::DIRECT_LIMIT && !isSpace(c))
+                                counts[c]++;
+                        }
+                    }
+                });
+
+    uint64_t total = 0;
+    std::vector<uint64_t> counts(LayoutTable::DIRECT_LIMIT, 0);
+    for (const auto &part : part_counts)
+    {
+        for (uint32_t c = 0; c < LayoutTable::DIRECT_LIMIT; ++c)
+        {
+            counts[c] += part[c];
+            total += part[c];
+        }
+    }
+    part_counts.clear();
+
+    // Таблица признаков: все, что нужно знать о символе, одним чтением
+    std::vector<uint16_t> features(LayoutTable::DIRECT_LIMIT, 0);
+    for (uint32_t c = 0; c < LayoutTable::DIRECT_LIMIT; ++c)
+    {
+        uint16_t flags = static_cast<uint16_t>(layout.find(static_cast<wchar_t>(c)) + 1);
+        if (isPunctuation(c))
+            flags |= PUNCTUATION;
+        if (!isSpace(c) && counts[c] < RARE_SHARE * total)
+            flags |= RARE;
+        features[c] = flags;
+    }
+    uint8_t fingers[LayoutTable::MAX_KEYS];
+    uint8_t rows[LayoutTable::MAX_KEYS];
+    for (int key = 0; key < layout.keyCount(); ++key)
+    {
+        fingers[key] = layout.key(key).finger;
+        rows[key] = layout.key(key).row;
+    }
+
+    // Проход 2: составляющие и оценка каждого текста
+    built_scores_.assign(text_count_, 0);
+    runParallel([&](unsigned part)
+                {
+                    for (size_t text = partFirst(part); text < partFirst(part + 1); ++text)
+                    {
+                        std::string_view utf8 = provider.getText(text);
+                        Features f;
+                        int previous = -1;
+                        for (size_t pos = 0; pos < utf8.size(); ++f.length)
+                        {
+                            wchar_t c = nextChar(utf8, pos);
+                            uint32_t code = static_cast<uint32_t>(c);
+                            // Символы за пределами таблицы всегда редкие
+                            uint16_t flags = code < LayoutTable::DIRECT_LIMIT
+                                                 ? features[code]
+                                                 : static_cast<uint16_t>((layout.find(c) + 1) | RARE |
+                                                                         (isPunctuation(code) ? PUNCTUATION : 0));
+                            f.rare += (flags & RARE) != 0;
+                            f.punctuation += (flags & PUNCTUATION) != 0;
+                            int key = (flags & KEY_MASK) - 1;
+                            if (key >= 0 && previous >= 0)
+                            {
+                                ++f.bigrams;
+                                f.same_finger += key != previous && fingers[key] == fingers[previous];
+                                f.row_jumps += std::abs(rows[key] - rows[previous]) >= 2;
+                            }
+                            previous = key;
+                        }
+                        built_scores_[text] = combine(f);
+                    }
+                });
+
+    // Порядок по оценке; при равных - по номеру, чтобы кэш не зависел от сортировки
+    built_order_.resize(text_count_);
+    for (size_t text = 0; text < text_count_; ++text)
+        built_order_[text] = static_cast<uint32_t>(text);
+    std::sort(built_order_.begin(), built_order_.end(), [this](uint32_t a, uint32_t b)
+              { return built_scores_[a] != built_scores_[b] ? built_scores_[a] < built_scores_[b] : a < b; });
+    built_sorted_.resize(text_count_);
+    for (size_t position = 0; position < text_count_; ++position)
+        built_sorted_[position] = built_scores_[built_order_[position]];
+
+    scores_ = built_scores_.data();
+    order_ = built_order_.data();
+    sorted_scores_ = built_sorted_.data();
+}
+
+void DifficultyIndex::save(const std::string &filename, uint64_t file_size, int64_t mtime_ns, uint64_t layout_hash) const
+{
+    if (text_count_ == 0)
+        return;
+
+    DifficultyIndexHeader header{};
+    CacheFile::stamp(header, {"DIFF", FORMAT_VERSION, file_size, mtime_ns});
+    header.text_count = text_count_;
+    header.layout_hash = layout_hash;
+    CacheFile::write(filename, &header, sizeof(header),
+                     {{scores_, text_count_ * sizeof(float)},
+                      {order_, text_count_ * sizeof(uint32_t)},
+                      {sorted_scores_, text_count_ * sizeof(float)}});
+}
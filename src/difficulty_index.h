@@ -0,0 +1,92 @@
+#pragma once
+#include "text_provider.h"
+#include "keyboard_layout.h"
+#include "cache_file.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Заголовок кэша оценок (<файл>.<раскладка>.difficulty). За ним массивы: оценки по номеру текста,
+// номера текстов по возрастанию оценки и оценки в том же порядке
+struct DifficultyIndexHeader
+{
+    char magic[4]; // "DIFF"
+    uint32_t version;
+    uint64_t file_size;    // размер и время изменения корпуса,
+    int64_t file_mtime_ns; // для которого посчитаны оценки
+    uint64_t text_count;
+    uint64_t layout_hash; // клавиши, ряды и пальцы раскладки
+    uint8_t padding[24];
+};
+static_assert(sizeof(DifficultyIndexHeader) == 64, "DifficultyIndexHeader must stay 64 bytes");
+
+// Сложность каждого текста корпуса на раскладке, посчитанная один раз: длина, доля редких символов,
+// плотность пунктуации и цифр, доля пар подряд одним пальцем и пар через ряд. Каждая составляющая
+// приводится к 0..1 с насыщением и входит с весом, итог - от 0 до 100.
+// Символ разбирается одним обращением к таблице признаков (клавиша, редкий, знак, цифра),
+// пары сравниваются по таблице клавиш, поэтому оценка корпуса - один проход по тексту в несколько потоков.
+// Тексты упорядочены по оценке: полоса сложности - непрерывный отрезок порядка, диапазон оценок
+// находится двоичным поиском, а текст полосы, которого не было среди недавних, - за несколько проб
+class DifficultyIndex
+{
+public:
+    static const uint32_t FORMAT_VERSION = 1;
+    // Полосы сложности 1..BAND_COUNT - равные доли корпуса от легких текстов к трудным
+    static constexpr int BAND_COUNT = 10;
+    // Символ редкий, если его доля среди непробельных символов корпуса меньше
+    static constexpr double RARE_SHARE = 0.005;
+    static const uint32_t NONE = UINT32_MAX;
+
+    // Составляющие оценки текста до взвешивания
+    struct Features
+    {
+        uint32_t length = 0;
+        uint32_t rare = 0;
+        uint32_t punctuation = 0; // знаки и цифры
+        uint32_t bigrams = 0;     // пары соседних символов, обе на клавишах
+        uint32_t same_finger = 0; // разные клавиши одним пальцем
+        uint32_t row_jumps = 0;   // через ряд (верхний - нижний)
+    };
+
+    // Оценки берутся из кэша рядом с корпусом или считаются в threads потоков (0 - по числу ядер)
+    DifficultyIndex(const TextProvider &provider, const KeyboardLayout &layout, unsigned threads = 0);
+
+    DifficultyIndex(const DifficultyIndex &) = delete;
+    DifficultyIndex &operator=(const DifficultyIndex &) = delete;
+
+    // Оценка 0..100 по составляющим
+    static float combine(const Features &features);
+
+    size_t textCount() const { return text_count_; }
+    float score(size_t text) const { return scores_[text]; }
+    bool loadedFromCache() const { return cache_.mapped(); }
+
+    // Отрезок [first, last) порядка по оценке для полосы band (1..BAND_COUNT)
+    std::pair<size_t, size_t> band(int band) const;
+    // Отрезок порядка с оценками в [min_score, max_score] - двоичный поиск
+    std::pair<size_t, size_t> range(float min_score, float max_score) const;
+    uint32_t textAt(size_t position) const { return order_[position]; }
+    float scoreAt(size_t position) const { return sorted_scores_[position]; }
+
+    // Случайный текст полосы, которого нет среди recent (последние набранные); если недавние
+    // все, то любой текст полосы. random - случайное число, выбирающее место начала поиска
+    uint32_t pick(int band, uint64_t random, const std::vector<uint32_t> &recent) const;
+
+    static std::string getIndexFilename(const std::string &corpus_filename, const KeyboardLayout &layout);
+
+private:
+    bool load(const std::string &filename, uint64_t file_size, int64_t mtime_ns, uint64_t layout_hash);
+    void build(const TextProvider &provider, const KeyboardLayout &layout, unsigned threads);
+    void save(const std::string &filename, uint64_t file_size, int64_t mtime_ns, uint64_t layout_hash) const;
+
+    const float *scores_ = nullptr;
+    const uint32_t *order_ = nullptr;
+    const float *sorted_scores_ = nullptr;
+    size_t text_count_ = 0;
+
+    // Либо отображенный кэш, либо посчитанные в памяти массивы
+    CacheFile cache_;
+    std::vector<float> built_scores_;
+    std::vector<uint32_t> built_order_;
+    std::vector<float> built_sorted_;
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+
+// Таймер цикла событий: срабатывает один раз в заданный момент, пока его не перезапустят
+class EventTimer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void start(Clock::time_point deadline)
+    {
+        deadline_ = deadline;
+        active_ = true;
+    }
+    void stop() { active_ = false; }
+
+    bool active() const { return active_; }
+    bool expired(Clock::time_point now) const { return active_ && now >= deadline_; }
+    Clock::time_point deadline() const { return deadline_; }
+
+private:
+    Clock::time_point deadline_{};
+    bool active_ = false;
+};
+
+// Сколько миллисекунд ждать ввода до ближайшего активного таймера (-1 - без ограничения)
+template <typename... Timers>
+int waitTimeoutMs(EventTimer::Clock::time_point now, const Timers &...timers)
+{
+    int timeout = -1;
+    auto consider = [&](const EventTimer &timer)
+    {
+        if (!timer.active())
+            return;
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(timer.deadline() - now).count();
+        int ms = static_cast<int>(std::max<decltype(left)>(left, 0));
+        timeout = timeout < 0 ? ms : std::min(timeout, ms);
+    };
+    (consider(timers), ...);
+    return timeout;
+}
@@ -0,0 +1,255 @@
+#include "history_chart.h"
+#include "stats_history.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace
+{
+    // Уровни заполнения клетки снизу вверх, от 1/8 до целой
+    const char *const EIGHTHS[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+    const int LEVELS_PER_ROW = 8;
+}
+
+void HistoryChart::Node::merge(const Node &other)
+{
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+    if (other.count == 0)
+        return;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+}
+
+bool HistoryChart::View::handleKey(wint_t key)
+{
+    size_t step = std::max<size_t>(1, visible_ / 4);
+    switch (key)
+    {
+    case '+':
+    case '=':
+        ++zoom;
+        return true;
+    case '-':
+        if (zoom == 0)
+            return false;
+        --zoom;
+        return true;
+    case '<':
+    case ',':
+        offset += step;
+        return true;
+    case '>':
+    case '.':
+        if (offset == 0)
+            return false;
+        offset -= std::min(offset, step);
+        return true;
+    }
+    return false;
+}
+
+std::pair<size_t, size_t> HistoryChart::View::window(size_t points, size_t columns)
+{
+    size_t min_visible = std::min(points, columns);
+    zoom = std::clamp(zoom, 0, 62);
+    while (zoom > 0 && (points >> zoom) < min_visible)
+        --zoom;
+    visible_ = std::max(points >> zoom, min_visible);
+    offset = std::min(offset, points - visible_);
+    return {points - offset - visible_, points - offset};
+}
+
+void HistoryChart::build(const StatsHistory &history)
+{
+    levels_.clear();
+    for (const StatsRollup &rollup : history.rollups())
+    {
+        append(rollup.cpm.sum, rollup.count, static_cast<float>(rollup.cpm.min),
+               static_cast<float>(rollup.cpm.max));
+    }
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        float cpm = static_cast<float>(history.at(i).cpm);
+        append(cpm, 1, cpm, cpm);
+    }
+}
+
+void HistoryChart::append(double sum, uint32_t count, float min, float max)
+{
+    if (levels_.empty())
+        levels_.emplace_back();
+    levels_[0].push_back({min, max, sum, count});
+
+    // Поднимаемся по предкам новой точки: последний узел каждого уровня пересчитывается
+    size_t index = levels_[0].size() - 1;
+    for (size_t level = 0; levels_[level].size() > 1; ++level)
+    {
+        size_t parent = index / 2;
+        Node node = levels_[level][parent * 2];
+        if (parent * 2 + 1 < levels_[level].size())
+            node.merge(levels_[level][parent * 2 + 1]);
+        if (level + 1 == levels_.size())
+            levels_.emplace_back();
+        std::vector<Node> &upper = levels_[level + 1];
+        if (parent < upper.size())
+            upper[parent] = node;
+        else
+            upper.push_back(node);
+        index = parent;
+    }
+}
+
+HistoryChart::Node HistoryChart::aggregate(size_t first, size_t last) const
+{
+    Node result{0.0f, 0.0f, 0.0, 0};
+    for (size_t level = 0; first < last; ++level)
+    {
+        if (first & 1)
+            result.merge(levels_[level][first++]);
+        if (last & 1)
+            result.merge(levels_[level][--last]);
+        first >>= 1;
+        last >>= 1;
+    }
+    return result;
+}
+
+void HistoryChart::downsample(size_t first, size_t last, size_t columns, std::vector<Column> &out) const
+{
+    out.clear();
+    last = std::min(last, size());
+    if (first >= last || columns == 0)
+        return;
+    size_t count = last - first;
+    columns = std::min(columns, count);
+
+    // Кандидаты LTTB - узлы уровня, где на столбец приходится хотя бы два узла:
+    // работа не зависит от числа точек в окне
+    int level = 0;
+    while ((count >> (level + 1)) >= 2 * columns)
+        ++level;
+
+    struct Candidate
+    {
+        double x; // середина узла в номерах точек
+        double y; // среднее узла
+    };
+    std::vector<Candidate> candidates;
+    std::vector<size_t> bucket_start(columns + 1, 0);
+    for (size_t block = first >> level; (block << level) < last; ++block)
+    {
+        size_t from = std::max(first, block << level);
+        size_t to = std::min(last, (block + 1) << level);
+        Node node = (from == (block << level) && to == ((block + 1) << level))
+                        ? levels_[level][block]
+                        : aggregate(from, to);
+        candidates.push_back({(from + to) / 2.0, node.mean()});
+    }
+
+    // Столбец c охватывает точки [first + c * count / columns, first + (c + 1) * count / columns)
+    auto columnStart = [&](size_t c)
+    {
+        return first + c * count / columns;
+    };
+    for (size_t c = 0, k = 0; c <= columns; ++c)
+    {
+        double start = static_cast<double>(columnStart(c));
+        while (k < candidates.size() && candidates[k].x < start)
+            ++k;
+        bucket_start[c] = c == columns ? candidates.size() : k;
+    }
+
+    // Из каждого столбца берется кандидат, образующий наибольший треугольник
+    // с точкой, выбранной в предыдущем столбце, и средним следующего столбца
+    Candidate anchor = candidates.front();
+    for (size_t c = 0; c < columns; ++c)
+    {
+        Candidate next = candidates.back();
+        if (c + 1 < columns && bucket_start[c + 1] < bucket_start[c + 2])
+        {
+            double x = 0.0, y = 0.0;
+            for (size_t k = bucket_start[c + 1]; k < bucket_start[c + 2]; ++k)
+            {
+                x += candidates[k].x;
+                y += candidates[k].y;
+            }
+            size_t n = bucket_start[c + 2] - bucket_start[c + 1];
+            next = {x / n, y / n};
+        }
+
+        Node range = aggregate(columnStart(c), columnStart(c + 1));
+        Candidate chosen = {0.0, range.mean()};
+        double best = -1.0;
+        for (size_t k = bucket_start[c]; k < bucket_start[c + 1]; ++k)
+        {
+            const Candidate &p = candidates[k];
+            double area = std::fabs((anchor.x - next.x) * (p.y - anchor.y) -
+                                    (anchor.x - p.x) * (next.y - anchor.y));
+            if (area > best)
+            {
+                best = area;
+                chosen = p;
+            }
+        }
+        anchor = chosen;
+        out.push_back({static_cast<float>(chosen.y), range.min, range.max, columnStart(c + 1) == size()});
+    }
+}
+
+void HistoryChart::render(Renderer &renderer, int top, int left, int rows,
+                          const std::vector<Column> &columns, float scale)
+{
+    if (columns.empty() || rows <= 0 || scale <= 0.0f)
+        return;
+    int total_levels = rows * LEVELS_PER_ROW;
+    auto levelOf = [&](float value)
+    {
+        int level = static_cast<int>(std::lround(value / scale * total_levels));
+        return std::clamp(level, 0, total_levels);
+    };
+
+    std::string run;
+    for (int row = 0; row < rows; ++row)
+    {
+        // Уровни, которые покрывает строка: (base, base + 8]
+        int base = (rows - 1 - row) * LEVELS_PER_ROW;
+        renderer.moveCursor(top + row, left);
+        int run_color = 0;
+        run.clear();
+        for (const Column &column : columns)
+        {
+            int value = levelOf(column.value);
+            int max = levelOf(column.max);
+            const char *glyph = " ";
+            int color = Renderer::COLOR_UNTYPED;
+            if (value > base)
+            {
+                glyph = EIGHTHS[std::min(value - base, LEVELS_PER_ROW) - 1];
+                color = column.last ? Renderer::COLOR_CURRENT : Renderer::COLOR_TYPED;
+            }
+            else if (max > base && (value + LEVELS_PER_ROW - 1) / LEVELS_PER_ROW * LEVELS_PER_ROW <= base)
+            {
+                // Выше столбца до максимума столбца - разброс сессий
+                glyph = "│";
+            }
+
+            if (color != run_color && !run.empty())
+            {
+                renderer.setColor(run_color);
+                renderer.displayText(run);
+                run.clear();
+            }
+            run_color = color;
+            run += glyph;
+        }
+        renderer.setColor(run_color);
+        renderer.displayText(run);
+    }
+    renderer.resetColor();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "renderer.h"
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <utility>
+#include <vector>
+
+class StatsHistory;
+
+// График скорости по всей истории, сколько бы в ней ни было сессий.
+// Над рядом строится пирамида: на каждом уровне узел объединяет два узла нижнего уровня
+// (минимум, максимум, сумма и число сессий), поэтому минимум, максимум и среднее любого
+// диапазона считаются за O(log n), а прореживание окна просмотра до ширины экрана
+// (Largest-Triangle-Three-Buckets по узлам подходящего уровня) - за O(столбцов log n)
+class HistoryChart
+{
+public:
+    struct Column
+    {
+        float value; // выбранная LTTB точка столбца
+        float min;   // крайние значения всех сессий столбца
+        float max;
+        bool last;   // в столбец попала последняя точка ряда
+    };
+
+    // Окно просмотра на экране результатов: масштаб и сдвиг назад от последней точки
+    struct View
+    {
+        int zoom = 0;      // видна 1/2^zoom часть ряда, но не меньше точки на столбец
+        size_t offset = 0; // на сколько точек окно сдвинуто от конца ряда
+
+        // +/- (или =) меняют масштаб, </> (или ,/.) сдвигают окно на четверть; true - вид изменился
+        bool handleKey(wint_t key);
+        // Видимый отрезок [first, last) ряда из points точек при columns столбцах;
+        // масштаб и сдвиг поджимаются к допустимым
+        std::pair<size_t, size_t> window(size_t points, size_t columns);
+
+    private:
+        size_t visible_ = 0; // ширина окна при последней отрисовке, шаг сдвига - ее четверть
+    };
+
+    // Ряд: сначала свертки (среднее за период), затем отдельные сессии
+    void build(const StatsHistory &history);
+    // Добавляет точку за O(log n): count сессий со средним sum / count
+    void append(double sum, uint32_t count, float min, float max);
+
+    size_t size() const { return levels_.empty() ? 0 : levels_[0].size(); }
+
+    // Прореживает точки [first, last) до не более чем columns столбцов
+    void downsample(size_t first, size_t last, size_t columns, std::vector<Column> &out) const;
+
+    // Рисует столбцы высотой rows строк от строки top (по 8 уровней на строку, блоки ▁..█),
+    // над столбцом тонкой линией - максимум; scale - значение, соответствующее полной высоте.
+    // Каждая строка собирается целиком и выводится отрезками одного цвета
+    static void render(Renderer &renderer, int top, int left, int rows,
+                       const std::vector<Column> &columns, float scale);
+
+private:
+    struct Node
+    {
+        float min;
+        float max;
+        double sum;
+        uint64_t count;
+
+        void merge(const Node &other);
+        double mean() const { return count ? sum / count : 0.0; }
+    };
+
+    // Объединение точек [first, last)
+    Node aggregate(size_t first, size_t last) const;
+
+    std::vector<std::vector<Node>> levels_;
+};
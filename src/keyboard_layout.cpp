@@ -0,0 +1,195 @@
+#include "keyboard_layout.h"
+#include "case_fold.h"
+#include "decoded_text.h"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    // Пальцы по номеру клавиши в ряду при стандартной постановке рук
+    constexpr uint8_t DEFAULT_FINGERS[] = {0, 1, 2, 3, 3, 4, 4, 5, 6, 7, 7, 7, 7, 7, 7, 7};
+
+    constexpr uint8_t defaultFinger(int col)
+    {
+        return DEFAULT_FINGERS[col < 16 ? col : 15];
+    }
+
+    constexpr bool addKey(LayoutTable &table, uint32_t label, int row, int col, int finger)
+    {
+        if (table.key_count >= LayoutTable::MAX_KEYS)
+            return false;
+
+        int index = table.key_count++;
+        table.keys[index] = {static_cast<wchar_t>(label), static_cast<uint8_t>(row),
+                             static_cast<uint8_t>(col), static_cast<uint8_t>(finger)};
+        table.row_lengths[row]++;
+        table.map(label, index);
+        table.map(simpleLower(label), index);
+        return true;
+    }
+
+    constexpr LayoutTable makeTable(const wchar_t *row1, const wchar_t *row2, const wchar_t *row3)
+    {
+        LayoutTable table;
+        const wchar_t *rows[] = {row1, row2, row3};
+        for (int row = 0; row < LayoutTable::ROW_COUNT; ++row)
+        {
+            for (int col = 0; rows[row][col] != 0; ++col)
+                addKey(table, rows[row][col], row, col, defaultFinger(col));
+        }
+        return table;
+    }
+
+    constexpr LayoutTable QWERTY_TABLE = makeTable(L"QWERTYUIOP[]", L"ASDFGHJKL;'", L"ZXCVBNM,./");
+    constexpr LayoutTable JCUKEN_TABLE = makeTable(L"ЙЦУКЕНГШЩЗХЪ", L"ФЫВАПРОЛДЖЭ", L"ЯЧСМИТЬБЮ.");
+
+    static_assert(QWERTY_TABLE.find('q') == 0 && QWERTY_TABLE.find('/') == 32, "QWERTY table");
+    static_assert(JCUKEN_TABLE.find(L'ж') == JCUKEN_TABLE.find(L'Ж'), "JCUKEN table");
+
+    std::string trim(const std::string &text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+}
+
+KeyboardLayout::KeyboardLayout(std::string name, const LayoutTable *table)
+    : name_(std::move(name)), table_(table) {}
+
+KeyboardLayout::KeyboardLayout(std::string name, std::unique_ptr<LayoutTable> table)
+    : name_(std::move(name)), owned_table_(std::move(table)), table_(owned_table_.get()) {}
+
+const KeyboardLayout &KeyboardLayout::qwerty()
+{
+    static const KeyboardLayout layout("qwerty", &QWERTY_TABLE);
+    return layout;
+}
+
+const KeyboardLayout &KeyboardLayout::jcuken()
+{
+    static const KeyboardLayout layout("jcuken", &JCUKEN_TABLE);
+    return layout;
+}
+
+const KeyboardLayout &KeyboardLayout::forText(const std::wstring &text)
+{
+    for (wchar_t c : text)
+    {
+        if ((c >= L'А' && c <= L'я') || c == L'Ё' || c == L'ё')
+            return jcuken();
+        if ((c >= L'A' && c <= L'Z') || (c >= L'a' && c <= L'z'))
+            return qwerty();
+    }
+    return qwerty();
+}
+
+std::string KeyboardLayout::getLayoutFilename(const std::string &name)
+{
+    return "data/layouts/" + name + ".layout";
+}
+
+std::unique_ptr<KeyboardLayout> KeyboardLayout::load(const std::string &name)
+{
+    if (name == "qwerty")
+        return std::make_unique<KeyboardLayout>(name, &QWERTY_TABLE);
+    if (name == "jcuken")
+        return std::make_unique<KeyboardLayout>(name, &JCUKEN_TABLE);
+
+    std::string filename = getLayoutFilename(name);
+    if (!std::filesystem::exists(filename))
+        return nullptr;
+    return fromFile(filename);
+}
+
+std::unique_ptr<KeyboardLayout> KeyboardLayout::fromFile(const std::string &filename)
+{
+    // Формат: строки "ключ: значение", комментарии начинаются с #.
+    //   name: Dvorak
+    //   row: ' , . P Y F G C R L / =     - клавиши ряда через пробел, сверху вниз
+    //   fingers: 0 1 2 3 3 4 4 5 6 7 7 7 - пальцы для предыдущего ряда, по цифре на каждую клавишу (необязательно)
+    std::ifstream file(filename);
+    if (!file)
+        throw std::runtime_error("Не удалось открыть файл раскладки " + filename);
+
+    int line_number = 0;
+    auto fail = [&](const std::string &message)
+    {
+        std::string where = line_number > 0 ? ", строка " + std::to_string(line_number) : "";
+        throw std::runtime_error("Ошибка в файле раскладки " + filename + where + ": " + message);
+    };
+
+    auto table = std::make_unique<LayoutTable>();
+    std::string name = std::filesystem::path(filename).stem().string();
+    int row = -1;
+    std::wstring wide;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            fail("ожидается \"ключ: значение\"");
+        std::string key = trim(line.substr(0, colon));
+        std::string value = trim(line.substr(colon + 1));
+
+        if (key == "name")
+        {
+            name = value;
+        }
+        else if (key == "row")
+        {
+            if (++row >= LayoutTable::ROW_COUNT)
+                fail("больше трех рядов");
+
+            decodeUtf8(value, wide);
+            int col = 0;
+            for (wchar_t c : wide)
+            {
+                if (c == L' ' || c == L'\t')
+                    continue;
+                if (!addKey(*table, c, row, col, defaultFinger(col)))
+                    fail("слишком много клавиш");
+                table->map(simpleLower(c), table->key_count - 1);
+                table->map(simpleUpper(c), table->key_count - 1);
+                ++col;
+            }
+        }
+        else if (key == "fingers")
+        {
+            if (row < 0)
+                fail("fingers раньше первого row");
+
+            int first = table->key_count - table->row_lengths[row];
+            int col = 0;
+            for (char c : value)
+            {
+                if (c == ' ' || c == '\t')
+                    continue;
+                if (c < '0' || c > '7' || col >= table->row_lengths[row])
+                    fail("fingers: ожидаются цифры 0-7 по одной на клавишу");
+                table->keys[first + col++].finger = static_cast<uint8_t>(c - '0');
+            }
+            // Без этой проверки остаток ряда молча остался бы на пальцах по умолчанию
+            if (col != table->row_lengths[row])
+                fail("fingers: " + std::to_string(col) + " цифр на " + std::to_string(table->row_lengths[row]) + " клавиш ряда");
+        }
+        else
+        {
+            fail("неизвестный ключ " + key);
+        }
+    }
+
+    line_number = 0;
+    if (table->key_count == 0)
+        fail("нет ни одного ряда");
+
+    return std::make_unique<KeyboardLayout>(name, std::move(table));
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <cwchar>
+
+// Клавиша раскладки: подпись, ряд, номер в ряду и палец (0-3 левая рука от мизинца,
+// 4-7 правая рука от указательного)
+struct LayoutKey
+{
+    wchar_t label;
+    uint8_t row;
+    uint8_t col;
+    uint8_t finger;
+};
+
+// Скомпилированная раскладка: клавиши и таблица код символа -> номер клавиши.
+// Коды до DIRECT_LIMIT (латиница, кириллица) ищутся прямой индексацией,
+// остальные - в маленькой хеш-таблице с открытой адресацией
+struct LayoutTable
+{
+    static constexpr int ROW_COUNT = 3;
+    static constexpr int MAX_KEYS = 48;
+    static constexpr uint32_t DIRECT_LIMIT = 0x500;
+    static constexpr int OVERFLOW_SLOTS = 128;
+
+    struct OverflowSlot
+    {
+        uint32_t code = 0;
+        int8_t key = -1;
+    };
+
+    LayoutKey keys[MAX_KEYS] = {};
+    uint8_t key_count = 0;
+    uint8_t row_lengths[ROW_COUNT] = {};
+    int8_t direct[DIRECT_LIMIT] = {};
+    OverflowSlot overflow[OVERFLOW_SLOTS] = {};
+
+    constexpr LayoutTable()
+    {
+        for (uint32_t i = 0; i < DIRECT_LIMIT; ++i)
+            direct[i] = -1;
+    }
+
+    constexpr int find(uint32_t code) const
+    {
+        if (code < DIRECT_LIMIT)
+            return direct[code];
+        for (int i = 0, slot = code % OVERFLOW_SLOTS; i < OVERFLOW_SLOTS; ++i, slot = (slot + 1) % OVERFLOW_SLOTS)
+        {
+            if (overflow[slot].key < 0)
+                return -1;
+            if (overflow[slot].code == code)
+                return overflow[slot].key;
+        }
+        return -1;
+    }
+
+    constexpr void map(uint32_t code, int key)
+    {
+        if (code < DIRECT_LIMIT)
+        {
+            direct[code] = static_cast<int8_t>(key);
+            return;
+        }
+        for (int i = 0, slot = code % OVERFLOW_SLOTS; i < OVERFLOW_SLOTS; ++i, slot = (slot + 1) % OVERFLOW_SLOTS)
+        {
+            if (overflow[slot].key < 0 || overflow[slot].code == code)
+            {
+                overflow[slot].code = code;
+                overflow[slot].key = static_cast<int8_t>(key);
+                return;
+            }
+        }
+    }
+};
+
+class KeyboardLayout
+{
+public:
+    static constexpr int ROW_COUNT = LayoutTable::ROW_COUNT;
+
+    // Встроенные раскладки (таблицы собираются на этапе компиляции)
+    static const KeyboardLayout &qwerty();
+    static const KeyboardLayout &jcuken();
+    // Встроенная раскладка по первой букве текста: ЙЦУКЕН для кириллицы, иначе QWERTY
+    static const KeyboardLayout &forText(const std::wstring &text);
+
+    // Раскладка из файла описания (data/layouts/<имя>.layout); исключение при ошибке разбора
+    static std::unique_ptr<KeyboardLayout> fromFile(const std::string &filename);
+    // Встроенная раскладка или файл data/layouts/<имя>.layout; nullptr, если нет ни того, ни другого
+    static std::unique_ptr<KeyboardLayout> load(const std::string &name);
+    static std::string getLayoutFilename(const std::string &name);
+
+    const std::string &name() const { return name_; }
+
+    // Номер клавиши для символа (в любом регистре) или -1 - за O(1)
+    int find(wchar_t c) const { return table_->find(static_cast<uint32_t>(c)); }
+    const LayoutKey &key(int index) const { return table_->keys[index]; }
+    int keyCount() const { return table_->key_count; }
+    int rowLength(int row) const { return table_->row_lengths[row]; }
+
+    // Колонка клавиши внутри рамки: ряды сдвинуты, как на настоящей клавиатуре
+    static int keyColumn(const LayoutKey &key) { return 3 + 2 * key.row + 3 * key.col; }
+
+    KeyboardLayout(std::string name, const LayoutTable *table);
+    KeyboardLayout(std::string name, std::unique_ptr<LayoutTable> table);
+
+private:
+    std::string name_;
+    std::unique_ptr<LayoutTable> owned_table_;
+    const LayoutTable *table_;
+};
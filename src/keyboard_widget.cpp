@@ -0,0 +1,77 @@
+#include "keyboard_widget.h"
+#include <algorithm>
+
+namespace
+{
+    // Минимальная ширина рамки, как у встроенных раскладок
+    const int MIN_FRAME_WIDTH = 44;
+}
+
+KeyboardWidget::KeyboardWidget(Renderer &renderer) : renderer_(renderer) {}
+
+int KeyboardWidget::frameWidth(const KeyboardLayout &layout)
+{
+    int frame_width = MIN_FRAME_WIDTH;
+    for (int i = 0; i < layout.keyCount(); ++i)
+    {
+        frame_width = std::max(frame_width, KeyboardLayout::keyColumn(layout.key(i)) + 7);
+    }
+    return frame_width;
+}
+
+void KeyboardWidget::draw(const KeyboardLayout &layout, int top, int left, wchar_t current)
+{
+    layout_ = &layout;
+    top_ = top;
+    left_ = left;
+    highlighted_ = -1;
+    int frame_width = frameWidth(layout);
+
+    // Рисуем рамку со скругленными углами
+    renderer_.setColor(Renderer::COLOR_UNTYPED);
+    for (int i = 0; i < frameHeight(); i++)
+    {
+        bool edge = i == 0 || i == frameHeight() - 1;
+        renderer_.moveCursor(top_ + i, left_);
+        renderer_.displayText(i == 0 ? "╭" : edge ? "╰" : "│");
+        for (int x = 1; x < frame_width - 1; ++x)
+        {
+            renderer_.displayText(edge ? "─" : " ");
+        }
+        renderer_.displayText(i == 0 ? "╮" : edge ? "╯" : "│");
+    }
+
+    for (int i = 0; i < layout.keyCount(); ++i)
+    {
+        drawKey(i, false);
+    }
+    renderer_.resetColor();
+
+    highlight(current);
+}
+
+void KeyboardWidget::highlight(wchar_t current)
+{
+    if (!layout_)
+        return;
+
+    int index = layout_->find(current);
+    if (index == highlighted_)
+        return;
+
+    if (highlighted_ >= 0)
+        drawKey(highlighted_, false);
+    if (index >= 0)
+        drawKey(index, true);
+    highlighted_ = index;
+
+    renderer_.resetColor();
+}
+
+void KeyboardWidget::drawKey(int index, bool highlighted)
+{
+    const LayoutKey &key = layout_->key(index);
+    renderer_.moveCursor(top_ + key.row + 1, left_ + KeyboardLayout::keyColumn(key) + 2);
+    renderer_.setColor(highlighted ? Renderer::COLOR_CURRENT : Renderer::COLOR_UNTYPED);
+    renderer_.displayChar(key.label);
+}
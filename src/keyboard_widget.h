@@ -0,0 +1,29 @@
+#pragma once
+#include "renderer.h"
+#include "keyboard_layout.h"
+
+// Экранная клавиатура. Рамка и клавиши рисуются один раз,
+// дальше перерисовываются только клавиши, у которых сменилась подсветка
+class KeyboardWidget
+{
+public:
+    explicit KeyboardWidget(Renderer &renderer);
+
+    // Полная отрисовка раскладки; top, left - верхний левый угол рамки
+    void draw(const KeyboardLayout &layout, int top, int left, wchar_t current);
+    // Подсветка клавиши для символа: не больше двух клавиш за вызов
+    void highlight(wchar_t current);
+
+    // Размер рамки раскладки: по самому длинному ряду, не уже встроенных
+    static int frameWidth(const KeyboardLayout &layout);
+    static int frameHeight() { return KeyboardLayout::ROW_COUNT + 2; }
+
+private:
+    void drawKey(int index, bool highlighted);
+
+    Renderer &renderer_;
+    const KeyboardLayout *layout_ = nullptr;
+    int top_ = 0;
+    int left_ = 0;
+    int highlighted_ = -1;
+};
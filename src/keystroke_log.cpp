@@ -0,0 +1,109 @@
+#include "keystroke_log.h"
+#include "weakness_model.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    // Минимальный размер буфера, чтобы короткие тексты с ошибками не сбрасывались посреди сессии
+    const size_t MIN_BUFFER_EVENTS = 256;
+}
+
+KeystrokeLog::KeystrokeLog(const std::string &language)
+    : filename_(getLogFilename(language))
+{
+    std::filesystem::create_directory("stats");
+    fd_ = open(filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+KeystrokeLog::~KeystrokeLog()
+{
+    if (active_)
+    {
+        endSession(true);
+    }
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+}
+
+std::string KeystrokeLog::getLogFilename(const std::string &language)
+{
+    return "stats/" + language + "_keystrokes.bin";
+}
+
+void KeystrokeLog::beginSession(size_t text_length, std::chrono::steady_clock::time_point start)
+{
+    if (active_)
+    {
+        endSession(true);
+    }
+
+    // С запасом на ошибки: обычно нажатий не больше двух на символ
+    size_t capacity = std::max(MIN_BUFFER_EVENTS, text_length * 2);
+    if (buffer_.size() < capacity)
+    {
+        buffer_.resize(capacity);
+    }
+    count_ = 0;
+    active_ = true;
+
+    static std::mt19937_64 gen{std::random_device{}()};
+    session_id_ = gen();
+    text_length_ = static_cast<uint32_t>(text_length);
+    wall_start_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    steady_start_ns_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 start.time_since_epoch())
+                                                 .count());
+}
+
+void KeystrokeLog::endSession(bool aborted)
+{
+    if (!active_)
+    {
+        return;
+    }
+    flushBlock(KEYSTROKE_BLOCK_LAST | (aborted ? KEYSTROKE_BLOCK_ABORTED : 0));
+    active_ = false;
+}
+
+void KeystrokeLog::flushBlock(uint16_t block_flags)
+{
+    if (model_)
+    {
+        model_->observe(buffer_.data(), count_, (block_flags & KEYSTROKE_BLOCK_LAST) != 0);
+    }
+
+    if (fd_ < 0)
+    {
+        count_ = 0;
+        return;
+    }
+
+    KeystrokeBlockHeader header;
+    std::memcpy(header.magic, "KLOG", 4);
+    header.version = FORMAT_VERSION;
+    header.flags = block_flags;
+    header.event_count = static_cast<uint32_t>(count_);
+    header.text_length = text_length_;
+    header.session_id = session_id_;
+    header.wall_start_ns = wall_start_ns_;
+    header.steady_start_ns = steady_start_ns_;
+
+    // Заголовок и события уходят одним вызовом, чтобы блок не разрывался при O_APPEND
+    iovec parts[2] = {
+        {&header, sizeof(header)},
+        {buffer_.data(), count_ * sizeof(KeystrokeEvent)}};
+    ssize_t ignored = writev(fd_, parts, 2);
+    (void)ignored;
+
+    count_ = 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Одно нажатие клавиши. Формат записи в файле совпадает с раскладкой структуры
+struct KeystrokeEvent
+{
+    uint64_t timestamp_ns; // steady_clock, наносекунды
+    uint32_t position;     // позиция в тексте (в символах)
+    uint32_t expected;     // ожидаемый символ (код Unicode)
+    uint32_t actual;       // введенный символ (код Unicode)
+    uint32_t flags;        // KEYSTROKE_CORRECT и т.п.
+};
+static_assert(sizeof(KeystrokeEvent) == 24, "KeystrokeEvent must stay 24 bytes");
+
+// Заголовок блока событий. Файл состоит из блоков: заголовок + event_count событий
+struct KeystrokeBlockHeader
+{
+    char magic[4];          // "KLOG"
+    uint16_t version;       // версия формата
+    uint16_t flags;         // KEYSTROKE_BLOCK_*
+    uint32_t event_count;   // количество событий в блоке
+    uint32_t text_length;   // длина текста сессии в символах
+    uint64_t session_id;    // одинаков для всех блоков одной сессии
+    int64_t wall_start_ns;  // system_clock начала сессии, наносекунды от эпохи
+    uint64_t steady_start_ns; // steady_clock начала сессии
+};
+static_assert(sizeof(KeystrokeBlockHeader) == 40, "KeystrokeBlockHeader must stay 40 bytes");
+
+class WeaknessModel;
+
+class KeystrokeLog
+{
+public:
+    static const uint32_t KEYSTROKE_CORRECT = 1;
+
+    static const uint16_t KEYSTROKE_BLOCK_LAST = 1;    // последний блок сессии
+    static const uint16_t KEYSTROKE_BLOCK_ABORTED = 2; // сессия прервана (ESC)
+
+    static const uint16_t FORMAT_VERSION = 1;
+
+    explicit KeystrokeLog(const std::string &language);
+    ~KeystrokeLog();
+
+    // Начинает новую сессию и заранее выделяет буфер под ожидаемое число нажатий
+    void beginSession(size_t text_length, std::chrono::steady_clock::time_point start);
+
+    // Запись нажатия: без выделений памяти, при заполнении буфер сбрасывается на диск
+    void record(std::chrono::steady_clock::time_point when,
+                uint32_t position, uint32_t expected, uint32_t actual, bool correct)
+    {
+        if (count_ == buffer_.size())
+        {
+            flushBlock(0);
+        }
+        KeystrokeEvent &event = buffer_[count_++];
+        event.timestamp_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count());
+        event.position = position;
+        event.expected = expected;
+        event.actual = actual;
+        event.flags = correct ? KEYSTROKE_CORRECT : 0;
+    }
+
+    // Завершает сессию и дописывает оставшиеся события
+    void endSession(bool aborted);
+
+    // Идентификатор текущей (или последней) сессии; под ним же сохраняется ее результат
+    uint64_t sessionId() const { return session_id_; }
+
+    // Модель слабых мест получает каждый блок событий перед записью на диск
+    void setModel(WeaknessModel *model) { model_ = model; }
+
+    static std::string getLogFilename(const std::string &language);
+
+private:
+    void flushBlock(uint16_t block_flags);
+
+    std::string filename_;
+    int fd_ = -1;
+    std::vector<KeystrokeEvent> buffer_;
+    size_t count_ = 0;
+    bool active_ = false;
+    WeaknessModel *model_ = nullptr;
+
+    uint32_t text_length_ = 0;
+    uint64_t session_id_ = 0;
+    int64_t wall_start_ns_ = 0;
+    uint64_t steady_start_ns_ = 0;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Гистограмма задержек в наносекундах в духе HdrHistogram: каждая октава [2^k, 2^(k+1))
+// делится на SUB_BUCKETS равных частей, относительная погрешность не больше 1/SUB_BUCKETS.
+// Пишет один поток (цикл событий) обычными relaxed load/store без lock-префикса,
+// читать можно из любого потока без блокировок
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BITS = 5;
+    static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BITS;
+    // Значения от 2^MAX_BITS нс (около 18 минут) попадают в последнюю корзину
+    static constexpr int MAX_BITS = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint64_t value_ns)
+    {
+        increment(counts_[bucketIndex(value_ns)], 1);
+        increment(count_, 1);
+        increment(sum_, value_ns);
+        if (value_ns > max_.load(std::memory_order_relaxed))
+            max_.store(value_ns, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t bucketCount(size_t index) const { return counts_[index].load(std::memory_order_relaxed); }
+
+    double mean() const
+    {
+        uint64_t n = count();
+        return n ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+
+    // Значение, не меньше которого q-я доля записей (верхняя граница корзины, но не больше max)
+    uint64_t percentile(double q) const
+    {
+        uint64_t n = count();
+        if (n == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(q * n + 0.5);
+        if (rank < 1)
+            rank = 1;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += bucketCount(i);
+            if (seen >= rank)
+            {
+                uint64_t high = bucketHigh(i);
+                uint64_t top = max();
+                return high < top ? high : top;
+            }
+        }
+        return max();
+    }
+
+    void reset()
+    {
+        for (auto &c : counts_)
+            c.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return static_cast<size_t>(value);
+        int msb = 63 - __builtin_clzll(value);
+        if (msb >= MAX_BITS)
+            return BUCKET_COUNT - 1;
+        uint64_t sub = (value >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1);
+        return static_cast<size_t>((msb - SUB_BITS + 1) * SUB_BUCKETS + sub);
+    }
+
+    // Нижняя и верхняя (включительно) границы значений корзины
+    static uint64_t bucketLow(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+        int msb = static_cast<int>(index / SUB_BUCKETS) + SUB_BITS - 1;
+        uint64_t sub = index % SUB_BUCKETS;
+        return (uint64_t(1) << msb) + (sub << (msb - SUB_BITS));
+    }
+    static uint64_t bucketHigh(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+        int msb = static_cast<int>(index / SUB_BUCKETS) + SUB_BITS - 1;
+        return bucketLow(index) + (uint64_t(1) << (msb - SUB_BITS)) - 1;
+    }
+
+private:
+    static void increment(std::atomic<uint64_t> &counter, uint64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
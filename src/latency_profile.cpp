@@ -0,0 +1,77 @@
+#include "latency_profile.h"
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+const char *LatencyProfile::stageName(int stage)
+{
+    static const char *const names[STAGE_COUNT] = {"check", "draw", "stats", "keyboard", "flush", "total"};
+    return stage >= 0 && stage < STAGE_COUNT ? names[stage] : "?";
+}
+
+void LatencyProfile::finish(KeyTimer &timer)
+{
+    if (!timer.active)
+        return;
+    timer.active = false;
+
+    auto ns = [](Clock::duration d)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    };
+
+    for (int stage = 0; stage < STAGE_TOTAL; ++stage)
+    {
+        histograms_[stage].record(ns(timer.marks[stage + 1] - timer.marks[stage]));
+    }
+    histograms_[STAGE_TOTAL].record(ns(timer.marks[STAGE_TOTAL] - timer.marks[0]));
+}
+
+void LatencyProfile::reset()
+{
+    for (auto &histogram : histograms_)
+        histogram.reset();
+}
+
+void LatencyProfile::dump(const std::string &filename) const
+{
+    std::filesystem::path parent = std::filesystem::path(filename).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent);
+    }
+
+    std::ofstream out(filename);
+    if (!out)
+    {
+        throw std::runtime_error("Не удалось открыть файл " + filename);
+    }
+
+    // Сводка в микросекундах
+    out << std::fixed << std::setprecision(1);
+    out << "# stage count mean_us p50_us p90_us p99_us p999_us max_us\n";
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        const LatencyHistogram &h = histograms_[stage];
+        out << stageName(stage) << ' ' << h.count() << ' ' << h.mean() / 1000.0 << ' '
+            << h.percentile(0.5) / 1000.0 << ' ' << h.percentile(0.9) / 1000.0 << ' '
+            << h.percentile(0.99) / 1000.0 << ' ' << h.percentile(0.999) / 1000.0 << ' '
+            << h.max() / 1000.0 << '\n';
+    }
+
+    // Корзины для построения распределений: этап, границы в наносекундах, количество
+    out << "\n# stage low_ns high_ns count\n";
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        const LatencyHistogram &h = histograms_[stage];
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+        {
+            if (uint64_t n = h.bucketCount(i))
+            {
+                out << stageName(stage) << ' ' << LatencyHistogram::bucketLow(i) << ' '
+                    << LatencyHistogram::bucketHigh(i) << ' ' << n << '\n';
+            }
+        }
+    }
+}
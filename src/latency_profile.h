@@ -0,0 +1,54 @@
+#pragma once
+#include "latency_histogram.h"
+#include <chrono>
+#include <string>
+
+// Задержки обработки нажатия по этапам: от возврата get_wch до сброса кадра в терминал.
+// По соотношению этапов видно, во что упирается отклик - в вычисления или в вывод
+class LatencyProfile
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Stage
+    {
+        STAGE_CHECK,    // проверка символа и запись в журнал нажатий
+        STAGE_DRAW,     // подсветка символов текста
+        STAGE_STATS,    // строка статистики
+        STAGE_KEYBOARD, // экранная клавиатура
+        STAGE_FLUSH,    // сброс кадра в терминал
+        STAGE_TOTAL,    // от ввода до конца сброса
+        STAGE_COUNT
+    };
+
+    static const char *stageName(int stage);
+
+    // Отметки времени одного нажатия; записываются в гистограммы в finish()
+    struct KeyTimer
+    {
+        Clock::time_point marks[STAGE_COUNT + 1];
+        bool active = false;
+    };
+
+    void start(KeyTimer &timer, Clock::time_point input_time) const
+    {
+        timer.marks[0] = input_time;
+        timer.active = true;
+    }
+    // Конец этапа stage (этапы идут по порядку, до STAGE_FLUSH включительно)
+    void mark(KeyTimer &timer, int stage) const
+    {
+        if (timer.active)
+            timer.marks[stage + 1] = Clock::now();
+    }
+    void finish(KeyTimer &timer);
+
+    const LatencyHistogram &histogram(int stage) const { return histograms_[stage]; }
+    void reset();
+
+    // Текстовая сводка по этапам и непустые корзины гистограмм
+    void dump(const std::string &filename) const;
+
+private:
+    LatencyHistogram histograms_[STAGE_COUNT];
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// Строка фиксированной емкости на стеке: сборка строк статистики без выделений памяти.
+// Что не помещается, отбрасывается
+template <size_t Capacity>
+class LineBuffer
+{
+public:
+    LineBuffer &append(std::string_view text)
+    {
+        size_t n = std::min(text.size(), Capacity - size_);
+        std::memcpy(data_ + size_, text.data(), n);
+        size_ += n;
+        return *this;
+    }
+
+    LineBuffer &appendInt(long long value)
+    {
+        auto result = std::to_chars(data_ + size_, data_ + Capacity, value);
+        if (result.ec == std::errc())
+            size_ = result.ptr - data_;
+        return *this;
+    }
+
+    // Число с фиксированным количеством знаков после запятой
+    LineBuffer &appendFixed(double value, int precision)
+    {
+        auto result = std::to_chars(data_ + size_, data_ + Capacity, value,
+                                    std::chars_format::fixed, precision);
+        if (result.ec == std::errc())
+            size_ = result.ptr - data_;
+        return *this;
+    }
+
+    // Дополняет пробелами до заданной длины в байтах (для выравнивания колонок ASCII)
+    LineBuffer &padTo(size_t length)
+    {
+        while (size_ < length && size_ < Capacity)
+            data_[size_++] = ' ';
+        return *this;
+    }
+
+    void clear() { size_ = 0; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    char data_[Capacity];
+    size_t size_ = 0;
+};
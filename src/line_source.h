@@ -0,0 +1,34 @@
+#pragma once
+#include "decoded_text.h"
+#include <cstdint>
+#include <string>
+
+// Источник строк для окна длинного текста в TypingEngine: документ из корпуса (TextStream)
+// или бесконечный поток слов (WordStream). Строки выдаются по одной уже перенесенными
+// под ширину окна, поэтому движку не нужен весь текст
+class LineSource
+{
+public:
+    // Место в источнике: номер элемента (абзаца, слова) и смещение внутри него
+    struct Position
+    {
+        uint64_t item = 0;
+        uint32_t offset = 0;
+    };
+
+    virtual ~LineSource() = default;
+
+    // Следующая строка не шире width колонок; пробел в конце строки может выступать за width.
+    // Буферы out переиспользуются; false - источник кончился
+    virtual bool nextLine(int width, DecodedText &out) = 0;
+    // Начало следующей строки; перенос с другой шириной продолжается с сохраненного места
+    virtual Position tell() const = 0;
+    virtual void seek(const Position &position) = 0;
+    // Место символа pos в строке line, которая начинается в start
+    virtual Position locate(const Position &start, const DecodedText &line, size_t pos) const = 0;
+
+    // Пройденная до position часть в процентах; -1 - у источника нет конца
+    virtual int progress(const Position &position) const = 0;
+    // Текст от начала до position - для истории результатов
+    virtual void copy(const Position &position, std::string &out) const = 0;
+};
@@ -2,30 +2,572 @@
 #include "text_provider.h"
 #include "console_handler.h"
 #include "menu_handler.h"
+#include "stats_store.h"
+#include "alloc_counter.h"
+#include "keyboard_layout.h"
+#include "typing_server.h"
+#include "remote_client.h"
+#include "ngram_index.h"
+#include "markov_model.h"
+#include "weakness_model.h"
+#include "stats_writer.h"
+#include "corpus_bundle.h"
+#include "startup_profile.h"
+#include "corpus_ingest.h"
+#include "difficulty_index.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
 
-int main()
+// Сводка по выводу в терминал: сколько сбросов и байт приходится на один кадр
+static void printRenderStats(uint64_t frames, const RenderCounters &frames_total, const RenderCounters &total)
 {
-    try
+    std::cout << "Кадров: " << frames << std::endl;
+    if (frames > 0)
+    {
+        std::cout << "Сбросов на кадр: " << static_cast<double>(frames_total.flushes) / frames << std::endl;
+        std::cout << "Байт на кадр: " << static_cast<double>(frames_total.bytes) / frames << std::endl;
+    }
+    std::cout << "Всего сбросов: " << total.flushes << ", байт: " << total.bytes << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    StartupProfile::shared().mark("разбор аргументов");
+    bool render_stats = false;
+    bool startup_profile = false;
+    bool latency_overlay = false;
+    std::string latency_file = "stats/latency.txt";
+    std::string layout_name;
+    std::string serve_socket;
+    std::string connect_socket;
+    std::string language_option = "english";
+    std::string drill;
+    std::string ngram_query;
+    bool weakness_report = false;
+    bool adaptive = false;
+    bool long_text = false;
+    int timed_seconds = 0;
+    bool generate = false;
+    int markov_sample = 0;
+    std::string compact_key;
+    CompactionPolicy compaction;
+    uint32_t min_length = 0;
+    uint32_t max_length = UINT32_MAX;
+    int difficulty_band = 0;
+    bool difficulty_sample = false;
+    std::string ingest_output;
+    std::vector<std::string> ingest_inputs;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--render-stats") == 0)
+        {
+            render_stats = true;
+        }
+        else if (std::strcmp(argv[i], "--startup-profile") == 0)
+        {
+            startup_profile = true;
+        }
+        else if (std::strcmp(argv[i], "--pack-corpus") == 0 && i + 2 < argc)
+        {
+            // Упаковка <каталог>/*.txt в набор (make bundle) без запуска интерфейса
+            try
+            {
+                size_t count = CorpusBundle::pack(argv[i + 1], argv[i + 2]);
+                std::cout << "Упаковано корпусов: " << count << " в " << argv[i + 2] << std::endl;
+                return 0;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Ошибка: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--ingest") == 0 && i + 1 < argc)
+        {
+            // Корпус из сырых текстов: --ingest <корпус> <файл>...
+            ingest_output = argv[++i];
+            while (i + 1 < argc && argv[i + 1][0] != '-')
+                ingest_inputs.push_back(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--latency-overlay") == 0)
+        {
+            latency_overlay = true;
+        }
+        else if (std::strcmp(argv[i], "--latency-file") == 0 && i + 1 < argc)
+        {
+            latency_file = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+        {
+            layout_name = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--serve") == 0 || std::strcmp(argv[i], "--connect") == 0)
+        {
+            // Путь к сокету необязателен
+            std::string &socket = argv[i][2] == 's' ? serve_socket : connect_socket;
+            socket = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DEFAULT_SERVER_SOCKET;
+        }
+        else if (std::strcmp(argv[i], "--drill") == 0 && i + 1 < argc)
+        {
+            drill = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--long-text") == 0)
+        {
+            long_text = true;
+        }
+        else if (std::strcmp(argv[i], "--generate") == 0)
+        {
+            generate = true;
+        }
+        else if (std::strcmp(argv[i], "--markov-sample") == 0 && i + 1 < argc)
+        {
+            markov_sample = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+        {
+            // Тест на время: 15, 30 или 60 секунд (можно и другое число)
+            timed_seconds = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--difficulty") == 0 && i + 1 < argc)
+        {
+            // Полоса сложности 1 (самые легкие тексты) .. 10 (самые трудные)
+            difficulty_band = std::clamp(std::atoi(argv[++i]), 1, DifficultyIndex::BAND_COUNT);
+        }
+        else if (std::strcmp(argv[i], "--difficulty-sample") == 0)
+        {
+            difficulty_sample = true;
+        }
+        else if (std::strcmp(argv[i], "--weakness") == 0)
+        {
+            weakness_report = true;
+        }
+        else if (std::strcmp(argv[i], "--adaptive") == 0)
+        {
+            adaptive = true;
+        }
+        else if (std::strcmp(argv[i], "--ngram-query") == 0 && i + 1 < argc)
+        {
+            ngram_query = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--length") == 0 && i + 1 < argc)
+        {
+            // Диапазон длины текстов в символах: MIN-MAX
+            std::sscanf(argv[++i], "%u-%u", &min_length, &max_length);
+        }
+        else if (std::strcmp(argv[i], "--language") == 0 && i + 1 < argc)
+        {
+            language_option = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--compact") == 0 && i + 1 < argc)
+        {
+            compact_key = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--keep-days") == 0 && i + 1 < argc)
+        {
+            // Сколько дней хранить отдельные сессии, прежде чем свернуть их по дням
+            compaction.raw_days = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--export-csv") == 0 && i + 1 < argc)
+        {
+            // Выгрузка истории языка в CSV на stdout без запуска интерфейса
+            try
+            {
+                StatsStore store(argv[i + 1]);
+                store.exportCsv(std::cout);
+                return 0;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Ошибка: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    if (!compact_key.empty())
+    {
+        // Сжатие истории по требованию; само оно запускается при записи результатов
+        try
+        {
+            StatsCompactor::Result result = StatsWriter::shared().compact(compact_key, compaction);
+            std::cout << "Записей: " << result.records_before << " -> " << result.records_after << std::endl;
+            std::cout << "Сверток: " << result.rollups_before << " -> " << result.rollups_after << std::endl;
+            std::cout << "Размер: " << result.bytes_before / 1024 << " КБ -> " << result.bytes_after / 1024 << " КБ" << std::endl;
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (!ingest_output.empty())
+    {
+        // Пополнение корпуса без запуска интерфейса; раскладка - указанная явно или языка корпуса
+        try
+        {
+            std::string language = std::filesystem::path(ingest_output).stem().string();
+            std::unique_ptr<KeyboardLayout> layout = KeyboardLayout::load(layout_name.empty() ? language : layout_name);
+            if (!layout_name.empty() && !layout)
+            {
+                throw std::runtime_error("Неизвестная раскладка " + layout_name);
+            }
+            if (!layout)
+            {
+                layout = KeyboardLayout::load(TextProvider::getLanguageFromFile(ingest_output) == "russian" ? "jcuken" : "qwerty");
+            }
+            if (min_length == 0 && max_length == UINT32_MAX)
+            {
+                min_length = CorpusIngest::DEFAULT_MIN_LENGTH;
+                max_length = CorpusIngest::DEFAULT_MAX_LENGTH;
+            }
+
+            CorpusIngest ingest(*layout, min_length, max_length);
+            auto start = std::chrono::steady_clock::now();
+            CorpusIngest::Stats stats = ingest.run(ingest_inputs, ingest_output);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Прочитано: " << stats.bytes / (1024 * 1024) << " МБ, " << stats.chunks << " кусков за "
+                      << seconds << " с (" << stats.bytes / (1024 * 1024) / std::max(seconds, 1e-9) << " МБ/с)" << std::endl;
+            std::cout << "Предложений: " << stats.sentences << ", не по раскладке " << layout->name() << ": "
+                      << stats.dropped_layout << ", не по длине " << min_length << "-" << max_length << ": "
+                      << stats.dropped_length << ", повторов: " << stats.duplicates << std::endl;
+            std::cout << "Записано в " << ingest_output << ": " << stats.written << std::endl;
+
+            // Оценки сложности на той же раскладке считаются сразу, а не при первом запуске
+            TextProvider provider(ingest_output);
+            auto score_start = std::chrono::steady_clock::now();
+            DifficultyIndex difficulty(provider, *layout);
+            std::cout << "Оценки сложности: " << difficulty.textCount() << " текстов за "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - score_start).count()
+                      << " мс" << std::endl;
+            for (int b = 0; b < CorpusIngest::BUCKET_COUNT; ++b)
+            {
+                uint32_t first = b * CorpusIngest::BUCKET_CHARS;
+                std::cout << "  " << first << (b + 1 < CorpusIngest::BUCKET_COUNT ? "-" + std::to_string(first + CorpusIngest::BUCKET_CHARS - 1) : "+")
+                          << " символов: " << stats.buckets[b] << std::endl;
+            }
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (!serve_socket.empty())
+    {
+        // Сервер для многих пользователей: сессии клиентов в одном процессе
+        try
+        {
+            // Ширина символов в кадрах клиентов считается через wcwidth текущей локали
+            ConsoleHandler::initializeLocale();
+            TypingServer server(serve_socket);
+            std::cout << "Сервер ожидает подключений: " << serve_socket << std::endl;
+            server.run();
+            std::cout << "Обслужено клиентов: " << server.getClientsServed() << std::endl;
+            if (server.getLatency().histogram(LatencyProfile::STAGE_TOTAL).count() > 0)
+            {
+                server.getLatency().dump(latency_file);
+            }
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (markov_sample > 0)
+    {
+        // Строки марковской цепи по корпусу языка без запуска интерфейса
+        try
+        {
+            TextProvider provider("data/" + language_option + ".txt");
+            auto load_start = std::chrono::steady_clock::now();
+            MarkovModel model(provider);
+            auto load_end = std::chrono::steady_clock::now();
+            std::cout << "Модель: " << model.wordCount() << " слов, " << model.contextCount() << " контекстов, "
+                      << model.transitionCount() << " переходов, "
+                      << (model.loadedFromCache() ? "из кэша за " : "построена за ")
+                      << std::chrono::duration<double, std::milli>(load_end - load_start).count() << " мс"
+                      << std::endl;
+
+            // Время - среднее по повторам после прогрева буфера
+            std::mt19937 gen(std::random_device{}());
+            std::string line;
+            const int repeats = 10000;
+            model.generate(gen, line);
+            auto generate_start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; ++r)
+            {
+                model.generate(gen, line);
+            }
+            auto generate_end = std::chrono::steady_clock::now();
+            std::cout << "Строка: " << std::chrono::duration<double, std::micro>(generate_end - generate_start).count() / repeats
+                      << " мкс" << std::endl;
+            for (int r = 0; r < markov_sample; ++r)
+            {
+                model.generate(gen, line);
+                std::cout << line << std::endl;
+            }
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (difficulty_sample)
+    {
+        // Полосы сложности корпуса языка без запуска интерфейса
+        try
+        {
+            TextProvider provider("data/" + language_option + ".txt");
+            std::unique_ptr<KeyboardLayout> layout = KeyboardLayout::load(layout_name.empty() ? language_option : layout_name);
+            std::wstring first_text;
+            decodeUtf8(provider.getText(0), first_text);
+            const KeyboardLayout &active = layout ? *layout : KeyboardLayout::forText(first_text);
+            auto load_start = std::chrono::steady_clock::now();
+            DifficultyIndex index(provider, active);
+            auto load_end = std::chrono::steady_clock::now();
+            std::cout << "Оценки: " << index.textCount() << " текстов, раскладка " << active.name() << ", "
+                      << (index.loadedFromCache() ? "из кэша за " : "посчитаны за ")
+                      << std::chrono::duration<double, std::milli>(load_end - load_start).count() << " мс" << std::endl;
+
+            // Время выбора - среднее по повторам с заполненным списком недавних текстов
+            std::mt19937_64 gen(std::random_device{}());
+            std::vector<uint32_t> recent;
+            const int repeats = 100000;
+            auto pick_start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; ++r)
+            {
+                uint32_t text = index.pick(r % DifficultyIndex::BAND_COUNT + 1, gen(), recent);
+                if (recent.size() < 50)
+                    recent.push_back(text);
+                else
+                    recent[r % 50] = text;
+            }
+            auto pick_end = std::chrono::steady_clock::now();
+            std::cout << "Выбор: " << std::chrono::duration<double, std::nano>(pick_end - pick_start).count() / repeats
+                      << " нс" << std::endl;
+            for (int band = 1; band <= DifficultyIndex::BAND_COUNT; ++band)
+            {
+                auto [first, last] = index.band(band);
+                uint32_t text = index.pick(band, gen(), recent);
+                std::cout << band << '\t' << index.scoreAt(first) << "-" << index.scoreAt(last - 1) << '\t'
+                          << index.score(text) << '\t' << provider.getText(text) << std::endl;
+            }
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (!ngram_query.empty())
+    {
+        // Поиск текстов, богатых заданными n-граммами, без запуска интерфейса
+        try
+        {
+            TextProvider provider("data/" + language_option + ".txt");
+            auto load_start = std::chrono::steady_clock::now();
+            NgramIndex index(provider);
+            auto load_end = std::chrono::steady_clock::now();
+            std::cout << "Индекс: " << index.textCount() << " текстов, " << index.keyCount() << " n-грамм, "
+                      << index.postingCount() << " вхождений, "
+                      << (index.loadedFromCache() ? "из кэша за " : "построен за ")
+                      << std::chrono::duration<double, std::milli>(load_end - load_start).count() << " мс"
+                      << std::endl;
+
+            std::vector<uint64_t> keys = NgramIndex::parseKeys(ngram_query);
+            std::vector<NgramIndex::Match> matches;
+            // Первый запрос прогревает буферы, время - среднее по повторам
+            const int repeats = 1000;
+            index.find(keys.data(), keys.size(), min_length, max_length, 10, matches);
+            auto query_start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; ++r)
+            {
+                index.find(keys.data(), keys.size(), min_length, max_length, 10, matches);
+            }
+            auto query_end = std::chrono::steady_clock::now();
+            std::cout << "Запрос: " << std::chrono::duration<double, std::micro>(query_end - query_start).count() / repeats
+                      << " мкс" << std::endl;
+            for (const auto &match : matches)
+            {
+                std::cout << match.score << '\t' << provider.getText(match.text) << std::endl;
+            }
+            return 0;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (weakness_report)
     {
-        ConsoleHandler console;
-        MenuHandler menu(console);
+        // Самые слабые символы и пары по накопленной модели языка
+        WeaknessModel model(language_option);
+        const WeaknessEntry &total = model.total();
+        std::cout << "Сессий: " << model.sessions() << ", символов: " << total.attempts
+                  << ", ошибок: " << static_cast<int>(total.error_rate * 1000) / 10.0 << "%"
+                  << ", интервал: " << static_cast<int>(total.latency_ms) << " мс" << std::endl;
+        std::vector<WeaknessModel::Unit> units;
+        model.weakest(20, units);
+        std::string text;
+        for (const auto &unit : units)
+        {
+            const WeaknessEntry *entry = model.find(unit.key);
+            text.clear();
+            encodeUtf8(NgramIndex::gram(unit.key), text);
+            std::cout << text << '\t' << static_cast<int>(unit.cost_ms) << " мс\t" << entry->attempts << " раз\t"
+                      << static_cast<int>(entry->error_rate * 1000) / 10.0 << "% ошибок\t"
+                      << static_cast<int>(entry->latency_ms) << " мс" << std::endl;
+        }
+        return 0;
+    }
 
-        std::string selected_file = menu.showLanguageMenu();
-        if (selected_file.empty())
+    if (!connect_socket.empty())
+    {
+        try
         {
+            RemoteClient client(connect_socket);
+            client.run(language_option);
             return 0;
         }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-        // Получаем язык из имени файла (без пути и расширения)
-        std::filesystem::path filepath(selected_file);
-        std::string language = filepath.stem().string();
+    try
+    {
+        uint64_t frames = 0;
+        RenderCounters frames_total;
+        RenderCounters total;
+        uint64_t keystrokes = 0;
+        uint64_t keystroke_allocations = 0;
+        {
+            ConsoleHandler console(render_stats);
+            MenuHandler menu(console);
+
+            std::string selected_file = menu.showLanguageMenu();
+            StartupProfile::shared().mark("выбор языка (ожидание ввода)", true);
+            if (selected_file.empty())
+            {
+                return 0;
+            }
+
+            // Получаем язык из имени файла (без пути и расширения)
+            std::filesystem::path filepath(selected_file);
+            std::string language = filepath.stem().string();
+
+            // Раскладка: указанная явно, либо data/layouts/<язык>.layout, либо по алфавиту текста
+            std::unique_ptr<KeyboardLayout> layout = KeyboardLayout::load(layout_name.empty() ? language : layout_name);
+            if (!layout_name.empty() && !layout)
+            {
+                throw std::runtime_error("Неизвестная раскладка " + layout_name);
+            }
+            StartupProfile::shared().mark("раскладка");
+
+            TextProvider textProvider(selected_file);
+            StartupProfile::shared().mark("тексты");
+            // Случайные тексты - новые строки марковской цепи по корпусу
+            std::unique_ptr<MarkovModel> markov;
+            if (generate)
+            {
+                markov = std::make_unique<MarkovModel>(textProvider);
+                textProvider.setGenerator(markov.get());
+                StartupProfile::shared().mark("марковская модель");
+            }
+            // Оценки сложности на раскладке, на которой будут набираться тексты
+            std::unique_ptr<DifficultyIndex> difficulty;
+            if (difficulty_band > 0)
+            {
+                std::wstring first_text;
+                decodeUtf8(textProvider.getText(0), first_text);
+                difficulty = std::make_unique<DifficultyIndex>(textProvider, layout ? *layout : KeyboardLayout::forText(first_text));
+                StartupProfile::shared().mark("оценки сложности");
+            }
+            // Индекс n-грамм нужен только тренировке n-грамм и подбору по слабым местам (--adaptive);
+            // на новом большом корпусе его построение заметно, поэтому обычный запуск его не ждет
+            // и выбирает строки корпуса случайно
+            adaptive = adaptive && drill.empty() && !difficulty && !generate && !long_text && timed_seconds <= 0;
+            std::unique_ptr<NgramIndex> ngramIndex;
+            if (!drill.empty() || adaptive)
+            {
+                ngramIndex = std::make_unique<NgramIndex>(textProvider);
+                StartupProfile::shared().mark("индекс n-грамм");
+            }
+            TypingSession session(textProvider, console, language, layout.get());
+            session.setLatencyOverlay(latency_overlay);
+            session.setLongText(long_text);
+            session.setTimed(timed_seconds);
+            if (!drill.empty())
+            {
+                session.setDrill(ngramIndex.get(), NgramIndex::parseKeys(drill), min_length, max_length);
+            }
+            else if (difficulty)
+            {
+                session.setDifficulty(difficulty.get(), difficulty_band);
+            }
+            else if (adaptive)
+            {
+                // Подбор по слабым местам выбирает строки корпуса, а не сгенерированные
+                session.setAdaptive(ngramIndex.get(), min_length, max_length);
+            }
+
+            session.start();
+
+            frames = console.getFrameCount();
+            frames_total = console.getFramesCounters();
+            total = console.getTotalCounters();
+            keystrokes = session.getKeystrokeCount();
+            keystroke_allocations = session.getKeystrokeAllocations();
+            if (keystrokes > 0)
+            {
+                session.getLatency().dump(latency_file);
+            }
+        }
+
+        if (startup_profile)
+        {
+            std::cout << "Запуск (" << (CorpusBundle::shared().empty() ? "без набора корпусов"
+                                        : CorpusBundle::shared().isEmbedded() ? "вшитый набор корпусов"
+                                                                              : "набор " + CorpusBundle::getBundleFilename())
+                      << "):" << std::endl;
+            StartupProfile::shared().print(std::cout);
+        }
 
-        TextProvider textProvider(selected_file);
-        TypingSession session(textProvider, console, language);
+        if (render_stats)
+        {
+            printRenderStats(frames, frames_total, total);
+        }
 
-        session.start();
+        // В сборке с подсчетом выделений цикл набора обязан обходиться без них
+        if (alloc_counter::ENABLED)
+        {
+            std::cout << "Нажатий: " << keystrokes << ", выделений памяти: " << keystroke_allocations << std::endl;
+            if (keystroke_allocations > 0)
+            {
+                return 2;
+            }
+        }
 
         return 0;
     }
@@ -34,4 +576,4 @@ int main()
         std::cerr << "Ошибка: " << e.what() << std::endl;
         return 1;
     }
-}
\ No newline at end of file
+}
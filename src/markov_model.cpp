@@ -0,0 +1,302 @@
+#include "markov_model.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    // Сколько подряд пустых предложений генератор терпит, прежде чем вернуть то, что есть
+    const int MAX_EMPTY_SENTENCES = 16;
+
+    // Слова строки - куски между пробелами и управляющими символами; пунктуация остается при слове
+    template <typename Visit>
+    void forEachWord(std::string_view line, Visit &&visit)
+    {
+        size_t pos = 0;
+        while (pos < line.size())
+        {
+            while (pos < line.size() && static_cast<unsigned char>(line[pos]) <= ' ')
+                ++pos;
+            size_t start = pos;
+            while (pos < line.size() && static_cast<unsigned char>(line[pos]) > ' ')
+                ++pos;
+            if (pos > start)
+                visit(line.substr(start, pos - start));
+        }
+    }
+
+    // Символов в UTF-8: байты, не являющиеся продолжением
+    size_t utf8Length(std::string_view text)
+    {
+        size_t length = 0;
+        for (char c : text)
+            length += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+        return length;
+    }
+
+    uint64_t contextKey(uint32_t first, uint32_t second)
+    {
+        return (static_cast<uint64_t>(first) << 21) | second;
+    }
+}
+
+MarkovModel::MarkovModel(const TextProvider &provider, unsigned threads)
+{
+    std::string filename = getModelFilename(provider.getFilename());
+    if (!load(filename, provider.getFileSize(), provider.getFileMtimeNs()))
+    {
+        build(provider, threads);
+        save(filename, provider.getFileSize(), provider.getFileMtimeNs());
+    }
+}
+
+std::string MarkovModel::getModelFilename(const std::string &corpus_filename)
+{
+    return corpus_filename + ".markov";
+}
+
+bool MarkovModel::load(const std::string &filename, uint64_t file_size, int64_t mtime_ns)
+{
+    MarkovModelHeader header;
+    CacheFile::Stamp stamp{"MRKV", FORMAT_VERSION, file_size, mtime_ns};
+    auto expected = [](const MarkovModelHeader &h) -> uint64_t
+    {
+        if (h.order != static_cast<uint32_t>(ORDER) || h.context_count == 0)
+            return 0;
+        return sizeof(h) + CacheFile::padded((h.word_count + 1) * sizeof(uint32_t)) +
+               CacheFile::padded(h.context_count * sizeof(uint64_t)) +
+               CacheFile::padded((h.context_count + 1) * sizeof(uint64_t)) +
+               2 * CacheFile::padded(h.transition_count * sizeof(uint32_t)) +
+               CacheFile::padded(h.word_bytes);
+    };
+    if (!cache_.map(filename, stamp, header, expected))
+        return false;
+
+    word_count_ = header.word_count;
+    context_count_ = header.context_count;
+    transition_count_ = header.transition_count;
+    word_bytes_size_ = header.word_bytes;
+    word_offsets_ = cache_.next<uint32_t>(word_count_ + 1);
+    contexts_ = cache_.next<uint64_t>(context_count_);
+    context_offsets_ = cache_.next<uint64_t>(context_count_ + 1);
+    next_words_ = cache_.next<uint32_t>(transition_count_);
+    cumulative_ = cache_.next<uint32_t>(transition_count_);
+    word_bytes_ = cache_.next<char>(word_bytes_size_);
+    return true;
+}
+
+void MarkovModel::build(const TextProvider &provider, unsigned threads)
+{
+    size_t text_count = provider.size();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, std::max<size_t>(1, text_count / 1024));
+
+    auto runParallel = [threads](auto &&job)
+    {
+        std::vector<std::thread> pool;
+        for (unsigned part = 1; part < threads; ++part)
+            pool.emplace_back(job, part);
+        job(0);
+        for (auto &thread : pool)
+            thread.join();
+    };
+    auto partFirst = [&](unsigned part) { return text_count * part / threads; };
+
+    // Проход 1: частоты слов по частям корпуса. Слова - срезы отображенного корпуса, без копий
+    std::vector<std::unordered_map<std::string_view, uint64_t>> part_words(threads);
+    runParallel([&](unsigned part)
+                {
+                    auto &words = part_words[part];
+                    for (size_t text = partFirst(part); text < partFirst(part + 1); ++text)
+                        forEachWord(provider.getText(text), [&](std::string_view word)
+                                    { words[word]++; });
+                });
+    for (unsigned part = 1; part < threads; ++part)
+    {
+        for (const auto &entry : part_words[part])
+            part_words[0][entry.first] += entry.second;
+        std::unordered_map<std::string_view, uint64_t>().swap(part_words[part]);
+    }
+
+    // Словарь: не больше MAX_WORDS самых частых слов, номера - по алфавиту, чтобы кэш
+    // не зависел от числа потоков. Более редкие слова обрывают предложение
+    std::vector<std::pair<std::string_view, uint64_t>> vocabulary(part_words[0].begin(), part_words[0].end());
+    std::unordered_map<std::string_view, uint64_t>().swap(part_words[0]);
+    if (vocabulary.size() > MAX_WORDS)
+    {
+        std::nth_element(vocabulary.begin(), vocabulary.begin() + MAX_WORDS, vocabulary.end(),
+                         [](const auto &a, const auto &b)
+                         { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+        vocabulary.resize(MAX_WORDS);
+    }
+    std::sort(vocabulary.begin(), vocabulary.end());
+
+    std::unordered_map<std::string_view, uint32_t> ids;
+    ids.reserve(vocabulary.size());
+    built_word_offsets_.assign(1, 0);
+    built_word_offsets_.push_back(0); // слово 0 - граница предложения
+    for (const auto &entry : vocabulary)
+    {
+        ids.emplace(entry.first, static_cast<uint32_t>(built_word_offsets_.size() - 1));
+        built_word_bytes_ += entry.first;
+        built_word_offsets_.push_back(static_cast<uint32_t>(built_word_bytes_.size()));
+    }
+    vocabulary.clear();
+    word_count_ = built_word_offsets_.size() - 1;
+
+    // Проход 2: счетчики троек (два слова контекста и следующее) по частям корпуса
+    std::vector<std::unordered_map<uint64_t, uint32_t>> part_transitions(threads);
+    runParallel([&](unsigned part)
+                {
+                    auto &transitions = part_transitions[part];
+                    for (size_t text = partFirst(part); text < partFirst(part + 1); ++text)
+                    {
+                        uint32_t first = 0, second = 0;
+                        auto add = [&](uint32_t word)
+                        {
+                            transitions[contextKey(first, second) << 21 | word]++;
+                            if (second != 0)
+                                transitions[contextKey(ANY_WORD, second) << 21 | word]++;
+                            first = word ? second : 0;
+                            second = word;
+                        };
+                        forEachWord(provider.getText(text), [&](std::string_view word)
+                                    {
+                                        auto it = ids.find(word);
+                                        if (it != ids.end())
+                                            add(it->second);
+                                        else if (second != 0)
+                                            add(0);
+                                    });
+                        if (second != 0)
+                            add(0);
+                    }
+                });
+
+    std::vector<std::pair<uint64_t, uint32_t>> transitions;
+    for (auto &part : part_transitions)
+    {
+        transitions.insert(transitions.end(), part.begin(), part.end());
+        std::unordered_map<uint64_t, uint32_t>().swap(part);
+    }
+    std::sort(transitions.begin(), transitions.end());
+
+    // Тройки по возрастанию ключа уже сгруппированы по контексту
+    built_next_words_.reserve(transitions.size());
+    built_cumulative_.reserve(transitions.size());
+    for (size_t i = 0; i < transitions.size();)
+    {
+        uint64_t key = transitions[i].first;
+        uint32_t total = 0;
+        built_contexts_.push_back(key >> 21);
+        built_context_offsets_.push_back(built_next_words_.size());
+        for (; i < transitions.size() && transitions[i].first >> 21 == key >> 21; ++i)
+        {
+            total += std::min(transitions[i].second, UINT32_MAX - total);
+            built_next_words_.push_back(static_cast<uint32_t>(transitions[i].first & ANY_WORD));
+            built_cumulative_.push_back(total);
+        }
+    }
+    built_context_offsets_.push_back(built_next_words_.size());
+    context_count_ = built_contexts_.size();
+    transition_count_ = built_next_words_.size();
+    word_bytes_size_ = built_word_bytes_.size();
+
+    word_offsets_ = built_word_offsets_.data();
+    contexts_ = built_contexts_.data();
+    context_offsets_ = built_context_offsets_.data();
+    next_words_ = built_next_words_.data();
+    cumulative_ = built_cumulative_.data();
+    word_bytes_ = built_word_bytes_.data();
+}
+
+void MarkovModel::save(const std::string &filename, uint64_t file_size, int64_t mtime_ns) const
+{
+    if (context_count_ == 0)
+        return;
+
+    MarkovModelHeader header{};
+    CacheFile::stamp(header, {"MRKV", FORMAT_VERSION, file_size, mtime_ns});
+    header.word_count = word_count_;
+    header.context_count = context_count_;
+    header.transition_count = transition_count_;
+    header.word_bytes = word_bytes_size_;
+    header.order = ORDER;
+    CacheFile::write(filename, &header, sizeof(header),
+                     {{word_offsets_, (word_count_ + 1) * sizeof(uint32_t)},
+                      {contexts_, context_count_ * sizeof(uint64_t)},
+                      {context_offsets_, (context_count_ + 1) * sizeof(uint64_t)},
+                      {next_words_, transition_count_ * sizeof(uint32_t)},
+                      {cumulative_, transition_count_ * sizeof(uint32_t)},
+                      {word_bytes_, word_bytes_size_}});
+}
+
+bool MarkovModel::find(uint64_t context, uint64_t &first, uint64_t &last) const
+{
+    const uint64_t *it = std::lower_bound(contexts_, contexts_ + context_count_, context);
+    if (it == contexts_ + context_count_ || *it != context)
+        return false;
+    first = context_offsets_[it - contexts_];
+    last = context_offsets_[it - contexts_ + 1];
+    return true;
+}
+
+uint32_t MarkovModel::next(uint32_t first_word, uint32_t second_word, std::mt19937 &gen) const
+{
+    uint64_t first, last;
+    if (!find(contextKey(first_word, second_word), first, last))
+        return 0;
+    // Редкий контекст продолжил бы исходное предложение: берется одно последнее слово
+    if (second_word != 0 && cumulative_[last - 1] <= BACKOFF_COUNT)
+        find(contextKey(ANY_WORD, second_word), first, last);
+
+    // Слово i выпадает, если r попало в [cumulative[i-1], cumulative[i])
+    std::uniform_int_distribution<uint32_t> dis(0, cumulative_[last - 1] - 1);
+    const uint32_t *pick = std::upper_bound(cumulative_ + first, cumulative_ + last, dis(gen));
+    return next_words_[pick - cumulative_];
+}
+
+void MarkovModel::generate(std::mt19937 &gen, std::string &out) const
+{
+    out.clear();
+    if (context_count_ == 0)
+        return;
+
+    size_t chars = 0;
+    // Конец последнего законченного предложения: строка корпуса или слово с точкой, ! или ?
+    size_t complete = 0;
+    int empty_sentences = 0;
+    while (chars < MIN_LINE_CHARS && empty_sentences < MAX_EMPTY_SENTENCES)
+    {
+        uint32_t first = 0, second = 0;
+        size_t before = chars;
+        while (uint32_t word = next(first, second, gen))
+        {
+            std::string_view text(word_bytes_ + word_offsets_[word], word_offsets_[word + 1] - word_offsets_[word]);
+            size_t length = utf8Length(text);
+            if (!out.empty() && chars + 1 + length > MAX_LINE_CHARS)
+            {
+                // Недописанное предложение отбрасывается, если до него уже есть целое
+                if (complete > 0)
+                    out.resize(complete);
+                return;
+            }
+            if (!out.empty())
+            {
+                out += ' ';
+                chars++;
+            }
+            out += text;
+            chars += length;
+            if (text.back() == '.' || text.back() == '!' || text.back() == '?')
+                complete = out.size();
+            first = second;
+            second = word;
+        }
+        complete = out.size();
+        empty_sentences = chars == before ? empty_sentences + 1 : 0;
+    }
+}
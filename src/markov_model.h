@@ -0,0 +1,96 @@
+#pragma once
+#include "text_provider.h"
+#include "cache_file.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Заголовок кэша модели (<файл>.markov). За ним массивы: смещения слов, контексты,
+// смещения переходов контекстов, следующие слова, накопленные счетчики и байты слов
+struct MarkovModelHeader
+{
+    char magic[4]; // "MRKV"
+    uint32_t version;
+    uint64_t file_size;    // размер и время изменения корпуса,
+    int64_t file_mtime_ns; // для которого построена модель
+    uint64_t word_count;
+    uint64_t context_count;
+    uint64_t transition_count;
+    uint64_t word_bytes;
+    uint32_t order;
+    uint32_t reserved;
+};
+static_assert(sizeof(MarkovModelHeader) == 64, "MarkovModelHeader must stay 64 bytes");
+
+// Словная марковская цепь порядка ORDER по корпусу: каждая строка корпуса - предложение,
+// слово (вместе с пунктуацией и регистром) выбирается по ORDER предыдущим с вероятностью,
+// пропорциональной тому, как часто оно шло за ними в корпусе. Дает сколько угодно новых
+// правдоподобных строк из настоящих слов языка.
+// Контекст, встреченный в корпусе только раз, продолжил бы ровно исходное предложение, поэтому
+// вместо него берется контекст из одного последнего слова: на маленьком корпусе строки смешиваются,
+// а на большом частые сочетания идут по двум словам.
+// Контекст - номера двух слов по 21 биту, переходы контекста лежат подряд с накопленными
+// счетчиками, поэтому выбор слова - двоичный поиск контекста и двоичный поиск по счетчикам
+class MarkovModel
+{
+public:
+    static const uint32_t FORMAT_VERSION = 1;
+    static const int ORDER = 2;
+    // Номер слова занимает 21 бит; 0 - начало и конец предложения, ANY_WORD на месте первого
+    // слова - контекст из одного слова
+    static const uint32_t ANY_WORD = (1u << 21) - 1;
+    static const uint32_t MAX_WORDS = ANY_WORD - 1;
+    // Контекст из двух слов, встреченный не больше стольких раз, заменяется одним словом
+    static const uint32_t BACKOFF_COUNT = 1;
+    // Длина сгенерированной строки в символах: предложения добавляются, пока строка короче
+    // MIN_LINE_CHARS, а слово, после которого строка стала бы длиннее MAX_LINE_CHARS, не берется
+    static const size_t MIN_LINE_CHARS = 40;
+    static const size_t MAX_LINE_CHARS = 160;
+
+    // Модель берется из кэша рядом с корпусом или строится в threads потоков (0 - по числу ядер)
+    explicit MarkovModel(const TextProvider &provider, unsigned threads = 0);
+
+    MarkovModel(const MarkovModel &) = delete;
+    MarkovModel &operator=(const MarkovModel &) = delete;
+
+    // Новая строка из одного или нескольких предложений; буфер out переиспользуется.
+    // Пустая строка - в корпусе нет слов
+    void generate(std::mt19937 &gen, std::string &out) const;
+
+    size_t wordCount() const { return word_count_; }
+    size_t contextCount() const { return context_count_; }
+    size_t transitionCount() const { return transition_count_; }
+    bool loadedFromCache() const { return cache_.mapped(); }
+
+    static std::string getModelFilename(const std::string &corpus_filename);
+
+private:
+    bool load(const std::string &filename, uint64_t file_size, int64_t mtime_ns);
+    void build(const TextProvider &provider, unsigned threads);
+    void save(const std::string &filename, uint64_t file_size, int64_t mtime_ns) const;
+    // Переходы контекста [first, last); false - контекста нет
+    bool find(uint64_t context, uint64_t &first, uint64_t &last) const;
+    // Следующее слово после двух предыдущих; 0 - конец предложения
+    uint32_t next(uint32_t first, uint32_t second, std::mt19937 &gen) const;
+
+    const uint32_t *word_offsets_ = nullptr; // word_count + 1 смещений в word_bytes_; слово 0 пустое
+    const uint64_t *contexts_ = nullptr;     // по возрастанию
+    const uint64_t *context_offsets_ = nullptr;
+    const uint32_t *next_words_ = nullptr;
+    const uint32_t *cumulative_ = nullptr; // счетчики переходов контекста нарастающим итогом
+    const char *word_bytes_ = nullptr;
+    size_t word_count_ = 0;
+    size_t context_count_ = 0;
+    size_t transition_count_ = 0;
+    size_t word_bytes_size_ = 0;
+
+    // Либо отображенный кэш, либо построенные в памяти массивы
+    CacheFile cache_;
+    std::vector<uint32_t> built_word_offsets_;
+    std::vector<uint64_t> built_contexts_;
+    std::vector<uint64_t> built_context_offsets_;
+    std::vector<uint32_t> built_next_words_;
+    std::vector<uint32_t> built_cumulative_;
+    std::string built_word_bytes_;
+};
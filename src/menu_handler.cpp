@@ -1,24 +1,38 @@
 #include "menu_handler.h"
+#include "corpus_bundle.h"
+#include "startup_profile.h"
 #include <filesystem>
 #include <algorithm>
 
 MenuHandler::MenuHandler(ConsoleHandler &console) : console_(console)
 {
     loadAvailableLanguages();
+    StartupProfile::shared().mark("список языков");
 }
 
 void MenuHandler::loadAvailableLanguages()
 {
     menu_items_.clear();
 
+    // Упакованный набор уже содержит список корпусов: каталог не сканируется
+    const CorpusBundle &bundle = CorpusBundle::shared();
+    for (const auto &corpus : bundle.corpora())
+    {
+        std::filesystem::path path = std::filesystem::path("data") / corpus.name;
+        menu_items_.push_back({getDisplayName(path.stem().string()), path.string()});
+    }
+
     // Сканируем директорию data
-    for (const auto &entry : std::filesystem::directory_iterator("data"))
+    if (bundle.empty())
     {
-        if (entry.path().extension() == ".txt")
+        for (const auto &entry : std::filesystem::directory_iterator("data"))
         {
-            std::string filepath = entry.path().string();
-            std::string display_name = getDisplayName(entry.path().stem().string());
-            menu_items_.push_back({display_name, filepath});
+            if (entry.path().extension() == ".txt")
+            {
+                std::string filepath = entry.path().string();
+                std::string display_name = getDisplayName(entry.path().stem().string());
+                menu_items_.push_back({display_name, filepath});
+            }
         }
     }
 
@@ -52,11 +66,14 @@ std::string MenuHandler::showLanguageMenu()
 
     while (true)
     {
+        console_.beginFrame();
         console_.clearScreen();
         console_.displayTextCentered("=== Typing Trainer ===", -5);
         console_.displayTextCentered("Choose language:", -2);
 
         displayMenu(selected);
+        console_.commitFrame();
+        StartupProfile::shared().mark("меню на экране");
 
         wint_t key = console_.getChar();
         switch (key)
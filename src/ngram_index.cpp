@@ -0,0 +1,447 @@
+#include "ngram_index.h"
+#include "case_fold.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    // Номер n-граммы в словаре по ключу: открытая адресация, только для чтения после заполнения
+    class KeyTable
+    {
+    public:
+        explicit KeyTable(const std::vector<uint64_t> &keys)
+        {
+            size_t capacity = 16;
+            while (capacity < keys.size() * 2)
+                capacity <<= 1;
+            mask_ = capacity - 1;
+            slots_.assign(capacity, {0, 0});
+            for (size_t id = 0; id < keys.size(); ++id)
+            {
+                size_t slot = hash(keys[id]);
+                while (slots_[slot].first != 0)
+                    slot = (slot + 1) & mask_;
+                slots_[slot] = {keys[id], static_cast<uint32_t>(id)};
+            }
+        }
+
+        // Ключ обязан быть в словаре (ключ 0 не бывает)
+        uint32_t find(uint64_t key) const
+        {
+            size_t slot = hash(key);
+            while (slots_[slot].first != key)
+                slot = (slot + 1) & mask_;
+            return slots_[slot].second;
+        }
+
+    private:
+        size_t hash(uint64_t key) const { return (key * 0x9E3779B97F4A7C15ull) >> 20 & mask_; }
+
+        std::vector<std::pair<uint64_t, uint32_t>> slots_;
+        size_t mask_;
+    };
+
+    bool isSeparator(wchar_t c)
+    {
+        return c < 0x20 || c == L' ' || c == 0xA0;
+    }
+
+    // Плотность a больше плотности b: count_a / len_a > count_b / len_b без деления
+    bool denser(uint32_t count_a, uint32_t len_a, uint32_t count_b, uint32_t len_b)
+    {
+        return static_cast<uint64_t>(count_a) * len_b > static_cast<uint64_t>(count_b) * len_a;
+    }
+
+    uint32_t packMeta(uint32_t length, uint32_t count)
+    {
+        return (std::min<uint32_t>(length, NgramIndex::LONG_TEXT_LENGTH) << 16) | std::min<uint32_t>(count, UINT16_MAX);
+    }
+
+    // Корзина длины текста: короче 16 символов - 0, дальше полуоктавы 16-23, 24-31, 32-47, 48-63...
+    // Внутри корзины длины различаются не больше чем в полтора раза
+    uint32_t lengthBucket(uint32_t length)
+    {
+        if (length < 16)
+            return 0;
+        int top = 31 - __builtin_clz(length);
+        return (top - 3) * 2 - 1 + ((length >> (top - 1)) & 1);
+    }
+}
+
+NgramIndex::NgramIndex(const TextProvider &provider, unsigned threads)
+{
+    std::string filename = getIndexFilename(provider.getFilename());
+    if (!load(filename, provider.getFileSize(), provider.getFileMtimeNs()))
+    {
+        build(provider, threads);
+        save(filename, provider.getFileSize(), provider.getFileMtimeNs());
+    }
+}
+
+std::string NgramIndex::getIndexFilename(const std::string &corpus_filename)
+{
+    return corpus_filename + ".ngram";
+}
+
+uint64_t NgramIndex::key(std::wstring_view gram)
+{
+    if (gram.empty() || gram.size() > static_cast<size_t>(MAX_N))
+        return 0;
+
+    // По 21 биту на символ; символ 0 не встречается, поэтому n-граммы разной длины не совпадают
+    uint64_t result = 0;
+    for (wchar_t c : gram)
+    {
+        if (isSeparator(c))
+            return 0;
+        result = (result << 21) | (simpleLower(static_cast<uint32_t>(c)) & 0x1FFFFF);
+    }
+    return result;
+}
+
+std::wstring NgramIndex::gram(uint64_t key)
+{
+    std::wstring chars;
+    for (; key != 0; key >>= 21)
+        chars.insert(chars.begin(), static_cast<wchar_t>(key & 0x1FFFFF));
+    return chars;
+}
+
+std::vector<uint64_t> NgramIndex::parseKeys(std::string_view list)
+{
+    std::vector<uint64_t> keys;
+    std::wstring token;
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        size_t end = list.find_first_of(", ", pos);
+        if (end == std::string_view::npos)
+            end = list.size();
+        decodeUtf8(list.substr(pos, end - pos), token);
+        if (uint64_t k = key(token))
+            keys.push_back(k);
+        pos = end + 1;
+    }
+    return keys;
+}
+
+bool NgramIndex::load(const std::string &filename, uint64_t file_size, int64_t mtime_ns)
+{
+    NgramIndexHeader header;
+    CacheFile::Stamp stamp{"NGRM", FORMAT_VERSION, file_size, mtime_ns};
+    auto expected = [](const NgramIndexHeader &h) -> uint64_t
+    {
+        if (h.max_n != static_cast<uint32_t>(MAX_N) || h.text_count == 0)
+            return 0;
+        return sizeof(h) + CacheFile::padded(h.key_count * sizeof(uint64_t)) +
+               CacheFile::padded((h.key_count + 1) * sizeof(uint64_t)) +
+               CacheFile::padded(h.text_count * sizeof(uint32_t)) +
+               2 * CacheFile::padded(h.posting_count * sizeof(uint32_t));
+    };
+    if (!cache_.map(filename, stamp, header, expected))
+        return false;
+
+    text_count_ = header.text_count;
+    key_count_ = header.key_count;
+    posting_count_ = header.posting_count;
+    keys_ = cache_.next<uint64_t>(key_count_);
+    offsets_ = cache_.next<uint64_t>(key_count_ + 1);
+    lengths_ = cache_.next<uint32_t>(text_count_);
+    posting_texts_ = cache_.next<uint32_t>(posting_count_);
+    posting_meta_ = cache_.next<uint32_t>(posting_count_);
+    return true;
+}
+
+void NgramIndex::build(const TextProvider &provider, unsigned threads)
+{
+    text_count_ = provider.size();
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, std::max<size_t>(1, text_count_ / 1024));
+
+    auto runParallel = [threads](auto &&job)
+    {
+        std::vector<std::thread> pool;
+        for (unsigned part = 1; part < threads; ++part)
+            pool.emplace_back(job, part);
+        job(0);
+        for (auto &thread : pool)
+            thread.join();
+    };
+    auto partFirst = [&](unsigned part) { return text_count_ * part / threads; };
+
+    // Различные n-граммы текста с количеством вхождений, по возрастанию ключа
+    auto collectGrams = [](std::string_view text, std::wstring &chars, std::vector<uint64_t> &grams,
+                           std::vector<std::pair<uint64_t, uint32_t>> &counted)
+    {
+        decodeUtf8(text, chars);
+        grams.clear();
+        for (size_t pos = 0; pos < chars.size(); ++pos)
+        {
+            uint64_t k = 0;
+            for (size_t n = 0; n < static_cast<size_t>(MAX_N) && pos + n < chars.size(); ++n)
+            {
+                wchar_t c = chars[pos + n];
+                if (isSeparator(c))
+                    break;
+                k = (k << 21) | (simpleLower(static_cast<uint32_t>(c)) & 0x1FFFFF);
+                grams.push_back(k);
+            }
+        }
+
+        std::sort(grams.begin(), grams.end());
+        counted.clear();
+        for (size_t i = 0; i < grams.size();)
+        {
+            size_t j = i;
+            while (j < grams.size() && grams[j] == grams[i])
+                ++j;
+            counted.push_back({grams[i], static_cast<uint32_t>(j - i)});
+            i = j;
+        }
+        return chars.size();
+    };
+
+    // Проход 1: каждый поток считает, в скольких его текстах встречается каждая n-грамма.
+    // Вхождения целиком в памяти не собираются - на корпусе в миллионы строк их сотни миллионов
+    built_lengths_.assign(text_count_, 0);
+    std::vector<std::unordered_map<uint64_t, uint64_t>> part_frequency(threads);
+    runParallel([&](unsigned part)
+                {
+                    std::wstring chars;
+                    std::vector<uint64_t> grams;
+                    std::vector<std::pair<uint64_t, uint32_t>> counted;
+                    auto &frequency = part_frequency[part];
+                    for (size_t text = partFirst(part); text < partFirst(part + 1); ++text)
+                    {
+                        built_lengths_[text] = static_cast<uint32_t>(
+                            collectGrams(provider.getText(text), chars, grams, counted));
+                        for (const auto &gram : counted)
+                            frequency[gram.first]++;
+                    }
+                });
+
+    // Общий словарь и смещения списков
+    for (const auto &frequency : part_frequency)
+    {
+        for (const auto &entry : frequency)
+            built_keys_.push_back(entry.first);
+    }
+    std::sort(built_keys_.begin(), built_keys_.end());
+    built_keys_.erase(std::unique(built_keys_.begin(), built_keys_.end()), built_keys_.end());
+    key_count_ = built_keys_.size();
+
+    KeyTable table(built_keys_);
+
+    // Смещения списков - префиксная сумма частот всех потоков
+    built_offsets_.assign(key_count_ + 1, 0);
+    for (const auto &frequency : part_frequency)
+    {
+        for (const auto &entry : frequency)
+            built_offsets_[table.find(entry.first) + 1] += entry.second;
+    }
+    for (size_t k = 0; k < key_count_; ++k)
+        built_offsets_[k + 1] += built_offsets_[k];
+    posting_count_ = built_offsets_.back();
+
+    // Курсоры записи прямо в частотах потоков: поток part пишет список n-граммы после всех потоков
+    // с меньшими текстами. Работа и память - по n-граммам, которые поток видел, а не потоки x словарь
+    std::vector<uint64_t> next(built_offsets_.begin(), built_offsets_.end() - 1);
+    for (auto &frequency : part_frequency)
+    {
+        for (auto &entry : frequency)
+        {
+            uint64_t &position = next[table.find(entry.first)];
+            uint64_t count = entry.second;
+            entry.second = position;
+            position += count;
+        }
+    }
+    std::vector<uint64_t>().swap(next);
+
+    // Проход 2: потоки раскладывают вхождения сразу по местам в итоговых массивах
+    built_texts_.resize(posting_count_);
+    built_meta_.resize(posting_count_);
+    runParallel([&](unsigned part)
+                {
+                    std::wstring chars;
+                    std::vector<uint64_t> grams;
+                    std::vector<std::pair<uint64_t, uint32_t>> counted;
+                    auto &cursor = part_frequency[part];
+                    for (size_t text = partFirst(part); text < partFirst(part + 1); ++text)
+                    {
+                        collectGrams(provider.getText(text), chars, grams, counted);
+                        for (const auto &gram : counted)
+                        {
+                            uint64_t slot = cursor.find(gram.first)->second++;
+                            built_texts_[slot] = static_cast<uint32_t>(text);
+                            built_meta_[slot] = packMeta(built_lengths_[text], gram.second);
+                        }
+                    }
+                });
+    part_frequency.clear();
+
+    // Каждый список - по корзинам длины, внутри корзины по убыванию плотности;
+    // списки делятся между потоками
+    runParallel([&](unsigned part)
+                {
+                    std::vector<std::pair<uint32_t, uint32_t>> list;
+                    for (size_t k = key_count_ * part / threads; k < key_count_ * (part + 1) / threads; ++k)
+                    {
+                        uint64_t first = built_offsets_[k];
+                        uint64_t last = built_offsets_[k + 1];
+                        list.clear();
+                        for (uint64_t p = first; p < last; ++p)
+                            list.push_back({built_texts_[p], built_meta_[p]});
+                        std::sort(list.begin(), list.end(), [this](const auto &a, const auto &b)
+                                  {
+                                      uint32_t len_a = built_lengths_[a.first], count_a = a.second & UINT16_MAX;
+                                      uint32_t len_b = built_lengths_[b.first], count_b = b.second & UINT16_MAX;
+                                      if (lengthBucket(len_a) != lengthBucket(len_b))
+                                          return lengthBucket(len_a) < lengthBucket(len_b);
+                                      if (denser(count_a, len_a, count_b, len_b))
+                                          return true;
+                                      if (denser(count_b, len_b, count_a, len_a))
+                                          return false;
+                                      return a.first < b.first;
+                                  });
+                        for (uint64_t p = first; p < last; ++p)
+                        {
+                            built_texts_[p] = list[p - first].first;
+                            built_meta_[p] = list[p - first].second;
+                        }
+                    }
+                });
+
+    keys_ = built_keys_.data();
+    offsets_ = built_offsets_.data();
+    lengths_ = built_lengths_.data();
+    posting_texts_ = built_texts_.data();
+    posting_meta_ = built_meta_.data();
+}
+
+void NgramIndex::save(const std::string &filename, uint64_t file_size, int64_t mtime_ns) const
+{
+    if (text_count_ == 0)
+        return;
+
+    NgramIndexHeader header{};
+    CacheFile::stamp(header, {"NGRM", FORMAT_VERSION, file_size, mtime_ns});
+    header.text_count = text_count_;
+    header.key_count = key_count_;
+    header.posting_count = posting_count_;
+    header.max_n = MAX_N;
+    CacheFile::write(filename, &header, sizeof(header),
+                     {{keys_, key_count_ * sizeof(uint64_t)},
+                      {offsets_, (key_count_ + 1) * sizeof(uint64_t)},
+                      {lengths_, text_count_ * sizeof(uint32_t)},
+                      {posting_texts_, posting_count_ * sizeof(uint32_t)},
+                      {posting_meta_, posting_count_ * sizeof(uint32_t)}});
+}
+
+std::pair<uint64_t, uint64_t> NgramIndex::postings(uint64_t key) const
+{
+    const uint64_t *it = std::lower_bound(keys_, keys_ + key_count_, key);
+    if (it == keys_ + key_count_ || *it != key)
+        return {0, 0};
+    size_t k = it - keys_;
+    return {offsets_[k], offsets_[k + 1]};
+}
+
+size_t NgramIndex::documentFrequency(uint64_t key) const
+{
+    auto [first, last] = postings(key);
+    return last - first;
+}
+
+void NgramIndex::find(const uint64_t *keys, size_t key_count, uint32_t min_length, uint32_t max_length,
+                      size_t limit, std::vector<Match> &out) const
+{
+    out.clear();
+
+    // Накопление оценок: номер текста -> позиция в out (открытая адресация, переиспользуется).
+    // Списки разбиты на корзины длины, поэтому запрос берет только корзины диапазона: каждая
+    // находится двоичным поиском, внутри нее записи идут по плотности, и дальше SCAN_LIMIT
+    // подходящих записей идут тексты, где n-граммы мало. В крайних корзинах часть текстов
+    // не подходит по длине; просмотр корзины в любом случае ограничен VISIT_LIMIT записями
+    uint32_t min_bucket = lengthBucket(min_length);
+    uint32_t max_bucket = lengthBucket(max_length);
+    auto bucketStart = [this](uint64_t first, uint64_t last, uint32_t bucket)
+    {
+        while (first < last)
+        {
+            uint64_t middle = first + (last - first) / 2;
+            if (lengthBucket(postingLength(middle)) < bucket)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return first;
+    };
+
+    thread_local std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    ranges.clear();
+    size_t accepted_limit = 0;
+    for (size_t q = 0; q < key_count; ++q)
+    {
+        auto [first, last] = postings(keys[q]);
+        first = bucketStart(first, last, min_bucket);
+        last = bucketStart(first, last, max_bucket + 1);
+        ranges.push_back({first, last});
+        accepted_limit += std::min<uint64_t>(last - first, size_t(SCAN_LIMIT) * (max_bucket - min_bucket + 1));
+    }
+
+    thread_local std::vector<uint64_t> slots;
+    size_t capacity = 64;
+    while (capacity < 2 * accepted_limit)
+        capacity <<= 1;
+    slots.assign(capacity, UINT64_MAX);
+
+    for (auto [first, last] : ranges)
+    {
+        for (uint64_t bucket_first = first; bucket_first < last;)
+        {
+            uint64_t bucket_last = bucketStart(bucket_first, last, lengthBucket(postingLength(bucket_first)) + 1);
+            uint64_t visit_last = std::min<uint64_t>(bucket_last, bucket_first + VISIT_LIMIT);
+            size_t accepted = 0;
+            for (uint64_t p = bucket_first; p < visit_last && accepted < SCAN_LIMIT; ++p)
+            {
+                uint32_t text = posting_texts_[p];
+                uint32_t length = postingLength(p);
+                if (length < min_length || length > max_length)
+                    continue;
+                ++accepted;
+
+                float density = static_cast<float>(posting_meta_[p] & UINT16_MAX) / length;
+                size_t slot = (text * 0x9E3779B1u) & (capacity - 1);
+                while (slots[slot] != UINT64_MAX && static_cast<uint32_t>(slots[slot] >> 32) != text)
+                    slot = (slot + 1) & (capacity - 1);
+
+                if (slots[slot] == UINT64_MAX)
+                {
+                    slots[slot] = (static_cast<uint64_t>(text) << 32) | out.size();
+                    out.push_back({text, density});
+                }
+                else
+                {
+                    out[static_cast<uint32_t>(slots[slot])].score += density;
+                }
+            }
+            bucket_first = bucket_last;
+        }
+    }
+
+    auto better = [](const Match &a, const Match &b)
+    { return a.score != b.score ? a.score > b.score : a.text < b.text; };
+    if (out.size() > limit)
+    {
+        std::partial_sort(out.begin(), out.begin() + limit, out.end(), better);
+        out.resize(limit);
+    }
+    else
+    {
+        std::sort(out.begin(), out.end(), better);
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "text_provider.h"
+#include "cache_file.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Заголовок кэша индекса (<файл>.ngram). За ним массивы: ключи, смещения списков,
+// длины текстов, номера текстов в списках и упакованные длина текста и количество вхождений
+struct NgramIndexHeader
+{
+    char magic[4]; // "NGRM"
+    uint32_t version;
+    uint64_t file_size;    // размер и время изменения корпуса,
+    int64_t file_mtime_ns; // для которого построен индекс
+    uint64_t text_count;
+    uint64_t key_count;
+    uint64_t posting_count;
+    uint32_t max_n;
+    uint32_t reserved;
+    uint8_t padding[8];
+};
+static_assert(sizeof(NgramIndexHeader) == 64, "NgramIndexHeader must stay 64 bytes");
+
+// Инвертированный индекс символьных n-грамм (n = 1..3, без учета регистра, без пробелов)
+// корпуса: для каждой n-граммы - тексты, где она встречается, и сколько раз.
+// Список каждой n-граммы разбит на корзины длины текста (полуоктавы), а внутри корзины упорядочен
+// по плотности (вхождений на символ) от большей к меньшей: запрос двоичным поиском находит корзины
+// диапазона длины и просматривает только их начало, поэтому не зависит от размера корпуса
+class NgramIndex
+{
+public:
+    static const uint32_t FORMAT_VERSION = 3;
+    static const int MAX_N = 3;
+    // Сколько подходящих по длине записей каждой корзины длины списка берет запрос
+    static const size_t SCAN_LIMIT = 512;
+    // Больше записей одной корзины запрос не просматривает, даже если подходящих меньше SCAN_LIMIT
+    static const size_t VISIT_LIMIT = 4 * SCAN_LIMIT;
+    // Длина текста в записи списка насыщается на этом значении: настоящая тогда в textLength
+    static constexpr uint32_t LONG_TEXT_LENGTH = UINT16_MAX;
+
+    struct Match
+    {
+        uint32_t text;
+        float score; // сумма плотностей n-грамм запроса в тексте
+    };
+
+    // Индекс берется из кэша рядом с корпусом или строится в threads потоков (0 - по числу ядер)
+    explicit NgramIndex(const TextProvider &provider, unsigned threads = 0);
+
+    NgramIndex(const NgramIndex &) = delete;
+    NgramIndex &operator=(const NgramIndex &) = delete;
+
+    // Ключ n-граммы из 1..MAX_N символов (регистр не учитывается); 0 - не n-грамма
+    static uint64_t key(std::wstring_view gram);
+    // Символы n-граммы по ключу (в нижнем регистре)
+    static std::wstring gram(uint64_t key);
+    // Разбор списка n-грамм через запятую или пробел ("щ,ъе th") в ключи
+    static std::vector<uint64_t> parseKeys(std::string_view list);
+
+    // Тексты длиной [min_length, max_length] символов, богатые n-граммами keys, лучшие первыми.
+    // out переиспользуется между запросами
+    void find(const uint64_t *keys, size_t key_count, uint32_t min_length, uint32_t max_length,
+              size_t limit, std::vector<Match> &out) const;
+
+    size_t textCount() const { return text_count_; }
+    size_t keyCount() const { return key_count_; }
+    size_t postingCount() const { return posting_count_; }
+    uint32_t textLength(size_t text) const { return lengths_[text]; }
+    // Сколько текстов содержат n-грамму
+    size_t documentFrequency(uint64_t key) const;
+    bool loadedFromCache() const { return cache_.mapped(); }
+
+    static std::string getIndexFilename(const std::string &corpus_filename);
+
+private:
+    bool load(const std::string &filename, uint64_t file_size, int64_t mtime_ns);
+    void build(const TextProvider &provider, unsigned threads);
+    void save(const std::string &filename, uint64_t file_size, int64_t mtime_ns) const;
+    // Диапазон списка n-граммы; пустой, если ее нет в корпусе
+    std::pair<uint64_t, uint64_t> postings(uint64_t key) const;
+    // Длина текста записи p списков
+    uint32_t postingLength(uint64_t p) const
+    {
+        uint32_t length = posting_meta_[p] >> 16;
+        return length == LONG_TEXT_LENGTH ? lengths_[posting_texts_[p]] : length;
+    }
+
+    const uint64_t *keys_ = nullptr;
+    const uint64_t *offsets_ = nullptr;
+    const uint32_t *lengths_ = nullptr;
+    const uint32_t *posting_texts_ = nullptr;
+    // Рядом с номером текста его длина (старшие 16 бит) и число вхождений (младшие 16 бит):
+    // фильтр по длине и оценка читают список подряд, без обращений к lengths_. Длина от 65535
+    // символов насыщается, и тогда настоящая берется из lengths_
+    const uint32_t *posting_meta_ = nullptr;
+    size_t text_count_ = 0;
+    size_t key_count_ = 0;
+    size_t posting_count_ = 0;
+
+    // Либо отображенный кэш, либо построенные в памяти массивы
+    CacheFile cache_;
+    std::vector<uint64_t> built_keys_;
+    std::vector<uint64_t> built_offsets_;
+    std::vector<uint32_t> built_lengths_;
+    std::vector<uint32_t> built_texts_;
+    std::vector<uint32_t> built_meta_;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "renderer.h"
+
+// Отрисовка в никуда: для замеров чистой стоимости логики набора
+class NullRenderer : public Renderer
+{
+public:
+    NullRenderer(int height = 40, int width = 120) : height_(height), width_(width) {}
+
+    void clearScreen() override {}
+    void displayText(std::string_view, bool = false) override {}
+    void displayTextCentered(std::string_view, int = 0) override {}
+    void displayText(const DecodedText &, size_t, size_t) override {}
+    void displayTextCentered(const DecodedText &, int = 0) override {}
+    void displayChar(wchar_t) override {}
+    void setColor(int) override {}
+    void resetColor() override {}
+    std::pair<int, int> getScreenSize() override { return {height_, width_}; }
+    void moveCursor(int, int) override {}
+    void clearLine(int) override {}
+    void beginFrame() override {}
+    void commitFrame() override {}
+
+private:
+    int height_;
+    int width_;
+};
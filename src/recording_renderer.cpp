@@ -0,0 +1,146 @@
+#include "recording_renderer.h"
+#include "line_buffer.h"
+
+RecordingRenderer::RecordingRenderer(int height, int width, size_t reserve) : height_(height), width_(width)
+{
+    output_.reserve(reserve);
+    wide_buffer_.reserve(1024);
+}
+
+
+void RecordingRenderer::flush()
+{
+    // Вне кадра каждый вызов - отдельный сброс, как в ConsoleHandler
+    if (frame_depth_ > 0)
+        return;
+    beginFrame();
+    commitFrame();
+}
+
+void RecordingRenderer::beginFrame()
+{
+    if (frame_depth_++ == 0)
+        frame_start_ = output_.size();
+}
+
+void RecordingRenderer::commitFrame()
+{
+    if (frame_depth_ == 0 || --frame_depth_ > 0)
+        return;
+
+    frames_++;
+    total_bytes_ += output_.size() - frame_start_;
+}
+
+void RecordingRenderer::appendMove(int y, int x)
+{
+    // CSI строка;столбец H, нумерация с единицы
+    LineBuffer<32> move;
+    move.append("\x1b[").appendInt(y + 1).append(";").appendInt(x + 1).append("H");
+    output_.append(move.view());
+}
+
+void RecordingRenderer::clearScreen()
+{
+    output_.append("\x1b[2J");
+    flush();
+}
+
+void RecordingRenderer::displayText(std::string_view text, bool /* highlight */)
+{
+    output_.append(text.data(), text.size());
+    flush();
+}
+
+void RecordingRenderer::displayTextCentered(std::string_view text, int y_offset)
+{
+    decodeUtf8(text, wide_buffer_);
+    int display_width = wcswidth(wide_buffer_.data(), wide_buffer_.size());
+    if (display_width < 0)
+        display_width = wide_buffer_.size();
+
+    moveCentered(display_width, y_offset);
+    output_.append(text.data(), text.size());
+    flush();
+}
+
+void RecordingRenderer::displayText(const DecodedText &text, size_t first, size_t last)
+{
+    if (first < last)
+    {
+        // Байтовые смещения посчитаны при разборе, перекодировать не нужно
+        output_.append(text.utf8, text.byte_offsets[first], text.byte_offsets[last] - text.byte_offsets[first]);
+    }
+    flush();
+}
+
+void RecordingRenderer::displayTextCentered(const DecodedText &text, int y_offset)
+{
+    moveCentered(text.width, y_offset);
+    output_.append(text.utf8);
+    flush();
+}
+
+void RecordingRenderer::displayChar(wchar_t c)
+{
+    encodeUtf8(std::wstring_view(&c, 1), output_);
+    flush();
+}
+
+void RecordingRenderer::setColor(int color)
+{
+    switch (color)
+    {
+    case COLOR_TYPED:
+        output_.append("\x1b[0;32m");
+        break;
+    case COLOR_CURRENT:
+        output_.append("\x1b[0;1;37m");
+        break;
+    case COLOR_ERROR:
+        output_.append("\x1b[0;1;31m");
+        break;
+    case COLOR_UNTYPED:
+        output_.append("\x1b[0;90m");
+        break;
+    default:
+        output_.append("\x1b[0;37m");
+    }
+    flush();
+}
+
+void RecordingRenderer::resetColor()
+{
+    output_.append("\x1b[0m");
+    flush();
+}
+
+void RecordingRenderer::moveCursor(int y, int x)
+{
+    appendMove(y, x);
+    flush();
+}
+
+void RecordingRenderer::clearLine(int y)
+{
+    appendMove(y, 0);
+    output_.append("\x1b[K");
+    flush();
+}
+
+void RecordingRenderer::moveCentered(int display_width, int y_offset)
+{
+    int x = (width_ - display_width) / 2;
+    if (x < 0)
+        x = 0;
+
+    int y = (height_ / 2) + y_offset;
+    if (y < 0)
+        y = 0;
+    if (y >= height_)
+        y = height_ - 1;
+
+    appendMove(y, 0);
+    output_.append("\x1b[K");
+    appendMove(y, x);
+}
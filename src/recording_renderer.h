@@ -0,0 +1,59 @@
+#pragma once
+#include "renderer.h"
+#include <cstdint>
+#include <string>
+
+// Отрисовка в буфер ANSI-последовательностей без терминала: для замеров и для клиентов
+// сервера. Вывод не оптимизируется так, как это делает ncurses, поэтому байты на кадр - оценка сверху
+class RecordingRenderer : public Renderer
+{
+public:
+    // reserve - сколько байт вывода зарезервировать заранее
+    RecordingRenderer(int height = 40, int width = 120, size_t reserve = 64 * 1024);
+
+    void clearScreen() override;
+    void displayText(std::string_view text, bool highlight = false) override;
+    void displayTextCentered(std::string_view text, int y_offset = 0) override;
+    void displayText(const DecodedText &text, size_t first, size_t last) override;
+    void displayTextCentered(const DecodedText &text, int y_offset = 0) override;
+    void displayChar(wchar_t c) override;
+    void setColor(int color) override;
+    void resetColor() override;
+    std::pair<int, int> getScreenSize() override { return {height_, width_}; }
+    // Терминал клиента изменил размер
+    void resize(int height, int width)
+    {
+        height_ = height;
+        width_ = width;
+    }
+    void moveCursor(int y, int x) override;
+    void clearLine(int y) override;
+    void beginFrame() override;
+    void commitFrame() override;
+
+    // Весь вывод с последнего clearOutput(); вызывать вне кадра
+    std::string_view output() const { return output_; }
+    void clearOutput() { output_.clear(); }
+    // Убирает уже отправленное начало вывода
+    void consumeOutput(size_t bytes) { output_.erase(0, bytes); }
+
+    uint64_t getFrameCount() const { return frames_; }
+    uint64_t getTotalBytes() const { return total_bytes_; }
+
+private:
+    void appendMove(int y, int x);
+    void moveCentered(int display_width, int y_offset);
+    void flush();
+
+    int height_;
+    int width_;
+    int frame_depth_ = 0;
+
+    // Буферы заранее зарезервированы: запись кадра не выделяет память
+    std::string output_;
+    size_t frame_start_ = 0;
+    std::wstring wide_buffer_;
+
+    uint64_t frames_ = 0;
+    uint64_t total_bytes_ = 0;
+};
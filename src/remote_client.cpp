@@ -0,0 +1,137 @@
+#include "remote_client.h"
+#include "byte_utils.h"
+#include "server_protocol.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // Альтернативный экран и скрытый курсор, как у ncurses
+    const char ENTER_SCREEN[] = "\x1b[?1049h\x1b[?25l";
+    const char LEAVE_SCREEN[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+    // Размер терминала изменился (SIGWINCH); обрабатывается в цикле пересылки
+    volatile sig_atomic_t g_resized = 0;
+
+    void onResize(int)
+    {
+        g_resized = 1;
+    }
+}
+
+RemoteClient::RemoteClient(const std::string &socket_path)
+{
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        throw std::runtime_error("Не удалось подключиться к серверу " + socket_path + ": " + std::strerror(errno));
+    }
+}
+
+RemoteClient::~RemoteClient()
+{
+    restoreTerminal();
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void RemoteClient::enterRawMode()
+{
+    if (tcgetattr(STDIN_FILENO, &saved_termios_) != 0)
+        return;
+
+    termios raw = saved_termios_;
+    cfmakeraw(&raw);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+    raw_ = true;
+    writeAll(STDOUT_FILENO, ENTER_SCREEN, sizeof(ENTER_SCREEN) - 1);
+}
+
+void RemoteClient::restoreTerminal()
+{
+    if (!raw_)
+        return;
+    writeAll(STDOUT_FILENO, LEAVE_SCREEN, sizeof(LEAVE_SCREEN) - 1);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios_);
+    raw_ = false;
+}
+
+void RemoteClient::run(const std::string &language)
+{
+    ServerHello hello{};
+    std::memcpy(hello.magic, "TSRV", 4);
+    hello.version = SERVER_PROTOCOL_VERSION;
+    std::strncpy(hello.language, language.c_str(), sizeof(hello.language) - 1);
+
+    winsize size{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0)
+    {
+        hello.rows = size.ws_row;
+        hello.cols = size.ws_col;
+    }
+
+    if (!writeAll(fd_, reinterpret_cast<const char *>(&hello), sizeof(hello)))
+    {
+        throw std::runtime_error("Сервер закрыл соединение");
+    }
+
+    enterRawMode();
+
+    // Без SA_RESTART: сигнал прерывает poll, и новый размер уходит серверу сразу
+    struct sigaction action{};
+    action.sa_handler = onResize;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, nullptr);
+
+    // Пересылка в обе стороны, пока сервер не закроет соединение
+    pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {fd_, POLLIN, 0}};
+    char buffer[4096];
+    while (true)
+    {
+        if (g_resized)
+        {
+            // Новый размер идет в потоке ввода как ответ терминала на запрос размера: ESC [ 8 ; строки ; столбцы t
+            g_resized = 0;
+            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0)
+            {
+                int n = std::snprintf(buffer, sizeof(buffer), "\x1b[8;%d;%dt", size.ws_row, size.ws_col);
+                if (!writeAll(fd_, buffer, n))
+                    break;
+            }
+        }
+
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (fds[1].revents)
+        {
+            ssize_t n = read(fd_, buffer, sizeof(buffer));
+            if (n <= 0 || !writeAll(STDOUT_FILENO, buffer, n))
+                break;
+        }
+        if (fds[0].revents)
+        {
+            ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n <= 0 || !writeAll(fd_, buffer, n))
+                break;
+        }
+    }
+
+    restoreTerminal();
+}
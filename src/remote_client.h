@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <termios.h>
+
+// Тонкий клиент сервера (--connect): переводит терминал в raw-режим, пересылает ввод
+// в сокет, а вывод сервера - на экран. Сам клиент не загружает ни тексты, ни статистику
+class RemoteClient
+{
+public:
+    explicit RemoteClient(const std::string &socket_path);
+    ~RemoteClient();
+
+    RemoteClient(const RemoteClient &) = delete;
+    RemoteClient &operator=(const RemoteClient &) = delete;
+
+    // Сессия до отключения сервера
+    void run(const std::string &language);
+
+private:
+    void enterRawMode();
+    void restoreTerminal();
+
+    int fd_ = -1;
+    termios saved_termios_{};
+    bool raw_ = false;
+};
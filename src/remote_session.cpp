@@ -0,0 +1,302 @@
+#include "remote_session.h"
+#include "typing_session.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // Начальный запас буфера вывода: экран старта или результатов целиком
+    const size_t OUTPUT_RESERVE = 4096;
+
+    const wchar_t REPLACEMENT_CHAR = 0xFFFD;
+
+    // Сколько ждать продолжения после ESC (как set_escdelay в ConsoleHandler)
+    const std::chrono::milliseconds ESCAPE_DELAY(25);
+
+    // Последний байт последовательностей, которые шлют клавиши терминала (стрелки, Home/End,
+    // F1-F4, ~ у остальных функциональных) и ответ о размере (t). ESC, за которым набраны
+    // [ или O и другой символ, не последовательность
+    bool isSequenceFinal(char intro, unsigned char c)
+    {
+        const char *finals = intro == 'O' ? "ABCDFHPQRS" : "ABCDFHPQRSZ~tu";
+        return c != 0 && std::strchr(finals, c) != nullptr;
+    }
+
+    // Длина символа UTF-8 по первому байту (1 для некорректного)
+    size_t utf8Length(unsigned char lead)
+    {
+        if ((lead & 0xE0) == 0xC0)
+            return 2;
+        if ((lead & 0xF0) == 0xE0)
+            return 3;
+        if ((lead & 0xF8) == 0xF0)
+            return 4;
+        return 1;
+    }
+
+    wint_t decodeChar(const char *bytes, size_t length)
+    {
+        unsigned char lead = bytes[0];
+        if (length == 1)
+            return lead < 0x80 ? lead : REPLACEMENT_CHAR;
+
+        uint32_t cp = lead & (0x7F >> length);
+        for (size_t i = 1; i < length; ++i)
+        {
+            unsigned char c = bytes[i];
+            if ((c & 0xC0) != 0x80)
+                return REPLACEMENT_CHAR;
+            cp = (cp << 6) | (c & 0x3F);
+        }
+        return cp;
+    }
+}
+
+RemoteSession::RemoteSession(TextProvider &provider, const KeyboardLayout *layout, StatsHistory *history,
+                             int rows, int cols, LatencyProfile *latency)
+    : provider_(provider), layout_(layout), history_(history),
+      renderer_(rows, cols, OUTPUT_RESERVE),
+      log_(history ? std::make_unique<KeystrokeLog>(history->key()) : nullptr),
+      engine_(renderer_, log_.get(), latency) {}
+
+void RemoteSession::start()
+{
+    showStart();
+}
+
+bool RemoteSession::onInput(const char *data, size_t size, Clock::time_point now)
+{
+    size_t i = 0;
+
+    // Дочитываем символ, разрезанный предыдущим чтением
+    while (partial_size_ > 0 && i < size)
+    {
+        partial_[partial_size_++] = data[i++];
+        size_t length = utf8Length(partial_[0]);
+        if (partial_size_ == length)
+        {
+            partial_size_ = 0;
+            if (!handleKey(decodeChar(partial_, length), now))
+                return false;
+        }
+    }
+
+    while (i < size)
+    {
+        unsigned char c = data[i];
+        wint_t key;
+
+        if (escape_size_ > 0)
+        {
+            // Продолжение начатой последовательности, в том числе из прошлого чтения.
+            // Параметры CSI (0x20-0x3F) копятся, пока есть место под последний байт
+            bool csi = escape_size_ > 1 && escape_[1] == '[';
+            if ((escape_size_ == 1 && (c == '[' || c == 'O')) ||
+                (csi && c >= 0x20 && c <= 0x3F && escape_size_ + 1 < sizeof(escape_)))
+            {
+                escape_[escape_size_++] = c;
+                ++i;
+                continue;
+            }
+            if (escape_size_ > 1 && isSequenceFinal(escape_[1], c))
+            {
+                escape_[escape_size_++] = c;
+                ++i;
+                std::string_view sequence(escape_, escape_size_);
+                escape_size_ = 0;
+                if (!handleSequence(sequence, now))
+                    return false;
+                continue;
+            }
+            // Байт c разбирается заново уже как обычный ввод
+            if (!flushEscape(now))
+                return false;
+            continue;
+        }
+
+        if (c == 27)
+        {
+            escape_[0] = c;
+            escape_size_ = 1;
+            escape_deadline_ = now + ESCAPE_DELAY;
+            ++i;
+            continue;
+        }
+        else if (c == '\r')
+        {
+            // В raw-режиме Enter приходит как CR
+            key = '\n';
+            ++i;
+        }
+        else
+        {
+            size_t length = utf8Length(c);
+            if (i + length > size)
+            {
+                partial_size_ = size - i;
+                std::copy(data + i, data + size, partial_);
+                return true;
+            }
+            key = decodeChar(data + i, length);
+            i += length;
+        }
+
+        if (!handleKey(key, now))
+            return false;
+    }
+    return true;
+}
+
+bool RemoteSession::onTimeout(Clock::time_point now)
+{
+    // Продолжение ESC не пришло за отведенное время - это клавиша ESC
+    if (escape_size_ > 0 && now >= escape_deadline_ && !flushEscape(now))
+        return false;
+
+    Clock::time_point deadline;
+    if (state_ == State::Typing && engine_.nextDeadline(deadline) && deadline <= now)
+    {
+        engine_.handleTimeout(now);
+    }
+    return true;
+}
+
+bool RemoteSession::nextDeadline(Clock::time_point &deadline) const
+{
+    bool found = state_ == State::Typing && engine_.nextDeadline(deadline);
+    if (escape_size_ > 0 && (!found || escape_deadline_ < deadline))
+    {
+        deadline = escape_deadline_;
+        found = true;
+    }
+    return found;
+}
+
+bool RemoteSession::handleSequence(std::string_view sequence, Clock::time_point now)
+{
+    // Из клавиш нужна только F2 (ESC O Q или ESC [ 1 2 ~) и размер терминала от клиента
+    // (ESC [ 8 ; строки ; столбцы t); остальные клавиши пропускаются
+    int rows = 0;
+    int cols = 0;
+    if (sequence == "\x1bOQ" || sequence == "\x1b[12~")
+        return handleKey(InputSource::KEY_DEBUG_OVERLAY, now);
+
+    if (sequence.size() > 4 && sequence.substr(0, 4) == "\x1b[8;" && sequence.back() == 't' &&
+        std::sscanf(std::string(sequence.substr(4)).c_str(), "%d;%d", &rows, &cols) == 2 && rows > 0 && cols > 0)
+    {
+        renderer_.resize(rows, cols);
+        return handleKey(InputSource::KEY_SCREEN_RESIZE, now);
+    }
+    return true;
+}
+
+bool RemoteSession::flushEscape(Clock::time_point now)
+{
+    size_t size = escape_size_;
+    escape_size_ = 0;
+    for (size_t k = 0; k < size; ++k)
+    {
+        if (!handleKey(static_cast<unsigned char>(escape_[k]), now))
+            return false;
+    }
+    return true;
+}
+
+bool RemoteSession::handleKey(wint_t key, Clock::time_point now)
+{
+    bool exit_key = key == 27 || key == 'q' || key == 'Q';
+
+    switch (state_)
+    {
+    case State::Start:
+        if (exit_key)
+            break;
+        if (key == InputSource::KEY_DEBUG_OVERLAY)
+            return true;
+        if (key == InputSource::KEY_SCREEN_RESIZE)
+        {
+            drawStart();
+            return true;
+        }
+
+        state_ = State::Typing;
+        engine_.begin(text_, layout_ ? *layout_ : KeyboardLayout::forText(text_.chars), key, now);
+        if (engine_.finished())
+            showResults();
+        return true;
+
+    case State::Typing:
+        if (!engine_.handleInput(key, now))
+            break;
+        if (engine_.finished())
+            showResults();
+        return true;
+
+    case State::Results:
+        // Как в TypingSession: ENTER и Q - следующий текст, ESC - выход
+        if (key == 27)
+            break;
+        if (key == '\n' || key == 'q' || key == 'Q')
+            showStart();
+        if (key == InputSource::KEY_SCREEN_RESIZE || chart_view_.handleKey(key))
+            drawResults();
+        return true;
+
+    case State::Closed:
+        break;
+    }
+
+    state_ = State::Closed;
+    return false;
+}
+
+void RemoteSession::showStart()
+{
+    provider_.getRandomText(text_);
+    drawStart();
+}
+
+void RemoteSession::drawStart()
+{
+    renderer_.beginFrame();
+    renderer_.clearScreen();
+    if (text_.empty())
+    {
+        renderer_.displayTextCentered("Ошибка преобразования текста", 0);
+        state_ = State::Closed;
+    }
+    else
+    {
+        renderer_.displayTextCentered("=== Typing Trainer ===", -5);
+        renderer_.displayTextCentered(text_, 0);
+        renderer_.displayTextCentered("Нажмите любую клавишу для начала или ESC для выхода...", 5);
+        state_ = State::Start;
+    }
+    renderer_.commitFrame();
+}
+
+void RemoteSession::showResults()
+{
+    if (history_)
+    {
+        TypingSession::saveResults(*history_, text_.utf8, engine_.errors(), static_cast<int>(text_.length()),
+                                   resultDuration(), log_ ? log_->sessionId() : 0);
+    }
+    chart_view_ = HistoryChart::View();
+    drawResults();
+    state_ = State::Results;
+}
+
+void RemoteSession::drawResults()
+{
+    renderer_.beginFrame();
+    TypingSession::displayResults(renderer_, history_, engine_.errors(), static_cast<int>(text_.length()),
+                                  resultDuration(), &chart_view_);
+    renderer_.commitFrame();
+}
+
+std::chrono::duration<double> RemoteSession::resultDuration() const
+{
+    return engine_.endTime() - engine_.startTime();
+}
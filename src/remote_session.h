@@ -0,0 +1,79 @@
+#pragma once
+#include "recording_renderer.h"
+#include "typing_engine.h"
+#include "text_provider.h"
+#include "keyboard_layout.h"
+#include "keystroke_log.h"
+#include "latency_profile.h"
+#include "stats_history.h"
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Сессия одного клиента сервера. Тот же сценарий, что у TypingSession (экран старта, раунд,
+// результаты), но управляется событиями внешнего цикла и рисует в свой буфер ANSI.
+// Корпус текстов и раскладка общие для всех клиентов и только читаются
+class RemoteSession
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // history - история пользователя, куда сохранять результаты (nullptr - не сохранять);
+    // layout - nullptr, если раскладку выбирать по тексту; latency - общий профиль задержек или nullptr
+    RemoteSession(TextProvider &provider, const KeyboardLayout *layout, StatsHistory *history,
+                  int rows, int cols, LatencyProfile *latency);
+
+    // Первый экран
+    void start();
+    // Байты ввода терминала; false - клиент вышел, соединение можно закрывать
+    bool onInput(const char *data, size_t size, Clock::time_point now);
+    // Срок ожидания пришел; false - клиент вышел (отложенный ESC)
+    bool onTimeout(Clock::time_point now);
+    bool nextDeadline(Clock::time_point &deadline) const;
+
+    // Вывод, который еще не отправлен клиенту
+    std::string_view output() const { return renderer_.output(); }
+    void consumeOutput(size_t bytes) { renderer_.consumeOutput(bytes); }
+
+private:
+    enum class State
+    {
+        Start,   // экран с текстом, ждем первое нажатие
+        Typing,  // идет раунд
+        Results, // результаты, ждем ENTER или ESC/Q
+        Closed
+    };
+
+    bool handleKey(wint_t key, Clock::time_point now);
+    // Законченная escape-последовательность клавиши
+    bool handleSequence(std::string_view sequence, Clock::time_point now);
+    // Начатое ESC оказалось не последовательностью: ESC и следующие байты как обычные клавиши
+    bool flushEscape(Clock::time_point now);
+    // Новый текст и экран старта; экран результатов после сохранения результата
+    void showStart();
+    void showResults();
+    // Перерисовка тех же экранов, в том числе при смене размера терминала клиента
+    void drawStart();
+    void drawResults();
+    std::chrono::duration<double> resultDuration() const;
+
+    TextProvider &provider_;
+    const KeyboardLayout *layout_;
+    StatsHistory *history_;
+    RecordingRenderer renderer_;
+    std::unique_ptr<KeystrokeLog> log_;
+    TypingEngine engine_;
+    DecodedText text_;
+    State state_ = State::Start;
+    HistoryChart::View chart_view_;
+
+    // Незаконченный на границе чтения символ UTF-8
+    char partial_[4];
+    size_t partial_size_ = 0;
+
+    // Начатая escape-последовательность: продолжение может прийти следующим чтением,
+    // а одиночный ESC становится клавишей по сроку, как escdelay у ncurses
+    char escape_[32];
+    size_t escape_size_ = 0;
+    Clock::time_point escape_deadline_;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <cwchar>
+#include <string_view>
+#include <utility>
+#include "decoded_text.h"
+
+// Приемник отрисовки. ConsoleHandler выводит в терминал через ncurses,
+// а для замеров без терминала есть NullRenderer и RecordingRenderer
+class Renderer
+{
+public:
+    // Определения типов текста
+    static const int COLOR_TYPED = 1;   // Набранный текст
+    static const int COLOR_CURRENT = 2; // Текущий символ
+    static const int COLOR_ERROR = 3;   // Ошибки
+    static const int COLOR_UNTYPED = 4; // Ненабранный текст
+
+    virtual ~Renderer() = default;
+
+    virtual void clearScreen() = 0;
+    virtual void displayText(std::string_view text, bool highlight = false) = 0;
+    virtual void displayTextCentered(std::string_view text, int y_offset = 0) = 0;
+    // Вывод заранее разобранного текста: символы [first, last) с текущей позиции курсора
+    virtual void displayText(const DecodedText &text, size_t first, size_t last) = 0;
+    virtual void displayTextCentered(const DecodedText &text, int y_offset = 0) = 0;
+    virtual void displayChar(wchar_t c) = 0;
+    virtual void setColor(int color) = 0;
+    virtual void resetColor() = 0;
+    virtual std::pair<int, int> getScreenSize() = 0;
+    virtual void moveCursor(int y, int x) = 0;
+    virtual void clearLine(int y) = 0;
+
+    // Кадр: весь вывод между beginFrame() и commitFrame() уходит одним сбросом
+    virtual void beginFrame() = 0;
+    virtual void commitFrame() = 0;
+};
+
+// Источник нажатий: терминал или записанный/сгенерированный поток
+class InputSource
+{
+public:
+    // Служебные клавиши приходят кодами вне Unicode, чтобы не совпасть с символом текста
+    static const wint_t KEY_DEBUG_OVERLAY = 0x110000; // F2 - оверлей задержек
+    static const wint_t KEY_SCREEN_RESIZE = 0x110001; // размер экрана изменился (getScreenSize уже новый)
+
+    virtual ~InputSource() = default;
+
+    // Ожидание ввода не дольше timeout_ms (-1 - без ограничения); false, если ввода не было
+    virtual bool waitChar(wint_t &ch, int timeout_ms) = 0;
+};
@@ -0,0 +1,46 @@
+#include "screen_layout.h"
+#include <algorithm>
+
+void ScreenLayout::setContent(int text_width, int text_height, int keyboard_width, int keyboard_height)
+{
+    text_width_ = text_width;
+    text_height_ = text_height;
+    keyboard_width_ = keyboard_width;
+    keyboard_height_ = keyboard_height;
+}
+
+unsigned ScreenLayout::update(int height, int width)
+{
+    height_ = height;
+    width_ = width;
+
+    LayoutRect keyboard;
+    keyboard.top = std::max(0, height - KEYBOARD_BOTTOM_OFFSET);
+    keyboard.left = std::max(0, (width - keyboard_width_) / 2);
+    keyboard.height = keyboard_height_;
+    keyboard.width = keyboard_width_;
+
+    // Середина текста по центру экрана; на низком экране текст поднимается над клавиатурой
+    LayoutRect text;
+    text.top = std::max(0, std::min(height / 2 - text_height_ / 2, keyboard.top - text_height_));
+    text.left = std::max(0, (width - text_width_) / 2);
+    text.height = text_height_;
+    text.width = text_width_;
+
+    LayoutRect stats;
+    stats.top = std::max(0, height - 1);
+    stats.height = 1;
+    stats.width = width;
+
+    unsigned changed = 0;
+    if (text != text_)
+        changed |= REGION_TEXT;
+    if (stats != stats_)
+        changed |= REGION_STATS;
+    if (keyboard != keyboard_)
+        changed |= REGION_KEYBOARD;
+    text_ = text;
+    stats_ = stats;
+    keyboard_ = keyboard;
+    return changed;
+}
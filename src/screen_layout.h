@@ -0,0 +1,62 @@
+#pragma once
+
+// Прямоугольник на экране в строках и колонках
+struct LayoutRect
+{
+    int top = 0;
+    int left = 0;
+    int height = 0;
+    int width = 0;
+
+    bool operator==(const LayoutRect &other) const
+    {
+        return top == other.top && left == other.left && height == other.height && width == other.width;
+    }
+    bool operator!=(const LayoutRect &other) const { return !(*this == other); }
+};
+
+inline bool intersects(const LayoutRect &a, const LayoutRect &b)
+{
+    return a.top < b.top + b.height && b.top < a.top + a.height &&
+           a.left < b.left + b.width && b.left < a.left + a.width;
+}
+
+// Положение виджетов экрана набора: текст по центру (но не ниже клавиатуры), строка статистики
+// внизу, клавиатура над ней. Позиции считаются один раз на размер экрана и содержимое раунда,
+// а update() сообщает, какие области сдвинулись, чтобы перерисовать только их
+class ScreenLayout
+{
+public:
+    enum Region : unsigned
+    {
+        REGION_TEXT = 1,
+        REGION_STATS = 2,
+        REGION_KEYBOARD = 4
+    };
+
+    // Отступ верхней строки клавиатуры от низа экрана
+    static const int KEYBOARD_BOTTOM_OFFSET = 10;
+
+    // Содержимое раунда: размер текста (колонки и строки) и размер рамки клавиатуры
+    void setContent(int text_width, int text_height, int keyboard_width, int keyboard_height);
+    // Пересчет под размер экрана; маска областей, у которых изменились положение или размер
+    unsigned update(int height, int width);
+
+    const LayoutRect &text() const { return text_; }
+    const LayoutRect &stats() const { return stats_; }
+    const LayoutRect &keyboard() const { return keyboard_; }
+    int height() const { return height_; }
+    int width() const { return width_; }
+
+private:
+    int text_width_ = 0;
+    int text_height_ = 1;
+    int keyboard_width_ = 0;
+    int keyboard_height_ = 0;
+    int height_ = 0;
+    int width_ = 0;
+
+    LayoutRect text_;
+    LayoutRect stats_;
+    LayoutRect keyboard_;
+};
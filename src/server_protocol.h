@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Протокол сервера (--serve) и тонкого клиента (--connect) поверх Unix-сокета.
+// Клиент отправляет ServerHello, дальше в сокет идут байты ввода терминала как есть,
+// а обратно - готовые ANSI-последовательности для вывода
+struct ServerHello
+{
+    char magic[4];    // "TSRV"
+    uint16_t version;
+    uint16_t flags;   // SERVER_HELLO_*
+    uint16_t rows;    // размер терминала клиента
+    uint16_t cols;
+    char language[20]; // язык текстов (имя файла в data/ без .txt), с нулем в конце
+};
+static_assert(sizeof(ServerHello) == 32, "ServerHello must stay 32 bytes");
+
+const uint16_t SERVER_PROTOCOL_VERSION = 1;
+
+// Не сохранять результаты и нажатия (нагрузочные клиенты)
+const uint16_t SERVER_HELLO_NO_STATS = 1;
+
+const char *const DEFAULT_SERVER_SOCKET = "/tmp/typing.sock";
@@ -0,0 +1,83 @@
+#include "startup_profile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <unistd.h>
+
+namespace
+{
+    // Время с запуска процесса по /proc/self/stat (starttime в тиках с загрузки системы),
+    // точность - один тик (обычно 10 мс); -1, если прочитать не удалось
+    double processAgeMs()
+    {
+        FILE *file = std::fopen("/proc/self/stat", "r");
+        if (!file)
+            return -1.0;
+        char buffer[1024];
+        size_t n = std::fread(buffer, 1, sizeof(buffer) - 1, file);
+        std::fclose(file);
+        buffer[n] = '\0';
+
+        // Имя процесса в скобках может содержать пробелы, поля считаются после него
+        const char *p = std::strrchr(buffer, ')');
+        if (!p)
+            return -1.0;
+        unsigned long long starttime = 0;
+        int field = 2;
+        for (; *p && field < 22; ++p)
+        {
+            if (*p == ' ')
+                ++field;
+        }
+        if (field != 22 || std::sscanf(p, "%llu", &starttime) != 1)
+            return -1.0;
+
+        timespec now;
+        long ticks = sysconf(_SC_CLK_TCK);
+        if (ticks <= 0 || clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+            return -1.0;
+        double age = (now.tv_sec + now.tv_nsec / 1e9) * 1000.0 - starttime * 1000.0 / ticks;
+        return std::max(age, 0.0);
+    }
+}
+
+StartupProfile &StartupProfile::shared()
+{
+    static StartupProfile profile;
+    return profile;
+}
+
+StartupProfile::StartupProfile()
+    : start_(Clock::now()), last_(start_), before_main_ms_(processAgeMs())
+{
+    phases_.reserve(16);
+}
+
+void StartupProfile::mark(const char *phase, bool input)
+{
+    for (const Phase &recorded : phases_)
+    {
+        if (recorded.name == phase)
+            return;
+    }
+    Clock::time_point now = Clock::now();
+    phases_.push_back({phase, std::chrono::duration<double, std::milli>(now - last_).count(), input});
+    last_ = now;
+}
+
+void StartupProfile::print(std::ostream &out) const
+{
+    out << std::fixed << std::setprecision(2);
+    if (before_main_ms_ >= 0.0)
+        out << "  до main (загрузка, связывание)\t" << before_main_ms_ << " мс (±10)" << std::endl;
+    double total = 0.0;
+    for (const Phase &phase : phases_)
+    {
+        out << "  " << phase.name << '\t' << phase.ms << " мс" << std::endl;
+        if (!phase.input)
+            total += phase.ms;
+    }
+    out << "Всего от main без ожидания ввода: " << total << " мс" << std::endl;
+}
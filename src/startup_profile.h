@@ -0,0 +1,34 @@
+#pragma once
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+// Время этапов запуска до первого кадра (--startup-profile): локаль, ncurses, список языков,
+// тексты, индексы. Этап длится от предыдущей отметки; отметки дешевые и ставятся всегда
+class StartupProfile
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static StartupProfile &shared();
+
+    // Конец этапа phase (строковый литерал); повторные отметки того же этапа пропускаются.
+    // input - этап ожидания пользователя, в сумму не входит
+    void mark(const char *phase, bool input = false);
+    void print(std::ostream &out) const;
+
+private:
+    StartupProfile();
+
+    struct Phase
+    {
+        const char *name;
+        double ms;
+        bool input;
+    };
+
+    Clock::time_point start_;
+    Clock::time_point last_;
+    double before_main_ms_ = -1.0; // от запуска процесса до первой отметки, если известно
+    std::vector<Phase> phases_;
+};
@@ -1,134 +1,173 @@
 #include "stats_analyzer.h"
-#include <fstream>
+#include "history_chart.h"
 #include <sstream>
 #include <algorithm>
 #include <iomanip>
+#include <cwchar>
+#include <tuple>
 
-StatsAnalyzer::StatsAnalyzer(ConsoleHandler& console) : console_(console) {}
+namespace {
+    // Высота графика: заголовок, подпись и 8 строк столбцов
+    const int CHART_ROWS = 8;
+    const int CHART_BLOCK_ROWS = CHART_ROWS + 2;
+    // Строк в блоке статистики (displayFullStats)
+    const int FULL_STATS_ROWS = 16;
+}
+
+StatsAnalyzer::StatsAnalyzer(Renderer& console) : console_(console) {}
 
-void StatsAnalyzer::displayStats(const std::string& language,
+void StatsAnalyzer::displayStats(const StatsHistory& history,
                                double current_cpm,
                                double current_accuracy,
                                int current_errors,
                                int current_chars,
-                               std::chrono::seconds current_duration) {
-    auto stats = loadStats(language);
+                               std::chrono::duration<double> current_duration,
+                               HistoryChart::View* view) {
+    auto [height, width] = console_.getScreenSize();
+    (void)width;
+    
+    // Экран собирается сверху вниз и центрируется по высоте; график только если помещается
+    int rows_without_chart = 1 + 1 + FULL_STATS_ROWS + 1 + 1;
+    bool with_chart = height >= rows_without_chart + CHART_BLOCK_ROWS + 1;
+    int total_rows = rows_without_chart + (with_chart ? CHART_BLOCK_ROWS + 1 : 0);
+    int row = std::max(0, (height - total_rows) / 2);
     
     console_.clearScreen();
-    console_.displayTextCentered("=== Результаты ===", -12);
+    displayLine(row, "=== Результаты ===");
+    row += 2;
     
-    // Отображаем столбчатую диаграмму скорости с большим отступом
-    displaySpeedBarChart(stats, current_cpm, -4);
+    if (with_chart) {
+        displaySpeedBarChart(history, row, view);
+        row += CHART_BLOCK_ROWS + 1;
+    }
     
-    // Отображаем полную статистику внизу
-    displayFullStats(stats, current_cpm, current_accuracy, current_errors, 
+    displayFullStats(row, history.summary(), history.totals(), current_cpm, current_accuracy, current_errors,
                     current_chars, current_duration);
-}
-
-std::vector<SessionStats> StatsAnalyzer::loadStats(const std::string& language) {
-    std::vector<SessionStats> stats;
-    std::string filename = "stats/" + language + "_results.csv";
-    std::ifstream file(filename);
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        SessionStats stat;
-        
-        std::string field;
-        std::getline(ss, stat.timestamp, ',');
-        std::getline(ss, field, ','); stat.cpm = std::stod(field);
-        std::getline(ss, field, ','); stat.accuracy = std::stod(field);
-        std::getline(ss, field, ','); stat.errors = std::stoi(field);
-        std::getline(ss, field, ','); stat.total_chars = std::stoi(field);
-        std::getline(ss, field, ','); stat.duration = std::stoi(field);
-        std::getline(ss, stat.text);
-        
-        stats.push_back(stat);
-    }
+    row += FULL_STATS_ROWS + 1;
     
-    return stats;
+    displayLine(row, RESULTS_PROMPT);
 }
 
-void StatsAnalyzer::displaySpeedBarChart(const std::vector<SessionStats>& stats, 
-                                       double current_cpm, int y_offset) {
+void StatsAnalyzer::displaySpeedBarChart(const StatsHistory& history, int top, HistoryChart::View* view) {
     auto [height, width] = console_.getScreenSize();
-    int chart_width = width / 2;
-    int chart_height = 8;  // Уменьшаем высоту графика
-    
-    // Берем последние N результатов для отображения
-    const int max_bars = chart_width;  // Каждый столбец шириной 1 символ
-    int start_idx = std::max(0, static_cast<int>(stats.size()) - max_bars);
-    std::vector<double> speeds;
-    for (size_t i = start_idx; i < stats.size(); ++i) {
-        speeds.push_back(stats[i].cpm);
+    (void)height;
+    size_t chart_width = static_cast<size_t>(std::max(1, width / 2));
+    
+    // Пирамида уже построена в истории: здесь только прореживание окна до ширины графика.
+    // Без окна видна вся история, текущий результат - последний столбец
+    const HistoryChart& chart = history.chart();
+    size_t first = 0;
+    size_t last = chart.size();
+    if (view) {
+        std::tie(first, last) = view->window(chart.size(), chart_width);
+    }
+    std::vector<HistoryChart::Column> columns;
+    chart.downsample(first, last, chart_width, columns);
+    if (columns.empty()) {
+        return;
+    }
+    
+    // Масштаб - по максимуму, чтобы разброс сессий тоже поместился
+    float max_speed = 0.0f;
+    for (const auto& column : columns) {
+        max_speed = std::max(max_speed, column.max);
+    }
+    
+    // Точка ряда - сессия или свертка за период, поэтому на столбец считаются точки, а не сессии
+    size_t visible = last - first;
+    displayLine(top, view ? "История скорости печати (+/- масштаб, </> сдвиг)" : "История скорости печати");
+    std::string subtitle = "(" + std::to_string(history.summary().record_count) + " сессий";
+    if (visible < chart.size()) {
+        subtitle += ", точки " + std::to_string(first + 1) + "-" + std::to_string(last) +
+                    " из " + std::to_string(chart.size());
     }
-    speeds.push_back(current_cpm);
-    
-    // Находим максимальную скорость для масштабирования
-    double max_speed = *std::max_element(speeds.begin(), speeds.end());
-    
-    // Отображаем заголовок
-    console_.displayTextCentered("История скорости печати", y_offset);
-    console_.displayTextCentered("(последние " + std::to_string(speeds.size()) + " сессий, макс. " + 
-                                std::to_string(static_cast<int>(max_speed)) + " сим/мин)", y_offset + 1);
-    
-    // Рисуем столбцы
-    int start_x = (width - speeds.size()) / 2;
-    for (size_t i = 0; i < speeds.size(); ++i) {
-        int bar_height = static_cast<int>((speeds[i] / max_speed) * chart_height);
-        
-        // Рисуем столбец
-        for (int h = 0; h < bar_height; ++h) {
-            console_.moveCursor(height/2 + y_offset + chart_height - h, start_x + i);
-            console_.setColor(i == speeds.size()-1 ? ConsoleHandler::COLOR_CURRENT 
-                                                 : ConsoleHandler::COLOR_TYPED);
-            console_.displayText("█");
-        }
+    if (visible > columns.size()) {
+        subtitle += ", ~" + std::to_string((visible + columns.size() - 1) / columns.size()) + " точек на столбец";
     }
+    subtitle += ", макс. " + std::to_string(static_cast<int>(max_speed)) + " сим/мин)";
+    displayLine(top + 1, subtitle);
+    
+    HistoryChart::render(console_, top + 2, (width - static_cast<int>(columns.size())) / 2,
+                         CHART_ROWS, columns, max_speed);
 }
 
-void StatsAnalyzer::displayFullStats(const std::vector<SessionStats>& stats,
+void StatsAnalyzer::displayFullStats(int top,
+                                   const StatsSummaryData& summary,
+                                   const StatsRollup& totals,
                                    double current_cpm,
                                    double current_accuracy,
                                    int current_errors,
                                    int current_chars,
-                                   std::chrono::seconds current_duration) {
-    auto avg_cpm = calculateAverage(stats, [](const SessionStats& s) { return s.cpm; });
-    auto avg_accuracy = calculateAverage(stats, [](const SessionStats& s) { return s.accuracy; });
-    auto avg_errors = calculateAverage(stats, [](const SessionStats& s) { return static_cast<double>(s.errors); });
-    
-    std::vector<std::string> stat_lines = {
-        "Текущий результат:",
-        "  Скорость: " + std::to_string(static_cast<int>(current_cpm)) + " сим/мин " + 
-            formatChange(current_cpm, avg_cpm),
-        "  Точность: " + std::to_string(static_cast<int>(current_accuracy)) + "% " + 
-            formatChange(current_accuracy, avg_accuracy),
-        "  Ошибки: " + std::to_string(current_errors) + " " + 
-            formatChange(-current_errors, -avg_errors),
-        "  Символов: " + std::to_string(current_chars),
-        "  Время: " + std::to_string(current_duration.count()) + " сек",
-        "",
-        "Средние показатели:",
-        "  Скорость: " + std::to_string(static_cast<int>(avg_cpm)) + " сим/мин",
-        "  Точность: " + std::to_string(static_cast<int>(avg_accuracy)) + "%",
-        "  Ошибки: " + std::to_string(static_cast<int>(avg_errors)),
-        "  Всего сессий: " + std::to_string(stats.size() + 1)
+                                   std::chrono::duration<double> current_duration) {
+    auto avg_cpm = summary.cpm.mean;
+    auto avg_accuracy = summary.accuracy.mean;
+    auto avg_errors = summary.errors.mean;
+    
+    struct StatLine {
+        std::string text;
+        std::string change;
+        int color;
+    };
+    int cpm_color = 0;
+    int accuracy_color = 0;
+    int errors_color = 0;
+    std::string cpm_change = formatChange(current_cpm, avg_cpm, cpm_color);
+    std::string accuracy_change = formatChange(current_accuracy, avg_accuracy, accuracy_color);
+    std::string errors_change = formatChange(-current_errors, -avg_errors, errors_color);
+    std::vector<StatLine> stat_lines = {
+        {"Текущий результат:", "", 0},
+        {"  Скорость: " + std::to_string(static_cast<int>(current_cpm)) + " сим/мин ", cpm_change, cpm_color},
+        {"  Точность: " + std::to_string(static_cast<int>(current_accuracy)) + "% ", accuracy_change, accuracy_color},
+        {"  Ошибки: " + std::to_string(current_errors) + " ", errors_change, errors_color},
+        {"  Символов: " + std::to_string(current_chars), "", 0},
+        {"  Время: " + std::to_string(static_cast<int>(current_duration.count())) + " сек", "", 0},
+        {"", "", 0},
+        {"Средние показатели:", "", 0},
+        {"  Скорость: " + std::to_string(static_cast<int>(avg_cpm)) + " сим/мин", "", 0},
+        {"  Точность: " + std::to_string(static_cast<int>(avg_accuracy)) + "%", "", 0},
+        {"  Ошибки: " + std::to_string(static_cast<int>(avg_errors)), "", 0},
+        {"  Скорость за " + std::to_string(SUMMARY_EWMA_HORIZONS[0]) + " сессий: " +
+            std::to_string(static_cast<int>(summary.cpm.ewma[0])) + " сим/мин", "", 0},
+        // Процентили по гистограммам всей истории, с точностью до корзины
+        {"  Медиана скорости: " + std::to_string(static_cast<int>(totals.cpmPercentile(0.5))) +
+            " сим/мин, 90% сессий медленнее " + std::to_string(static_cast<int>(totals.cpmPercentile(0.9))), "", 0},
+        {"  Медиана точности: " + std::to_string(static_cast<int>(totals.accuracyPercentile(0.5))) +
+            "%, 10% сессий ниже " + std::to_string(static_cast<int>(totals.accuracyPercentile(0.1))) + "%", "", 0},
+        {"  Лучшая скорость: " + std::to_string(static_cast<int>(summary.cpm.max)) + " сим/мин", "", 0},
+        {"  Всего сессий: " + std::to_string(summary.record_count), "", 0}
     };
     
+    for (size_t i = 0; i < stat_lines.size(); ++i) {
+        displayLine(top + static_cast<int>(i), stat_lines[i].text, stat_lines[i].change, stat_lines[i].color);
+    }
+}
+
+void StatsAnalyzer::displayLine(int row, const std::string& text, const std::string& change, int change_color) {
     auto [height, width] = console_.getScreenSize();
-    int start_y = height/2 + 8;  // Увеличиваем отступ снизу
+    if (row < 0 || row >= height) {
+        return;
+    }
     
-    for (size_t i = 0; i < stat_lines.size(); ++i) {
-        console_.setColor(ConsoleHandler::COLOR_UNTYPED);
-        console_.displayTextCentered(stat_lines[i], start_y + i);
+    // Ширина в колонках терминала, а не в байтах UTF-8
+    std::wstring wide;
+    decodeUtf8(text + change, wide);
+    int display_width = wcswidth(wide.data(), wide.size());
+    if (display_width < 0) {
+        display_width = static_cast<int>(wide.size());
     }
     
-    // Добавляем сообщение о продолжении с большим отступом
-    console_.displayTextCentered("Нажмите ENTER для продолжения или ESC/Q для выхода...", start_y + stat_lines.size() + 2);
+    console_.clearLine(row);
+    console_.moveCursor(row, std::max(0, (width - display_width) / 2));
+    console_.setColor(Renderer::COLOR_UNTYPED);
+    console_.displayText(text);
+    if (!change.empty()) {
+        console_.setColor(change_color);
+        console_.displayText(change);
+    }
+    console_.resetColor();
 }
 
-std::string StatsAnalyzer::formatChange(double current, double average) {
+std::string StatsAnalyzer::formatChange(double current, double average, int& color) {
     if (average == 0) return "";
     
     double change = ((current - average) / average) * 100;
@@ -137,22 +176,13 @@ std::string StatsAnalyzer::formatChange(double current, double average) {
     
     if (change > 0) {
         ss << "(+" << change << "%)";
-        return "\033[32m" + ss.str() + "\033[0m";  // Зеленый цвет для улучшения
+        color = Renderer::COLOR_TYPED;  // Зеленый цвет для улучшения
+        return ss.str();
     } else if (change < 0) {
         ss << "(" << change << "%)";
-        return "\033[31m" + ss.str() + "\033[0m";  // Красный цвет для ухудшения
+        color = Renderer::COLOR_ERROR;  // Красный цвет для ухудшения
+        return ss.str();
     }
     
     return "";
 }
-
-double StatsAnalyzer::calculateAverage(const std::vector<SessionStats>& stats,
-                                     const std::function<double(const SessionStats&)>& getter) {
-    if (stats.empty()) return 0.0;
-    
-    double sum = 0.0;
-    for (const auto& stat : stats) {
-        sum += getter(stat);
-    }
-    return sum / stats.size();
-} 
\ No newline at end of file
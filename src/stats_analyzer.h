@@ -1,47 +1,48 @@
 #pragma once
-#include "console_handler.h"
+#include "renderer.h"
+#include "stats_history.h"
 #include <vector>
 #include <string>
 #include <chrono>
-#include <functional>
-
-struct SessionStats {
-    std::string timestamp;
-    double cpm;
-    double accuracy;
-    int errors;
-    int total_chars;
-    int duration;
-    std::string text;
-};
 
 class StatsAnalyzer {
 public:
-    explicit StatsAnalyzer(ConsoleHandler& console);
+    // Подсказка под результатами
+    static constexpr const char* RESULTS_PROMPT = "Нажмите ENTER для продолжения или ESC/Q для выхода...";
+
+    explicit StatsAnalyzer(Renderer& console);
     
-    void displayStats(const std::string& language,
+    // Экран результатов целиком, сверху вниз по высоте экрана: заголовок, график (если помещается),
+    // статистика и подсказка. history уже содержит текущий результат последней записью; диск не читается.
+    // view - окно графика (nullptr - вся история)
+    void displayStats(const StatsHistory& history,
                      double current_cpm,
                      double current_accuracy,
                      int current_errors,
                      int current_chars,
-                     std::chrono::seconds current_duration);
+                     std::chrono::duration<double> current_duration,
+                     HistoryChart::View* view = nullptr);
 
 private:
-    ConsoleHandler& console_;
-    std::vector<SessionStats> loadStats(const std::string& language);
+    Renderer& console_;
     
-    void displaySpeedBarChart(const std::vector<SessionStats>& stats, 
-                            double current_cpm, 
-                            int y_offset);
+    // Заголовок, подпись и столбцы начиная со строки экрана top
+    void displaySpeedBarChart(const StatsHistory& history,
+                            int top,
+                            HistoryChart::View* view);
     
-    void displayFullStats(const std::vector<SessionStats>& stats,
+    // Строки статистики начиная со строки экрана top
+    void displayFullStats(int top,
+                         const StatsSummaryData& summary,
+                         const StatsRollup& totals,
                          double current_cpm,
                          double current_accuracy,
                          int current_errors,
                          int current_chars,
-                         std::chrono::seconds current_duration);
+                         std::chrono::duration<double> current_duration);
     
-    double calculateAverage(const std::vector<SessionStats>& stats,
-                          const std::function<double(const SessionStats&)>& getter);
-    std::string formatChange(double current, double average);
+    // Строка по центру; change - изменение к среднему, выводится цветом change_color
+    void displayLine(int row, const std::string& text, const std::string& change = "", int change_color = 0);
+    // Изменение в процентах "(+1.5%)" и его цвет: зеленый для улучшения, красный для ухудшения
+    std::string formatChange(double current, double average, int& color);
 }; 
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "stats_compactor.h"
+#include "byte_utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const int64_t DAY = 24 * 60 * 60;
+    // Насколько старые записи могут выйти за окно, прежде чем сжатие запустится само
+    const int64_t COMPACT_SLACK = 7 * DAY;
+
+    uint64_t fileSize(const std::string &filename)
+    {
+        struct stat st;
+        return stat(filename.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    uint64_t storeSize(const std::string &key, uint32_t texts_generation)
+    {
+        return fileSize(StatsStore::getStoreFilename(key)) +
+               fileSize(StatsStore::getTextsFilename(key, texts_generation)) +
+               fileSize(StatsStore::getRollupsFilename(key));
+    }
+
+    // Записывает части во временный файл, сбрасывает на диск и переименовывает
+    void replaceFile(const std::string &filename, std::initializer_list<std::string_view> parts)
+    {
+        std::string tmp = filename + ".tmp";
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = fd >= 0;
+        for (std::string_view part : parts)
+            ok = ok && writeAll(fd, part.data(), part.size());
+        ok = ok && fsync(fd) == 0;
+        if (fd >= 0)
+            close(fd);
+        if (!ok || std::rename(tmp.c_str(), filename.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Не удалось записать " + filename);
+        }
+    }
+
+    template <typename T>
+    std::string_view bytesOf(const T &value)
+    {
+        return std::string_view(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    std::string_view bytesOf(const std::vector<T> &values)
+    {
+        return std::string_view(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+    }
+
+    // Начало периода по местному времени: mktime сам нормализует дни и учитывает переход на летнее время
+    int64_t normalize(std::tm &tm)
+    {
+        tm.tm_hour = 0;
+        tm.tm_min = 0;
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1;
+        return static_cast<int64_t>(std::mktime(&tm));
+    }
+
+    std::tm localTime(int64_t timestamp)
+    {
+        std::time_t time = static_cast<std::time_t>(timestamp);
+        std::tm tm{};
+        localtime_r(&time, &tm);
+        return tm;
+    }
+}
+
+int64_t StatsCompactor::startOfDay(int64_t timestamp)
+{
+    std::tm tm = localTime(timestamp);
+    return normalize(tm);
+}
+
+int64_t StatsCompactor::startOfWeek(int64_t timestamp)
+{
+    // Неделя начинается с понедельника
+    std::tm tm = localTime(timestamp);
+    tm.tm_mday -= (tm.tm_wday + 6) % 7;
+    return normalize(tm);
+}
+
+int64_t StatsCompactor::startOfMonth(int64_t timestamp)
+{
+    std::tm tm = localTime(timestamp);
+    tm.tm_mday = 1;
+    return normalize(tm);
+}
+
+bool StatsCompactor::due(const StatsStore &store, int64_t now) const
+{
+    return store.size() > 0 &&
+           store.at(0).timestamp < startOfDay(now - policy_.raw_days * DAY) - COMPACT_SLACK;
+}
+
+StatsCompactor::Result StatsCompactor::compact(const StatsStore &store, int64_t now) const
+{
+    const std::string &key = store.key();
+    Result result;
+    result.records_before = store.size();
+    result.rollups_before = store.rollups().size();
+    result.bytes_before = storeSize(key, store.textsGeneration());
+
+    int64_t raw_cutoff = startOfDay(now - policy_.raw_days * DAY);
+    int64_t daily_cutoff = startOfDay(now - policy_.daily_days * DAY);
+    int64_t weekly_cutoff = startOfDay(now - policy_.weekly_days * DAY);
+
+    // Свертки по (началу периода, периоду): упорядочены по времени
+    std::map<std::pair<int64_t, uint32_t>, StatsRollup> rollups;
+    for (const StatsRollup &rollup : store.rollups())
+        rollups[{rollup.period_start, rollup.period}].merge(rollup);
+    auto rollupFor = [&rollups](int64_t start, uint32_t period) -> StatsRollup &
+    {
+        StatsRollup &rollup = rollups[{start, period}];
+        rollup.period_start = start;
+        rollup.period = period;
+        return rollup;
+    };
+
+    // Старые сессии - в дни; тексты остальных - каждый один раз
+    std::vector<SessionStats> records;
+    std::string blob;
+    std::unordered_map<std::string, uint64_t> text_offsets;
+    for (size_t i = 0; i < store.size(); ++i)
+    {
+        SessionStats record = store.at(i);
+        if (record.timestamp < raw_cutoff)
+        {
+            rollupFor(startOfDay(record.timestamp), StatsRollup::PERIOD_DAY).add(record);
+            continue;
+        }
+        std::string text = store.loadText(record);
+        auto inserted = text_offsets.emplace(text, blob.size());
+        if (inserted.second)
+            blob += text;
+        record.text_offset = inserted.first->second;
+        record.text_length = static_cast<uint32_t>(text.size());
+        records.push_back(record);
+    }
+
+    // Дни старше daily_days - в недели, недели старше weekly_days - в месяцы
+    auto demote = [&](uint32_t from, uint32_t to, int64_t cutoff, int64_t (*periodStart)(int64_t))
+    {
+        for (auto it = rollups.begin(); it != rollups.end();)
+        {
+            if (it->first.second == from && it->first.first < cutoff)
+            {
+                StatsRollup rollup = it->second;
+                it = rollups.erase(it);
+                rollupFor(periodStart(rollup.period_start), to).merge(rollup);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    };
+    demote(StatsRollup::PERIOD_DAY, StatsRollup::PERIOD_WEEK, daily_cutoff, startOfWeek);
+    demote(StatsRollup::PERIOD_WEEK, StatsRollup::PERIOD_MONTH, weekly_cutoff, startOfMonth);
+
+    std::vector<StatsRollup> ordered;
+    ordered.reserve(rollups.size());
+    for (const auto &entry : rollups)
+        ordered.push_back(entry.second);
+
+    // Порядок замены: новый файл текстов (пока ни на что не ссылается), свертки
+    // (читатели скрывают записи до compacted_until, поэтому ничего не учитывается дважды),
+    // затем записи, которые переключают и файл текстов
+    uint32_t generation = store.textsGeneration() + 1;
+    replaceFile(StatsStore::getTextsFilename(key, generation), {blob});
+
+    StatsRollupHeader rollup_header{};
+    std::memcpy(rollup_header.magic, "TRLP", 4);
+    rollup_header.version = StatsRollup::FORMAT_VERSION;
+    rollup_header.rollup_size = sizeof(StatsRollup);
+    rollup_header.rollup_count = ordered.size();
+    rollup_header.compacted_until = std::max(store.compactedUntil(), raw_cutoff);
+    replaceFile(StatsStore::getRollupsFilename(key), {bytesOf(rollup_header), bytesOf(ordered)});
+
+    StatsStoreHeader header = store.header();
+    header.record_count = records.size();
+    header.blob_size = blob.size();
+    header.texts_generation = generation;
+    header.first_timestamp = records.empty() ? 0 : records.front().timestamp;
+    header.last_timestamp = records.empty() ? 0 : records.back().timestamp;
+    replaceFile(StatsStore::getStoreFilename(key), {bytesOf(header), bytesOf(records)});
+
+    // Переименования тоже должны дойти до диска
+    std::string directory = StatsStore::getStoreFilename(key);
+    directory.resize(directory.rfind('/') + 1);
+    int dir_fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    std::remove(StatsStore::getTextsFilename(key, store.textsGeneration()).c_str());
+
+    result.records_after = records.size();
+    result.rollups_after = ordered.size();
+    result.bytes_after = storeSize(key, generation);
+    return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "stats_store.h"
+#include <cstdint>
+#include <string>
+
+// Сколько хранить каждый уровень детализации, в днях от текущего момента
+struct CompactionPolicy
+{
+    int raw_days = 90;        // отдельные сессии
+    int daily_days = 365;     // свертки по дням, дальше - по неделям
+    int weekly_days = 3 * 365; // свертки по неделям, дальше - по месяцам
+};
+
+// Сжатие истории: сессии старше raw_days сворачиваются по дням, старые дни - в недели,
+// старые недели - в месяцы; тексты оставшихся записей складываются в новый файл текстов
+// без повторов. Объем файлов и время загрузки ограничены окном сырых записей и числом сверток
+// (не больше года дней, трех лет недель и по 12 в год месяцев)
+class StatsCompactor
+{
+public:
+    struct Result
+    {
+        size_t records_before = 0;
+        size_t records_after = 0;
+        size_t rollups_before = 0;
+        size_t rollups_after = 0;
+        uint64_t bytes_before = 0; // записи, тексты и свертки
+        uint64_t bytes_after = 0;
+    };
+
+    explicit StatsCompactor(const CompactionPolicy &policy = CompactionPolicy()) : policy_(policy) {}
+
+    // Пора ли сжимать: самые старые записи вышли за окно сырых записей больше чем на неделю
+    bool due(const StatsStore &store, int64_t now) const;
+
+    // Переписывает файлы хранилища; store после этого устарел и должен быть открыт заново.
+    // Вызывающий держит блокировку журнала (см. StatsWriter::compact)
+    Result compact(const StatsStore &store, int64_t now) const;
+
+    static int64_t startOfDay(int64_t timestamp);
+    static int64_t startOfWeek(int64_t timestamp);
+    static int64_t startOfMonth(int64_t timestamp);
+
+private:
+    CompactionPolicy policy_;
+};
@@ -0,0 +1,68 @@
+#include "stats_history.h"
+#include "stats_writer.h"
+
+StatsHistory::StatsHistory(const std::string &key)
+    : key_(key), store_(key), stored_count_(store_.size()), summary_(key)
+{
+    summary_ready_ = summary_.catchUp(store_);
+    if (!summary_ready_)
+        StatsWriter::shared().refreshSummary(key_);
+}
+
+const StatsSummaryData &StatsHistory::summary() const
+{
+    if (!summary_ready_)
+    {
+        // Писатель пересчитал сводку и записал все результаты, поставленные до этого момента,
+        // поэтому файл уже учитывает и recent_. Если файл недоступен, считаем в памяти
+        StatsWriter::shared().flush();
+        uint64_t rolled = 0;
+        for (const StatsRollup &rollup : store_.rollups())
+            rolled += rollup.count;
+        if (!summary_.reload() || summary_.count() != rolled + size())
+        {
+            summary_.recount(store_);
+            for (const SessionStats &record : recent_)
+                summary_.add(record);
+        }
+        summary_ready_ = true;
+    }
+    return summary_.data();
+}
+
+void StatsHistory::add(const SessionStats &record, std::string text)
+{
+    recent_.push_back(record);
+    summary_.add(record);
+    if (chart_built_)
+    {
+        float cpm = static_cast<float>(record.cpm);
+        chart_.append(cpm, 1, cpm, cpm);
+    }
+    if (totals_built_)
+        totals_.add(record);
+    StatsWriter::shared().submit(key_, record, std::move(text));
+}
+
+const HistoryChart &StatsHistory::chart() const
+{
+    if (!chart_built_)
+    {
+        chart_.build(*this);
+        chart_built_ = true;
+    }
+    return chart_;
+}
+
+const StatsRollup &StatsHistory::totals() const
+{
+    if (!totals_built_)
+    {
+        for (const StatsRollup &rollup : store_.rollups())
+            totals_.merge(rollup);
+        for (size_t i = 0; i < size(); ++i)
+            totals_.add(at(i));
+        totals_built_ = true;
+    }
+    return totals_;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "stats_store.h"
+#include "stats_summary.h"
+#include "history_chart.h"
+#include <string>
+#include <vector>
+
+// История результатов одного ключа (языка или <пользователь>_<язык>) в памяти.
+// Загружается один раз: хранилище отображается в память, сводка сверяется с ним
+// (пересчет несошедшейся сводки уходит в StatsWriter и не задерживает запуск).
+// Новый результат сразу попадает в память и сводку, а на диск уходит в фоне через StatsWriter,
+// поэтому сохранение и экран результатов не читают и не ждут диск
+class StatsHistory
+{
+public:
+    explicit StatsHistory(const std::string &key);
+
+    StatsHistory(const StatsHistory &) = delete;
+    StatsHistory &operator=(const StatsHistory &) = delete;
+
+    // Добавляет результат; текст нужен только на диске
+    void add(const SessionStats &record, std::string text);
+
+    // Записи загруженного хранилища, за ними добавленные с тех пор
+    size_t size() const { return stored_count_ + recent_.size(); }
+    const SessionStats &at(size_t index) const
+    {
+        return index < stored_count_ ? store_.at(index) : recent_[index - stored_count_];
+    }
+    // Свертки сжатых сессий, старше всех записей
+    const std::vector<StatsRollup> &rollups() const { return store_.rollups(); }
+    // Сводка по всей истории. Если при загрузке она не сошлась с хранилищем, ее пересчитывает
+    // StatsWriter в фоне, а первое обращение ждет его
+    const StatsSummaryData &summary() const;
+    const std::string &key() const { return key_; }
+    // Пирамида графика скорости по всей истории: строится при первом обращении,
+    // дальше каждый результат добавляет в нее одну точку
+    const HistoryChart &chart() const;
+    // Свертка всей истории (свертки и записи) ради гистограмм скорости и точности, по которым
+    // считаются процентили: как и пирамида, строится при первом обращении и дополняется в add()
+    const StatsRollup &totals() const;
+
+private:
+    std::string key_;
+    StatsStore store_;
+    size_t stored_count_;
+    std::vector<SessionStats> recent_;
+    mutable StatsSummary summary_;
+    mutable bool summary_ready_;
+    mutable HistoryChart chart_;
+    mutable bool chart_built_ = false;
+    mutable StatsRollup totals_{};
+    mutable bool totals_built_ = false;
+};
@@ -0,0 +1,97 @@
+#include "stats_rollup.h"
+#include "stats_store.h"
+#include <algorithm>
+
+namespace
+{
+    const int ACCURACY_FIRST = 100 - StatsRollup::ACCURACY_BUCKETS + 1;
+
+    int cpmBucket(double cpm)
+    {
+        int bucket = static_cast<int>(cpm / StatsRollup::CPM_BUCKET_WIDTH);
+        return std::clamp(bucket, 0, StatsRollup::CPM_BUCKETS - 1);
+    }
+
+    int accuracyBucket(double accuracy)
+    {
+        int bucket = static_cast<int>(accuracy) - ACCURACY_FIRST + 1;
+        return std::clamp(bucket, 0, StatsRollup::ACCURACY_BUCKETS - 1);
+    }
+
+    // Номер корзины, в которую попадает q-я доля из count значений
+    int percentileBucket(const uint32_t *histogram, int buckets, uint32_t count, double q)
+    {
+        uint64_t target = static_cast<uint64_t>(q * count);
+        uint64_t seen = 0;
+        for (int i = 0; i < buckets; ++i)
+        {
+            seen += histogram[i];
+            if (seen > target)
+                return i;
+        }
+        return buckets - 1;
+    }
+}
+
+void RollupMetric::add(double value, bool first)
+{
+    sum += value;
+    sum_squares += value * value;
+    min = first ? value : std::min(min, value);
+    max = first ? value : std::max(max, value);
+}
+
+void RollupMetric::merge(const RollupMetric &other, bool first)
+{
+    sum += other.sum;
+    sum_squares += other.sum_squares;
+    min = first ? other.min : std::min(min, other.min);
+    max = first ? other.max : std::max(max, other.max);
+}
+
+void StatsRollup::add(const SessionStats &record)
+{
+    bool first = count == 0;
+    cpm.add(record.cpm, first);
+    accuracy.add(record.accuracy, first);
+    errors.add(record.errors, first);
+    duration.add(record.duration, first);
+    total_chars += record.total_chars;
+    cpm_histogram[cpmBucket(record.cpm)]++;
+    accuracy_histogram[accuracyBucket(record.accuracy)]++;
+    count++;
+}
+
+void StatsRollup::merge(const StatsRollup &other)
+{
+    if (other.count == 0)
+        return;
+    bool first = count == 0;
+    cpm.merge(other.cpm, first);
+    accuracy.merge(other.accuracy, first);
+    errors.merge(other.errors, first);
+    duration.merge(other.duration, first);
+    total_chars += other.total_chars;
+    for (int i = 0; i < CPM_BUCKETS; ++i)
+        cpm_histogram[i] += other.cpm_histogram[i];
+    for (int i = 0; i < ACCURACY_BUCKETS; ++i)
+        accuracy_histogram[i] += other.accuracy_histogram[i];
+    count += other.count;
+}
+
+double StatsRollup::cpmPercentile(double q) const
+{
+    if (count == 0)
+        return 0.0;
+    int bucket = percentileBucket(cpm_histogram, CPM_BUCKETS, count, q);
+    return std::clamp((bucket + 0.5) * CPM_BUCKET_WIDTH, cpm.min, cpm.max);
+}
+
+double StatsRollup::accuracyPercentile(double q) const
+{
+    if (count == 0)
+        return 0.0;
+    int bucket = percentileBucket(accuracy_histogram, ACCURACY_BUCKETS, count, q);
+    double value = bucket == 0 ? ACCURACY_FIRST - 0.5 : ACCURACY_FIRST + bucket - 1 + 0.5;
+    return std::clamp(value, accuracy.min, accuracy.max);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+
+struct SessionStats;
+
+// Сумма, сумма квадратов и крайние значения метрики: из них сводка восстанавливает
+// среднее и дисперсию без исходных записей, а свертки складываются друг с другом
+struct RollupMetric
+{
+    double sum;
+    double sum_squares;
+    double min;
+    double max;
+
+    void add(double value, bool first);
+    void merge(const RollupMetric &other, bool first);
+};
+static_assert(sizeof(RollupMetric) == 32, "RollupMetric must stay 32 bytes");
+
+// Свертка сессий за день, неделю или месяц. Формат записи в файле совпадает с раскладкой структуры.
+// Гистограммы скорости и точности складываются точно, процентили по ним - с точностью до корзины
+struct StatsRollup
+{
+    static const uint32_t FORMAT_VERSION = 1;
+
+    static const uint32_t PERIOD_DAY = 1;
+    static const uint32_t PERIOD_WEEK = 2;
+    static const uint32_t PERIOD_MONTH = 3;
+
+    // Скорость - корзинами по 20 сим/мин (последняя открытая), точность - по 1% от 76% до 100%
+    static const int CPM_BUCKETS = 50;
+    static const int CPM_BUCKET_WIDTH = 20;
+    static const int ACCURACY_BUCKETS = 25;
+
+    int64_t period_start; // начало периода, секунды от эпохи (местная полночь)
+    uint32_t period;      // PERIOD_*
+    uint32_t count;       // сколько сессий свернуто
+    RollupMetric cpm;
+    RollupMetric accuracy;
+    RollupMetric errors;
+    RollupMetric duration;
+    uint64_t total_chars;
+    uint32_t cpm_histogram[CPM_BUCKETS];
+    uint32_t accuracy_histogram[ACCURACY_BUCKETS]; // [0] - ниже 76%
+    uint32_t reserved;
+
+    void add(const SessionStats &record);
+    void merge(const StatsRollup &other);
+
+    double meanCpm() const { return count ? cpm.sum / count : 0.0; }
+    double meanAccuracy() const { return count ? accuracy.sum / count : 0.0; }
+    // q в [0, 1]: середина корзины, в которую попадает q-я доля сессий
+    double cpmPercentile(double q) const;
+    double accuracyPercentile(double q) const;
+};
+static_assert(sizeof(StatsRollup) == 456, "StatsRollup must stay 456 bytes");
+
+// Заголовок файла сверток stats/<ключ>_rollups.bin
+struct StatsRollupHeader
+{
+    char magic[4]; // "TRLP"
+    uint32_t version;
+    uint32_t rollup_size; // sizeof(StatsRollup)
+    uint32_t reserved;
+    uint64_t rollup_count;
+    int64_t compacted_until; // записи раньше этого времени уже свернуты
+    uint8_t padding[32];
+};
+static_assert(sizeof(StatsRollupHeader) == 64, "StatsRollupHeader must stay 64 bytes");
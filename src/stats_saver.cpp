@@ -1,53 +1,47 @@
 #include "stats_saver.h"
-#include <filesystem>
-#include <fstream>
-#include <ctime>
-#include <iomanip>
+#include <random>
 
-StatsSaver::StatsSaver()
-{
-    ensureDirectoryExists();
-}
+StatsSaver::StatsSaver(StatsHistory &history) : history_(history) {}
 
-void StatsSaver::saveResult(const std::string &language,
-                            double cpm,
+void StatsSaver::saveResult(double cpm,
                             double accuracy,
                             int errors,
                             int total_chars,
-                            std::chrono::seconds duration,
-                            const std::string &text)
+                            std::chrono::duration<double> duration,
+                            const std::string &text,
+                            uint64_t session_id)
 {
-    std::string filename = getStatsFilename(language);
-    std::ofstream file(filename, std::ios::app);
+    SessionStats record{};
+    record.timestamp = getCurrentTimestamp();
+    record.cpm = cpm;
+    record.accuracy = accuracy;
+    record.errors = errors;
+    record.total_chars = total_chars;
+    // В записи длительность в целых секундах, скорость посчитана по точной
+    record.duration = static_cast<uint32_t>(duration.count());
+    record.session_id = session_id ? session_id : newSessionId();
 
-    if (file.is_open())
-    {
-        file << getCurrentTimestamp() << ","
-             << cpm << ","
-             << accuracy << ","
-             << errors << ","
-             << total_chars << ","
-             << duration.count() << ","
-             << "\"" << text << "\"" // Текст в кавычках для CSV
-             << std::endl;
-    }
+    history_.add(record, text);
 }
 
-std::string StatsSaver::getStatsFilename(const std::string &language)
+std::string StatsSaver::modeKey(const std::string &key, const std::string &mode)
 {
-    return "stats/" + language + "_results.csv";
+    return mode.empty() ? key : key + "_" + mode;
 }
 
-void StatsSaver::ensureDirectoryExists()
+int64_t StatsSaver::getCurrentTimestamp()
 {
-    std::filesystem::create_directory("stats");
+    auto now = std::chrono::system_clock::now();
+    return std::chrono::system_clock::to_time_t(now);
 }
 
-std::string StatsSaver::getCurrentTimestamp()
+uint64_t StatsSaver::newSessionId()
 {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
-}
\ No newline at end of file
+    static std::mt19937_64 gen{std::random_device{}()};
+    uint64_t id;
+    do
+    {
+        id = gen();
+    } while (id == 0);
+    return id;
+}
@@ -1,22 +1,31 @@
 #pragma once
+#include "stats_history.h"
 #include <string>
 #include <chrono>
+#include <cstdint>
 
+// Результат сессии сразу попадает в историю в памяти, а на диск уходит в фоне:
+// завершение сессии не ждет диска
 class StatsSaver
 {
 public:
-    StatsSaver();
+    explicit StatsSaver(StatsHistory &history);
 
-    void saveResult(const std::string &language,
-                    double cpm,
+    void saveResult(double cpm,
                     double accuracy,
                     int errors,
                     int total_chars,
-                    std::chrono::seconds duration,
-                    const std::string &text);
+                    std::chrono::duration<double> duration,
+                    const std::string &text,
+                    uint64_t session_id = 0);
+
+    // Ключ истории режима: результаты режима (например, теста на время "time30") хранятся
+    // отдельно от обычных раундов того же языка; пустой mode - обычные раунды
+    static std::string modeKey(const std::string &key, const std::string &mode);
 
 private:
-    std::string getStatsFilename(const std::string &language);
-    void ensureDirectoryExists();
-    std::string getCurrentTimestamp();
-};
\ No newline at end of file
+    int64_t getCurrentTimestamp();
+    uint64_t newSessionId();
+
+    StatsHistory &history_;
+};
@@ -0,0 +1,510 @@
+#include "stats_store.h"
+#include "byte_utils.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t HEADER_SIZE = sizeof(StatsStoreHeader);
+    const size_t RECORD_SIZE = sizeof(SessionStats);
+    // Записи разных процессов попадают в файл не строго по времени: дубликат ищется с запасом
+    const int64_t DUPLICATE_WINDOW = 600;
+    // Отображение файла записей с запасом: не меньше стольких записей и вдвое больше, чем есть
+    const size_t MIN_MAPPED_RECORDS = 1024;
+
+    // Запись версии 1: то же без session_id
+    struct SessionStatsV1
+    {
+        int64_t timestamp;
+        double cpm;
+        double accuracy;
+        uint32_t errors;
+        uint32_t total_chars;
+        uint32_t duration;
+        uint32_t text_length;
+        uint64_t text_offset;
+    };
+    static_assert(sizeof(SessionStatsV1) == 48, "SessionStatsV1 must stay 48 bytes");
+
+    template <typename T>
+    bool parseNumber(const std::string &line, size_t &pos, T &value)
+    {
+        size_t end = line.find(',', pos);
+        if (end == std::string::npos)
+            return false;
+        auto result = std::from_chars(line.data() + pos, line.data() + end, value);
+        if (result.ec != std::errc())
+            return false;
+        pos = end + 1;
+        return true;
+    }
+
+    // Текст в CSV может быть в кавычках, кавычки внутри удваиваются
+    std::string parseCsvText(const std::string &field)
+    {
+        if (field.size() < 2 || field.front() != '"' || field.back() != '"')
+            return field;
+
+        std::string text;
+        text.reserve(field.size() - 2);
+        for (size_t i = 1; i + 1 < field.size(); ++i)
+        {
+            text += field[i];
+            if (field[i] == '"' && field[i + 1] == '"' && i + 2 < field.size())
+                ++i;
+        }
+        return text;
+    }
+}
+
+StatsStore::StatsStore(const std::string &language)
+    : key_(language), store_filename_(getStoreFilename(language))
+{
+    std::filesystem::create_directory("stats");
+    bool fresh = !std::filesystem::exists(store_filename_);
+
+    openFiles();
+    loadRollups();
+    map();
+
+    // Первый запуск с бинарным хранилищем: переносим накопленную CSV-историю
+    std::string csv = getCsvFilename(language);
+    if (fresh && std::filesystem::exists(csv))
+    {
+        importCsv(csv);
+    }
+}
+
+StatsStore::~StatsStore()
+{
+    unmap();
+    if (store_fd_ >= 0)
+        close(store_fd_);
+    if (texts_fd_ >= 0)
+        close(texts_fd_);
+}
+
+std::string StatsStore::getStoreFilename(const std::string &language)
+{
+    return "stats/" + language + "_results.bin";
+}
+
+std::string StatsStore::getTextsFilename(const std::string &language, uint32_t generation)
+{
+    if (generation == 0)
+        return "stats/" + language + "_texts.bin";
+    return "stats/" + language + "_texts." + std::to_string(generation) + ".bin";
+}
+
+std::string StatsStore::getRollupsFilename(const std::string &language)
+{
+    return "stats/" + language + "_rollups.bin";
+}
+
+std::string StatsStore::getCsvFilename(const std::string &language)
+{
+    return "stats/" + language + "_results.csv";
+}
+
+void StatsStore::openFiles()
+{
+    store_fd_ = open(store_filename_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (store_fd_ < 0)
+    {
+        throw std::runtime_error("Не удалось открыть файл статистики " + store_filename_);
+    }
+
+    ssize_t n = pread(store_fd_, &header_, sizeof(header_), 0);
+    if (n == 0)
+    {
+        // Новый файл: записываем пустой заголовок
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, "TSTB", 4);
+        header_.version = FORMAT_VERSION;
+        header_.record_size = RECORD_SIZE;
+        writeHeader();
+    }
+    else
+    {
+        validateHeader(n);
+    }
+
+    // Файл текстов выбирается по заголовку: сжатие подменяет оба файла одним переименованием записей
+    std::string texts_filename = getTextsFilename(key_, header_.texts_generation);
+    texts_fd_ = open(texts_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (texts_fd_ < 0)
+    {
+        throw std::runtime_error("Не удалось открыть файл статистики " + texts_filename);
+    }
+}
+
+void StatsStore::validateHeader(ssize_t n)
+{
+    if (n == static_cast<ssize_t>(sizeof(header_)) && std::memcmp(header_.magic, "TSTB", 4) == 0 &&
+        header_.version == 1 && header_.record_size == sizeof(SessionStatsV1))
+    {
+        upgrade();
+    }
+
+    if (n != static_cast<ssize_t>(sizeof(header_)) ||
+        std::memcmp(header_.magic, "TSTB", 4) != 0 ||
+        header_.version != FORMAT_VERSION ||
+        header_.record_size != RECORD_SIZE)
+    {
+        throw std::runtime_error("Поврежден файл статистики " + store_filename_);
+    }
+}
+
+void StatsStore::upgrade()
+{
+    // Конвертирует один процесс под блокировкой, остальные ждут ее и открывают новый файл
+    flock(store_fd_, LOCK_EX);
+    int current = open(store_filename_.c_str(), O_RDWR | O_CLOEXEC);
+    if (current < 0)
+    {
+        throw std::runtime_error("Не удалось открыть файл статистики " + store_filename_);
+    }
+    struct stat locked_st, current_st;
+    if (fstat(store_fd_, &locked_st) != 0 || fstat(current, &current_st) != 0 ||
+        locked_st.st_ino != current_st.st_ino)
+    {
+        close(store_fd_);
+        store_fd_ = current;
+        if (pread(store_fd_, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_)))
+        {
+            throw std::runtime_error("Поврежден файл статистики " + store_filename_);
+        }
+        return;
+    }
+    close(current);
+
+    // Записи версии 1 дополняются пустым session_id и переписываются в новый файл
+    struct stat st;
+    fstat(store_fd_, &st);
+    size_t available = st.st_size > static_cast<off_t>(HEADER_SIZE)
+                           ? (st.st_size - HEADER_SIZE) / sizeof(SessionStatsV1)
+                           : 0;
+    size_t count = std::min<size_t>(header_.record_count, available);
+    std::vector<SessionStatsV1> old(count);
+    if (count > 0 &&
+        pread(store_fd_, old.data(), count * sizeof(SessionStatsV1), HEADER_SIZE) !=
+            static_cast<ssize_t>(count * sizeof(SessionStatsV1)))
+    {
+        throw std::runtime_error("Не удалось прочитать файл статистики " + store_filename_);
+    }
+
+    std::vector<SessionStats> records(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        records[i] = {old[i].timestamp, old[i].cpm, old[i].accuracy, old[i].errors, old[i].total_chars,
+                      old[i].duration, old[i].text_length, old[i].text_offset, 0};
+    }
+    header_.version = FORMAT_VERSION;
+    header_.record_size = RECORD_SIZE;
+    header_.record_count = count;
+    header_.wal_applied = 0;
+
+    std::string tmp = store_filename_ + ".tmp";
+    int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 ||
+        !writeAll(fd, &header_, sizeof(header_), 0) ||
+        !writeAll(fd, records.data(), count * RECORD_SIZE, HEADER_SIZE) ||
+        fsync(fd) != 0 ||
+        std::rename(tmp.c_str(), store_filename_.c_str()) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Не удалось обновить формат файла статистики " + store_filename_);
+    }
+    close(store_fd_);
+    store_fd_ = fd;
+}
+
+void StatsStore::writeHeader()
+{
+    writeAll(store_fd_, &header_, sizeof(header_), 0);
+}
+
+void StatsStore::setWalApplied(uint64_t offset)
+{
+    header_.wal_applied = offset;
+    writeHeader();
+}
+
+bool StatsStore::sync()
+{
+    return fdatasync(texts_fd_) == 0 && fdatasync(store_fd_) == 0;
+}
+
+void StatsStore::map()
+{
+    unmap();
+
+    // Записи за пределами файла (оборванная запись) не учитываем
+    struct stat st;
+    if (fstat(store_fd_, &st) != 0)
+        return;
+    size_t available = st.st_size > static_cast<off_t>(HEADER_SIZE)
+                           ? (st.st_size - HEADER_SIZE) / RECORD_SIZE
+                           : 0;
+    count_ = std::min<size_t>(header_.record_count, available);
+    if (count_ == 0)
+        return;
+
+    // Хвост отображения за концом файла не читается: append дописывает записи в файл и
+    // только расширяет count_, пока они помещаются в отображение, и переотображает файл,
+    // когда запас кончился, - поэтому дописывание n записей стоит O(log n) переотображений
+    mapping_size_ = HEADER_SIZE + std::max(count_ * 2, MIN_MAPPED_RECORDS) * RECORD_SIZE;
+    void *ptr = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, store_fd_, 0);
+    if (ptr == MAP_FAILED)
+    {
+        mapping_size_ = 0;
+        count_ = 0;
+        return;
+    }
+    mapping_ = ptr;
+    records_ = reinterpret_cast<const SessionStats *>(static_cast<const char *>(mapping_) + HEADER_SIZE);
+
+    // Записи, которые уже свернуты, но еще лежат в файле (сжатие прервалось до замены файла записей)
+    if (compacted_until_ > 0)
+    {
+        first_ = std::lower_bound(records_, records_ + count_, compacted_until_,
+                                  [](const SessionStats &record, int64_t value)
+                                  { return record.timestamp < value; }) -
+                 records_;
+        records_ += first_;
+        count_ -= first_;
+    }
+}
+
+void StatsStore::loadRollups()
+{
+    rollups_.clear();
+    compacted_until_ = 0;
+
+    std::ifstream file(getRollupsFilename(key_), std::ios::binary);
+    if (!file)
+        return;
+    StatsRollupHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, "TRLP", 4) != 0 || header.version != StatsRollup::FORMAT_VERSION ||
+        header.rollup_size != sizeof(StatsRollup))
+    {
+        throw std::runtime_error("Поврежден файл сверток " + getRollupsFilename(key_));
+    }
+    rollups_.resize(header.rollup_count);
+    if (!file.read(reinterpret_cast<char *>(rollups_.data()), rollups_.size() * sizeof(StatsRollup)))
+    {
+        throw std::runtime_error("Поврежден файл сверток " + getRollupsFilename(key_));
+    }
+    compacted_until_ = header.compacted_until;
+}
+
+void StatsStore::unmap()
+{
+    if (mapping_)
+    {
+        munmap(mapping_, mapping_size_);
+    }
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    records_ = nullptr;
+    first_ = 0;
+    count_ = 0;
+}
+
+bool StatsStore::append(SessionStats record, std::string_view text)
+{
+    record.text_offset = header_.blob_size;
+    record.text_length = static_cast<uint32_t>(text.size());
+
+    size_t index = first_ + count_;
+    if (!writeAll(texts_fd_, text.data(), text.size(), record.text_offset) ||
+        !writeAll(store_fd_, &record, RECORD_SIZE, HEADER_SIZE + index * RECORD_SIZE))
+    {
+        return false;
+    }
+
+    // Заголовок обновляется последним: до этого новая запись не видна читателям
+    header_.record_count = index + 1;
+    header_.blob_size += text.size();
+    if (index == 0)
+        header_.first_timestamp = record.timestamp;
+    header_.last_timestamp = record.timestamp;
+    writeHeader();
+
+    if (mapping_ && HEADER_SIZE + (index + 1) * RECORD_SIZE <= mapping_size_)
+        count_++;
+    else
+        map();
+    return true;
+}
+
+bool StatsStore::contains(uint64_t session_id, int64_t timestamp) const
+{
+    if (session_id == 0)
+        return false;
+    for (size_t i = lowerBound(timestamp - DUPLICATE_WINDOW); i < count_; ++i)
+    {
+        if (records_[i].session_id == session_id)
+            return true;
+    }
+    return false;
+}
+
+std::vector<SessionStats> StatsStore::loadLast(size_t n) const
+{
+    size_t first = count_ > n ? count_ - n : 0;
+    return std::vector<SessionStats>(records_ + first, records_ + count_);
+}
+
+size_t StatsStore::lowerBound(int64_t timestamp) const
+{
+    const SessionStats *it = std::lower_bound(
+        records_, records_ + count_, timestamp,
+        [](const SessionStats &record, int64_t value)
+        { return record.timestamp < value; });
+    return it - records_;
+}
+
+StatsAggregate StatsStore::aggregate(size_t first, size_t last) const
+{
+    StatsAggregate result;
+    last = std::min(last, count_);
+    for (size_t i = first; i < last; ++i)
+    {
+        result.count++;
+        result.sum_cpm += records_[i].cpm;
+        result.sum_accuracy += records_[i].accuracy;
+        result.sum_errors += records_[i].errors;
+    }
+    return result;
+}
+
+std::string StatsStore::loadText(const SessionStats &record) const
+{
+    std::string text(record.text_length, '\0');
+    ssize_t n = pread(texts_fd_, text.data(), text.size(), record.text_offset);
+    text.resize(n > 0 ? n : 0);
+    return text;
+}
+
+size_t StatsStore::importCsv(const std::string &filename)
+{
+    std::ifstream file(filename);
+    if (!file)
+        return 0;
+
+    std::vector<SessionStats> records;
+    std::string blob;
+    std::string line;
+    // Одна и та же строка, записанная дважды (параллельные запуски), переносится один раз
+    std::unordered_set<uint64_t> seen;
+    while (std::getline(file, line))
+    {
+        // Формат: время,скорость,точность,ошибки,символов,длительность,"текст"
+        size_t comma = line.find(',');
+        if (comma == std::string::npos)
+            continue;
+
+        SessionStats record{};
+        record.timestamp = parseTimestamp(line.substr(0, comma));
+        size_t pos = comma + 1;
+        if (!parseNumber(line, pos, record.cpm) ||
+            !parseNumber(line, pos, record.accuracy) ||
+            !parseNumber(line, pos, record.errors) ||
+            !parseNumber(line, pos, record.total_chars) ||
+            !parseNumber(line, pos, record.duration))
+        {
+            continue;
+        }
+
+        record.session_id = fnv1a(line.data(), line.size());
+        if (!seen.insert(record.session_id).second)
+            continue;
+
+        std::string text = parseCsvText(line.substr(pos));
+        record.text_offset = header_.blob_size + blob.size();
+        record.text_length = static_cast<uint32_t>(text.size());
+        blob += text;
+        records.push_back(record);
+    }
+
+    if (records.empty())
+        return 0;
+
+    // Переносим одним блоком: тексты, записи, затем заголовок
+    size_t first = first_ + count_;
+    if (!writeAll(texts_fd_, blob.data(), blob.size(), header_.blob_size) ||
+        !writeAll(store_fd_, records.data(), records.size() * RECORD_SIZE, HEADER_SIZE + first * RECORD_SIZE))
+    {
+        return 0;
+    }
+
+    header_.record_count = first + records.size();
+    header_.blob_size += blob.size();
+    if (first == 0)
+        header_.first_timestamp = records.front().timestamp;
+    header_.last_timestamp = records.back().timestamp;
+    writeHeader();
+
+    map();
+    return records.size();
+}
+
+void StatsStore::exportCsv(std::ostream &out) const
+{
+    // Скорость и точность без потерь при обратном импорте
+    std::streamsize precision = out.precision(17);
+    for (size_t i = 0; i < count_; ++i)
+    {
+        const SessionStats &record = records_[i];
+        std::string text = loadText(record);
+
+        out << formatTimestamp(record.timestamp) << ","
+            << record.cpm << ","
+            << record.accuracy << ","
+            << record.errors << ","
+            << record.total_chars << ","
+            << record.duration << ",\"";
+        for (char c : text)
+        {
+            if (c == '"')
+                out << '"';
+            out << c;
+        }
+        out << "\"\n";
+    }
+    out.precision(precision);
+}
+
+std::string StatsStore::formatTimestamp(int64_t timestamp)
+{
+    std::time_t time = static_cast<std::time_t>(timestamp);
+    std::tm tm{};
+    localtime_r(&time, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+int64_t StatsStore::parseTimestamp(const std::string &timestamp)
+{
+    std::tm tm{};
+    if (!strptime(timestamp.c_str(), "%Y-%m-%d %H:%M:%S", &tm))
+        return 0;
+    tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&tm));
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "stats_rollup.h"
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <sys/types.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Запись о сессии фиксированной ширины. Формат записи в файле совпадает с раскладкой структуры
+struct SessionStats
+{
+    int64_t timestamp;    // время сессии, секунды от эпохи
+    double cpm;
+    double accuracy;
+    uint32_t errors;
+    uint32_t total_chars;
+    uint32_t duration;    // секунды
+    uint32_t text_length; // длина текста в байтах
+    uint64_t text_offset; // смещение текста в файле текстов
+    uint64_t session_id;  // повторная запись той же сессии не добавляется
+};
+static_assert(sizeof(SessionStats) == 56, "SessionStats must stay 56 bytes");
+
+// Заголовок файла статистики
+struct StatsStoreHeader
+{
+    char magic[4];           // "TSTB"
+    uint32_t version;
+    uint32_t record_size;    // sizeof(SessionStats)
+    uint32_t texts_generation; // номер файла текстов, меняется при сжатии (0 - <язык>_texts.bin)
+    uint64_t record_count;   // количество записей после заголовка
+    uint64_t blob_size;      // размер файла текстов
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    uint64_t wal_applied;    // до какого смещения журнал предзаписи перенесен в записи
+    uint8_t padding[8];
+};
+static_assert(sizeof(StatsStoreHeader) == 64, "StatsStoreHeader must stay 64 bytes");
+
+// Сумма показателей по диапазону записей
+struct StatsAggregate
+{
+    uint64_t count = 0;
+    double sum_cpm = 0.0;
+    double sum_accuracy = 0.0;
+    double sum_errors = 0.0;
+
+    double averageCpm() const { return count ? sum_cpm / count : 0.0; }
+    double averageAccuracy() const { return count ? sum_accuracy / count : 0.0; }
+    double averageErrors() const { return count ? sum_errors / count : 0.0; }
+};
+
+// Бинарное хранилище статистики:
+//   stats/<язык>_results.bin - заголовок и записи фиксированной ширины в порядке времени
+//                              (сами записи служат индексом по времени);
+//   stats/<язык>_texts.bin   - тексты сессий, на которые ссылаются записи
+//                              (после сжатия - <язык>_texts.<номер>.bin, каждый текст один раз);
+//   stats/<язык>_rollups.bin - свертки старых сессий по дням, неделям и месяцам (StatsCompactor).
+// Файл записей отображается в память, поэтому чтение последних N записей - O(N).
+// Записи раньше compactedUntil() уже учтены в свертках и не видны
+class StatsStore
+{
+public:
+    static const uint32_t FORMAT_VERSION = 2;
+
+    explicit StatsStore(const std::string &language);
+    ~StatsStore();
+
+    StatsStore(const StatsStore &) = delete;
+    StatsStore &operator=(const StatsStore &) = delete;
+
+    // Дописывает запись и ее текст; false - запись не удалась и хранилище не изменилось.
+    // Писать одновременно может только один процесс (см. StatsWriter)
+    bool append(SessionStats record, std::string_view text);
+    // Есть ли среди записей не раньше timestamp (с запасом) сессия session_id
+    bool contains(uint64_t session_id, int64_t timestamp) const;
+    // Сбрасывает записи и тексты на диск
+    bool sync();
+
+    uint64_t walApplied() const { return header_.wal_applied; }
+    void setWalApplied(uint64_t offset);
+
+    size_t size() const { return count_; }
+    const SessionStats &at(size_t index) const { return records_[index]; }
+
+    // Последние n записей (или меньше, если история короче)
+    std::vector<SessionStats> loadLast(size_t n) const;
+    // Индекс первой записи с timestamp >= заданного
+    size_t lowerBound(int64_t timestamp) const;
+    StatsAggregate aggregate(size_t first, size_t last) const;
+    std::string loadText(const SessionStats &record) const;
+
+    // Одноразовый перенос из старого CSV и выгрузка обратно в CSV
+    size_t importCsv(const std::string &filename);
+    void exportCsv(std::ostream &out) const;
+
+    // Свертки по возрастанию начала периода
+    const std::vector<StatsRollup> &rollups() const { return rollups_; }
+    int64_t compactedUntil() const { return compacted_until_; }
+    uint32_t textsGeneration() const { return header_.texts_generation; }
+    const StatsStoreHeader &header() const { return header_; }
+    const std::string &key() const { return key_; }
+
+    static std::string getStoreFilename(const std::string &language);
+    static std::string getTextsFilename(const std::string &language, uint32_t generation = 0);
+    static std::string getRollupsFilename(const std::string &language);
+    static std::string getCsvFilename(const std::string &language);
+    static std::string formatTimestamp(int64_t timestamp);
+    static int64_t parseTimestamp(const std::string &timestamp);
+
+private:
+    void openFiles();
+    void validateHeader(ssize_t n);
+    void upgrade();
+    void loadRollups();
+    void map();
+    void unmap();
+    void writeHeader();
+
+    std::string key_;
+    std::string store_filename_;
+    int store_fd_ = -1;
+    int texts_fd_ = -1;
+
+    StatsStoreHeader header_{};
+    void *mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    const SessionStats *records_ = nullptr;
+    // records_ начинается после first_ уже свернутых записей файла
+    size_t first_ = 0;
+    size_t count_ = 0;
+
+    std::vector<StatsRollup> rollups_;
+    int64_t compacted_until_ = 0;
+};
@@ -0,0 +1,305 @@
+#include "stats_summary.h"
+#include "byte_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+namespace
+{
+    struct TwoPassMetric
+    {
+        double mean = 0.0;
+        double variance = 0.0;
+    };
+
+    // Среднее и дисперсия метрики по всей истории в два прохода: сначала среднее, затем сумма
+    // квадратов отклонений от него. Свертка входит своими суммой и суммой квадратов
+    template <typename Value>
+    TwoPassMetric twoPass(const StatsStore &store, RollupMetric StatsRollup::*metric, Value value)
+    {
+        uint64_t count = store.size();
+        double sum = 0.0;
+        for (const StatsRollup &rollup : store.rollups())
+        {
+            sum += (rollup.*metric).sum;
+            count += rollup.count;
+        }
+        for (size_t i = 0; i < store.size(); ++i)
+            sum += value(store.at(i));
+
+        TwoPassMetric result;
+        if (count == 0)
+            return result;
+        result.mean = sum / count;
+
+        double m2 = 0.0;
+        for (const StatsRollup &rollup : store.rollups())
+        {
+            const RollupMetric &m = rollup.*metric;
+            m2 += std::max(0.0, m.sum_squares - 2.0 * result.mean * m.sum + rollup.count * result.mean * result.mean);
+        }
+        for (size_t i = 0; i < store.size(); ++i)
+        {
+            double delta = value(store.at(i)) - result.mean;
+            m2 += delta * delta;
+        }
+        result.variance = count > 1 ? m2 / (count - 1) : 0.0;
+        return result;
+    }
+}
+
+void MetricSummary::add(double value, uint64_t count_after)
+{
+    sum += value;
+
+    // Алгоритм Уэлфорда: устойчивое обновление среднего и суммы квадратов отклонений
+    double delta = value - mean;
+    mean += delta / count_after;
+    m2 += delta * (value - mean);
+
+    if (count_after == 1)
+    {
+        min = max = value;
+        for (double &average : ewma)
+            average = value;
+        return;
+    }
+
+    min = std::min(min, value);
+    max = std::max(max, value);
+    for (int i = 0; i < SUMMARY_EWMA_COUNT; ++i)
+    {
+        double alpha = 2.0 / (SUMMARY_EWMA_HORIZONS[i] + 1);
+        ewma[i] += alpha * (value - ewma[i]);
+    }
+}
+
+void MetricSummary::merge(const RollupMetric &metric, uint64_t n, uint64_t count_after)
+{
+    if (n == 0)
+        return;
+    uint64_t count_before = count_after - n;
+    double batch_mean = metric.sum / n;
+    double batch_m2 = std::max(0.0, metric.sum_squares - metric.sum * batch_mean);
+
+    double delta = batch_mean - mean;
+    sum += metric.sum;
+    mean += delta * n / count_after;
+    m2 += batch_m2 + delta * delta * count_before * n / count_after;
+
+    if (count_before == 0)
+    {
+        min = metric.min;
+        max = metric.max;
+        for (double &average : ewma)
+            average = batch_mean;
+        return;
+    }
+
+    min = std::min(min, metric.min);
+    max = std::max(max, metric.max);
+    // n одинаковых значений среднего свертки подряд
+    for (int i = 0; i < SUMMARY_EWMA_COUNT; ++i)
+    {
+        double alpha = 2.0 / (SUMMARY_EWMA_HORIZONS[i] + 1);
+        ewma[i] += (1.0 - std::pow(1.0 - alpha, static_cast<double>(n))) * (batch_mean - ewma[i]);
+    }
+}
+
+StatsSummary::StatsSummary(const std::string &language)
+    : filename_(getSummaryFilename(language))
+{
+    if (!load())
+    {
+        reset();
+    }
+}
+
+std::string StatsSummary::getSummaryFilename(const std::string &language)
+{
+    return "stats/" + language + "_summary.bin";
+}
+
+void StatsSummary::reset()
+{
+    std::memset(&data_, 0, sizeof(data_));
+    std::memcpy(data_.magic, "TSUM", 4);
+    data_.version = FORMAT_VERSION;
+}
+
+bool StatsSummary::load()
+{
+    std::ifstream file(filename_, std::ios::binary);
+    if (!file.read(reinterpret_cast<char *>(&data_), sizeof(data_)))
+        return false;
+    return std::memcmp(data_.magic, "TSUM", 4) == 0 && data_.version == FORMAT_VERSION;
+}
+
+bool StatsSummary::save()
+{
+    // Пишем в свой временный файл, сбрасываем на диск и переименовываем: сводка не окажется
+    // оборванной или смешанной, даже если писатель прервется
+    std::string tmp = filename_ + ".XXXXXX";
+    int fd = mkstemp(tmp.data());
+    if (fd < 0)
+        return false;
+    bool written = writeAll(fd, &data_, sizeof(data_)) && fsync(fd) == 0;
+    written = close(fd) == 0 && written;
+    if (!written || std::rename(tmp.c_str(), filename_.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void StatsSummary::add(const SessionStats &record)
+{
+    uint64_t count = ++data_.record_count;
+    data_.last_timestamp = record.timestamp;
+    data_.cpm.add(record.cpm, count);
+    data_.accuracy.add(record.accuracy, count);
+    data_.errors.add(record.errors, count);
+    data_.duration.add(record.duration, count);
+}
+
+void StatsSummary::merge(const StatsRollup &rollup)
+{
+    uint64_t count = data_.record_count += rollup.count;
+    data_.last_timestamp = rollup.period_start;
+    data_.cpm.merge(rollup.cpm, rollup.count, count);
+    data_.accuracy.merge(rollup.accuracy, rollup.count, count);
+    data_.errors.merge(rollup.errors, rollup.count, count);
+    data_.duration.merge(rollup.duration, rollup.count, count);
+}
+
+StatsSummary::State StatsSummary::check(const StatsStore &store) const
+{
+    // Сессии до записей хранилища учтены в свертках
+    uint64_t rolled = 0;
+    for (const StatsRollup &rollup : store.rollups())
+        rolled += rollup.count;
+    uint64_t total = rolled + store.size();
+    uint64_t known = data_.record_count;
+    auto lastMatches = [&]()
+    { return known > rolled && store.at(known - rolled - 1).timestamp == data_.last_timestamp; };
+    // Время последней записи не отличает историю, переписанную сжатием или другим процессом,
+    // поэтому сверяется и содержимое первой записи хранилища и последней учтенной
+    auto rangeMatches = [&]()
+    { return data_.range_checksum == rangeChecksum(store, rolled, known); };
+
+    if (known == total && (store.size() == 0 || lastMatches()) && rangeMatches())
+        return State::Current;
+    // Сводка отстает, но ее последняя запись совпадает с историей - достаточно дочитать новое
+    if (known < total && lastMatches() && rangeMatches())
+        return State::Behind;
+    return State::Stale;
+}
+
+void StatsSummary::addNew(const StatsStore &store)
+{
+    uint64_t rolled = 0;
+    for (const StatsRollup &rollup : store.rollups())
+        rolled += rollup.count;
+    for (size_t i = data_.record_count - rolled; i < store.size(); ++i)
+        add(store.at(i));
+    data_.range_checksum = rangeChecksum(store, rolled, data_.record_count);
+}
+
+void StatsSummary::sync(const StatsStore &store)
+{
+    switch (check(store))
+    {
+    case State::Current:
+        return;
+    case State::Behind:
+        addNew(store);
+        save();
+        return;
+    case State::Stale:
+        rebuild(store);
+        return;
+    }
+}
+
+bool StatsSummary::catchUp(const StatsStore &store)
+{
+    switch (check(store))
+    {
+    case State::Current:
+        return true;
+    case State::Behind:
+        addNew(store);
+        return true;
+    case State::Stale:
+        break;
+    }
+    return false;
+}
+
+void StatsSummary::recount(const StatsStore &store)
+{
+    reset();
+    for (const StatsRollup &rollup : store.rollups())
+        merge(rollup);
+    for (size_t i = 0; i < store.size(); ++i)
+        add(store.at(i));
+    data_.range_checksum = rangeChecksum(store, data_.record_count - store.size(), data_.record_count);
+}
+
+bool StatsSummary::reload()
+{
+    if (load())
+        return true;
+    reset();
+    return false;
+}
+
+void StatsSummary::rebuild(const StatsStore &store)
+{
+    recount(store);
+
+    // Сводка, не прошедшая сверку, удаляется и будет пересчитана при следующей синхронизации
+    if (!save() || !verify(store, data_.record_count))
+        std::remove(filename_.c_str());
+}
+
+uint64_t StatsSummary::rangeChecksum(const StatsStore &store, uint64_t rolled, uint64_t known)
+{
+    uint64_t hash = FNV1A_SEED;
+    auto mix = [&](const SessionStats &record) { hash = fnv1a(&record, sizeof(record), hash); };
+    if (known > rolled && known - rolled <= store.size())
+    {
+        mix(store.at(0));
+        mix(store.at(known - rolled - 1));
+    }
+    return hash;
+}
+
+bool StatsSummary::verify(const StatsStore &store, uint64_t total) const
+{
+    // Сверяется то, что действительно легло на диск, а не копия в памяти
+    StatsSummaryData saved;
+    std::ifstream file(filename_, std::ios::binary);
+    if (!file.read(reinterpret_cast<char *>(&saved), sizeof(saved)) ||
+        std::memcmp(saved.magic, "TSUM", 4) != 0 || saved.version != FORMAT_VERSION ||
+        saved.record_count != total || saved.range_checksum != data_.range_checksum)
+        return false;
+
+    auto close = [](double a, double b)
+    { return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::fabs(b)); };
+    auto matches = [&](const MetricSummary &metric, const TwoPassMetric &expected)
+    { return close(metric.mean, expected.mean) && close(metric.variance(total), expected.variance); };
+
+    return matches(saved.cpm, twoPass(store, &StatsRollup::cpm, [](const SessionStats &r)
+                                      { return r.cpm; })) &&
+           matches(saved.accuracy, twoPass(store, &StatsRollup::accuracy, [](const SessionStats &r)
+                                           { return r.accuracy; })) &&
+           matches(saved.errors, twoPass(store, &StatsRollup::errors, [](const SessionStats &r)
+                                         { return static_cast<double>(r.errors); })) &&
+           matches(saved.duration, twoPass(store, &StatsRollup::duration, [](const SessionStats &r)
+                                           { return static_cast<double>(r.duration); }));
+}
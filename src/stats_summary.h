@@ -0,0 +1,96 @@
+#pragma once
+#include "stats_store.h"
+#include <cstdint>
+#include <string>
+
+// Горизонты скользящих средних, в сессиях
+static const int SUMMARY_EWMA_HORIZONS[] = {10, 50, 200};
+static const int SUMMARY_EWMA_COUNT = 3;
+
+// Накопленные показатели по одной метрике: сумма, среднее и дисперсия по Уэлфорду,
+// минимум/максимум и экспоненциальные скользящие средние
+struct MetricSummary
+{
+    double sum;
+    double mean;
+    double m2;
+    double min;
+    double max;
+    double ewma[SUMMARY_EWMA_COUNT];
+
+    void add(double value, uint64_t count_after);
+    // Добавляет n значений свертки сразу (объединение по Чану для среднего и дисперсии)
+    void merge(const RollupMetric &metric, uint64_t n, uint64_t count_after);
+    double variance(uint64_t count) const { return count > 1 ? m2 / (count - 1) : 0.0; }
+};
+static_assert(sizeof(MetricSummary) == 64, "MetricSummary must stay 64 bytes");
+
+// Формат файла-сводки совпадает с раскладкой структуры
+struct StatsSummaryData
+{
+    char magic[4]; // "TSUM"
+    uint32_t version;
+    uint64_t record_count;  // сколько записей хранилища учтено
+    int64_t last_timestamp; // время последней учтенной записи
+    uint64_t range_checksum; // FNV-1a первой записи хранилища и последней учтенной
+    MetricSummary cpm;
+    MetricSummary accuracy;
+    MetricSummary errors;
+    MetricSummary duration;
+};
+static_assert(sizeof(StatsSummaryData) == 288, "StatsSummaryData must stay 288 bytes");
+
+// Сводка по всей истории языка в stats/<язык>_summary.bin.
+// Обновляется по одной записи, поэтому средние доступны за O(1) без просмотра истории.
+class StatsSummary
+{
+public:
+    static const uint32_t FORMAT_VERSION = 1;
+
+    explicit StatsSummary(const std::string &language);
+
+    // Приводит сводку в соответствие с хранилищем (свертки и записи): дочитывает новые записи,
+    // а если файл отсутствует или не сходится с историей (число записей, время и содержимое
+    // первой и последней учтенной записи) - пересчитывает заново, а записанный файл перечитывает
+    // и сверяет со средним и дисперсией, посчитанными по истории в два прохода.
+    // Пишет файл, поэтому вызывается только под блокировкой журнала (StatsWriter)
+    void sync(const StatsStore &store);
+    // То же без записи файла и без пересчета: новые записи дочитываются в памяти;
+    // false - сводка не сходится с историей, и пересчитать ее должен StatsWriter
+    bool catchUp(const StatsStore &store);
+    // Пересчет по истории только в памяти, когда файл сводки недоступен
+    void recount(const StatsStore &store);
+    // Перечитывает файл сводки; false - файла нет или он не читается (сводка пустая)
+    bool reload();
+
+    // Учитывает запись только в памяти; файл сводки обновляет sync()
+    void add(const SessionStats &record);
+
+    const StatsSummaryData &data() const { return data_; }
+    uint64_t count() const { return data_.record_count; }
+
+    static std::string getSummaryFilename(const std::string &language);
+
+private:
+    enum class State
+    {
+        Current, // сводка учитывает всю историю
+        Behind,  // не хватает только новых записей
+        Stale    // не сходится с историей
+    };
+    State check(const StatsStore &store) const;
+    // Дочитывает записи хранилища после учтенных
+    void addNew(const StatsStore &store);
+
+    bool load();
+    bool save();
+    void reset();
+    void merge(const StatsRollup &rollup);
+    void rebuild(const StatsStore &store);
+    bool verify(const StatsStore &store, uint64_t total) const;
+    // Контрольная сумма первой записи хранилища и записи known (с учетом свернутых rolled)
+    static uint64_t rangeChecksum(const StatsStore &store, uint64_t rolled, uint64_t known);
+
+    std::string filename_;
+    StatsSummaryData data_;
+};
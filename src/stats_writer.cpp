@@ -0,0 +1,355 @@
+#include "stats_writer.h"
+#include "byte_utils.h"
+#include "stats_summary.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Сколько поток ждет, чтобы к пакету присоединились одновременно завершившиеся сессии
+    const auto GROUP_COMMIT_WINDOW = std::chrono::milliseconds(5);
+    // Пакет больше не ждет окна
+    const size_t MAX_BATCH = 256;
+    // Размер журнала, после которого хранилище сбрасывается на диск, а журнал обнуляется
+    const uint64_t CHECKPOINT_BYTES = 1 << 20;
+
+    uint32_t crc32(uint32_t crc, const void *data, size_t size)
+    {
+        static const std::array<uint32_t, 256> table = []
+        {
+            std::array<uint32_t, 256> result{};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                result[i] = c;
+            }
+            return result;
+        }();
+
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t frameChecksum(const SessionStats &record, std::string_view text)
+    {
+        return crc32(crc32(0, &record, sizeof(record)), text.data(), text.size());
+    }
+}
+
+StatsWriter &StatsWriter::shared()
+{
+    static StatsWriter writer;
+    return writer;
+}
+
+StatsWriter::StatsWriter()
+    : thread_(&StatsWriter::run, this) {}
+
+StatsWriter::~StatsWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+std::string StatsWriter::getWalFilename(const std::string &key)
+{
+    return "stats/" + key + "_results.wal";
+}
+
+void StatsWriter::submit(const std::string &key, const SessionStats &record, std::string text)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({key, record, std::move(text)});
+        submitted_++;
+    }
+    wake_.notify_one();
+}
+
+void StatsWriter::refreshSummary(const std::string &key)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Pending pending{key, SessionStats{}, std::string()};
+        pending.summary_only = true;
+        queue_.push_back(std::move(pending));
+        submitted_++;
+    }
+    wake_.notify_one();
+}
+
+void StatsWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = submitted_;
+    done_.wait(lock, [this, target]
+               { return completed_ >= target; });
+}
+
+void StatsWriter::run()
+{
+    std::vector<Pending> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this]
+                   { return stop_ || !queue_.empty(); });
+        if (queue_.empty())
+            break;
+        if (!stop_ && queue_.size() < MAX_BATCH)
+        {
+            wake_.wait_for(lock, GROUP_COMMIT_WINDOW, [this]
+                           { return stop_ || queue_.size() >= MAX_BATCH; });
+        }
+        batch.swap(queue_);
+        lock.unlock();
+
+        // Результаты одного ключа записываются вместе, порядок внутри ключа сохраняется;
+        // запросы пересчета сводки идут после результатов ключа: commit сам сверяет сводку
+        std::stable_sort(batch.begin(), batch.end(), [](const Pending &a, const Pending &b)
+                         { return a.key != b.key ? a.key < b.key : a.summary_only < b.summary_only; });
+        for (size_t first = 0; first < batch.size();)
+        {
+            size_t records = first;
+            while (records < batch.size() && batch[records].key == batch[first].key && !batch[records].summary_only)
+                ++records;
+            size_t last = records;
+            while (last < batch.size() && batch[last].key == batch[first].key)
+                ++last;
+            if (records > first)
+                commit(batch[first].key, batch.data() + first, batch.data() + records);
+            else
+                refresh(batch[first].key);
+            first = last;
+        }
+        size_t count = batch.size();
+        batch.clear();
+
+        lock.lock();
+        completed_ += count;
+        done_.notify_all();
+    }
+}
+
+int StatsWriter::lockWal(const std::string &key)
+{
+    std::string filename = getWalFilename(key);
+    std::error_code ignored;
+    std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), ignored);
+
+    // Блокировка журнала общая для всех процессов и снимается закрытием файла
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+StatsCompactor::Result StatsWriter::compact(const std::string &key, const CompactionPolicy &policy)
+{
+    int fd = lockWal(key);
+    if (fd < 0)
+        throw std::runtime_error("Не удалось заблокировать журнал " + getWalFilename(key));
+    try
+    {
+        StatsCompactor::Result result;
+        {
+            StatsStore store(key);
+            replay(fd, store);
+            result = StatsCompactor(policy).compact(store, std::time(nullptr));
+        }
+        StatsStore compacted(key);
+        StatsSummary summary(key);
+        summary.sync(compacted);
+        compactions_++;
+        close(fd);
+        return result;
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+}
+
+void StatsWriter::refresh(const std::string &key)
+{
+    int fd = lockWal(key);
+    if (fd < 0)
+    {
+        failures_++;
+        return;
+    }
+    try
+    {
+        StatsStore store(key);
+        replay(fd, store);
+        StatsSummary summary(key);
+        summary.sync(store);
+    }
+    catch (const std::exception &)
+    {
+        failures_++;
+    }
+    close(fd);
+}
+
+void StatsWriter::commit(const std::string &key, const Pending *first, const Pending *last)
+{
+    std::string filename = getWalFilename(key);
+    int fd = lockWal(key);
+    if (fd < 0)
+    {
+        failures_++;
+        return;
+    }
+    try
+    {
+        StatsStore store(key);
+        replay(fd, store);
+
+        std::string frames;
+        for (const Pending *p = first; p != last; ++p)
+        {
+            StatsWalFrame frame{};
+            std::memcpy(frame.magic, "TWAL", 4);
+            frame.text_length = static_cast<uint32_t>(p->text.size());
+            frame.record = p->record;
+            frame.checksum = frameChecksum(frame.record, p->text);
+            frames.append(reinterpret_cast<const char *>(&frame), sizeof(frame));
+            frames += p->text;
+        }
+
+        // Точка фиксации пакета: кадры одним write и один fdatasync
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            throw std::runtime_error("Не удалось прочитать журнал " + filename);
+        uint64_t start = st.st_size;
+        if (!writeAll(fd, frames.data(), frames.size()) || fdatasync(fd) != 0)
+        {
+            int ignored_result = ftruncate(fd, start);
+            (void)ignored_result;
+            throw std::runtime_error("Не удалось записать журнал " + filename);
+        }
+        syncs_++;
+
+        for (const Pending *p = first; p != last; ++p)
+        {
+            if (!store.contains(p->record.session_id, p->record.timestamp) && !store.append(p->record, p->text))
+                throw std::runtime_error("Не удалось записать статистику " + key);
+        }
+        // wal_applied продвигается только за записями, уже сброшенными на диск: иначе заголовок
+        // мог бы попасть на диск раньше страниц записей, и после сбоя перенесенные кадры
+        // считались бы примененными при потерянных записях
+        if (!store.sync())
+            throw std::runtime_error("Не удалось сбросить статистику " + key);
+        syncs_++;
+        uint64_t end = start + frames.size();
+        store.setWalApplied(end);
+
+        StatsSummary summary(key);
+        summary.sync(store);
+
+        // Контрольная точка: записи на диске, журнал больше не нужен.
+        // wal_applied обнуляется раньше журнала: если процесс прервется между ними,
+        // кадры перенесутся повторно и отсеются по session_id
+        if (end >= CHECKPOINT_BYTES)
+        {
+            store.setWalApplied(0);
+            if (store.sync() && ftruncate(fd, 0) == 0)
+                syncs_++;
+        }
+
+        // Сжатие запускается само примерно раз в неделю, когда старые сессии выходят за окно;
+        // записи при этом уже на диске, а wal_applied переносится в новый файл как есть
+        StatsCompactor compactor;
+        int64_t now = std::time(nullptr);
+        if (compactor.due(store, now))
+        {
+            compactor.compact(store, now);
+            StatsStore compacted(key);
+            summary.sync(compacted);
+            compactions_++;
+        }
+
+        batches_++;
+        records_ += last - first;
+    }
+    catch (const std::exception &)
+    {
+        // Кадры, уже попавшие в журнал, перенесутся при следующей записи
+        failures_++;
+    }
+    close(fd);
+}
+
+void StatsWriter::replay(int fd, StatsStore &store)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return;
+    uint64_t end = st.st_size;
+    uint64_t position = store.walApplied();
+    if (position > end)
+        position = 0;
+    if (position == end)
+        return;
+
+    std::string data(end - position, '\0');
+    if (pread(fd, data.data(), data.size(), position) != static_cast<ssize_t>(data.size()))
+        return;
+
+    size_t offset = 0;
+    bool appended = false;
+    while (offset + sizeof(StatsWalFrame) <= data.size())
+    {
+        StatsWalFrame frame;
+        std::memcpy(&frame, data.data() + offset, sizeof(frame));
+        if (std::memcmp(frame.magic, "TWAL", 4) != 0 ||
+            frame.text_length > data.size() - offset - sizeof(frame))
+            break;
+        std::string_view text(data.data() + offset + sizeof(frame), frame.text_length);
+        if (frame.checksum != frameChecksum(frame.record, text))
+            break;
+
+        if (!store.contains(frame.record.session_id, frame.record.timestamp))
+        {
+            if (!store.append(frame.record, text))
+                throw std::runtime_error("Не удалось перенести журнал в статистику");
+            appended = true;
+        }
+        offset += sizeof(frame) + frame.text_length;
+    }
+
+    // Оборванный кадр прерванной записи отрезается, иначе за ним потерялись бы следующие
+    if (offset < data.size() && ftruncate(fd, position + offset) != 0)
+        return;
+    // Как и в commit: перенесенные записи на диске раньше, чем wal_applied
+    if (appended)
+    {
+        if (!store.sync())
+            throw std::runtime_error("Не удалось сбросить перенесенную статистику");
+        syncs_++;
+    }
+    store.setWalApplied(position + offset);
+}
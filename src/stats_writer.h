@@ -0,0 +1,96 @@
+#pragma once
+#include "stats_compactor.h"
+#include "stats_store.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Кадр журнала предзаписи: заголовок, запись и text_length байт текста.
+// Формат кадра в файле совпадает с раскладкой структуры
+struct StatsWalFrame
+{
+    char magic[4];        // "TWAL"
+    uint32_t checksum;    // CRC32 записи и текста
+    uint32_t text_length;
+    uint32_t reserved;
+    SessionStats record;
+};
+static_assert(sizeof(StatsWalFrame) == 72, "StatsWalFrame must stay 72 bytes");
+
+// Запись результатов в фоновом потоке с групповой фиксацией.
+// Результаты всех завершившихся за время записи сессий уходят одним пакетом:
+//   1. под блокировкой flock журнала stats/<ключ>_results.wal (общей для всех процессов)
+//      кадры дописываются в журнал и фиксируются одним fdatasync;
+//   2. затем переносятся в хранилище и сводку, повторы той же сессии отбрасываются по session_id;
+//      записи сбрасываются на диск до того, как wal_applied в заголовке отметит кадры примененными;
+//   3. когда журнал разрастается, wal_applied обнуляется, а затем обнуляется и журнал;
+//   4. когда старые сессии выходят за окно сырых записей, история сжимается (StatsCompactor).
+// После сбоя кадры, не попавшие в хранилище, переносятся при следующей записи
+class StatsWriter
+{
+public:
+    // Общий писатель процесса; при выходе из программы дописывает очередь
+    static StatsWriter &shared();
+
+    StatsWriter();
+    ~StatsWriter();
+
+    StatsWriter(const StatsWriter &) = delete;
+    StatsWriter &operator=(const StatsWriter &) = delete;
+
+    // Ставит результат в очередь и сразу возвращается; key - язык или <пользователь>_<язык>
+    void submit(const std::string &key, const SessionStats &record, std::string text);
+    // Ставит в очередь пересчет сводки ключа (StatsSummary::sync под блокировкой журнала)
+    void refreshSummary(const std::string &key);
+    // Ждет, пока все поставленные результаты и пересчеты будут записаны
+    void flush();
+    // Сжимает историю ключа сразу, в вызывающем потоке, под той же блокировкой журнала
+    StatsCompactor::Result compact(const std::string &key, const CompactionPolicy &policy = CompactionPolicy());
+
+    // Пакеты, записанные результаты, вызовы fsync, неудачные пакеты и сжатия за все время
+    uint64_t getBatches() const { return batches_.load(std::memory_order_relaxed); }
+    uint64_t getRecords() const { return records_.load(std::memory_order_relaxed); }
+    uint64_t getSyncs() const { return syncs_.load(std::memory_order_relaxed); }
+    uint64_t getFailures() const { return failures_.load(std::memory_order_relaxed); }
+    uint64_t getCompactions() const { return compactions_.load(std::memory_order_relaxed); }
+
+    static std::string getWalFilename(const std::string &key);
+
+private:
+    struct Pending
+    {
+        std::string key;
+        SessionStats record;
+        std::string text;
+        bool summary_only = false; // только пересчет сводки, без результата
+    };
+
+    void run();
+    // Открывает журнал и берет блокировку; -1 при ошибке
+    static int lockWal(const std::string &key);
+    void commit(const std::string &key, const Pending *first, const Pending *last);
+    // Переносит журнал и приводит сводку в соответствие с хранилищем
+    void refresh(const std::string &key);
+    // Переносит в хранилище кадры журнала после wal_applied; оборванный хвост отрезается
+    void replay(int fd, StatsStore &store);
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::vector<Pending> queue_;
+    uint64_t submitted_ = 0;
+    uint64_t completed_ = 0;
+    bool stop_ = false;
+
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> syncs_{0};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<uint64_t> compactions_{0};
+
+    std::thread thread_;
+};
@@ -1,43 +1,163 @@
 #include "text_provider.h"
-#include <fstream>
-#include <random>
+#include "corpus_bundle.h"
+#include "markov_model.h"
+#include <cstring>
 #include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 TextProvider::TextProvider(const std::string &filename)
+    : filename_(filename), gen_(std::random_device{}())
 {
+    if (const CorpusBundle::Corpus *corpus = CorpusBundle::shared().find(filename))
+    {
+        data_ = corpus->text.data();
+        data_size_ = corpus->text.size();
+        file_mtime_ns_ = corpus->file_mtime_ns;
+        offsets_ = corpus->offsets;
+        line_count_ = corpus->line_count;
+        bundled_ = true;
+        return;
+    }
     loadTexts(filename);
 }
 
+TextProvider::~TextProvider()
+{
+    if (data_ && !bundled_)
+    {
+        munmap(const_cast<char *>(data_), data_size_);
+    }
+}
+
+std::string TextProvider::getIndexFilename(const std::string &filename)
+{
+    return filename + ".idx";
+}
+
 void TextProvider::loadTexts(const std::string &filename)
 {
-    std::ifstream file(filename);
-    if (!file)
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
     {
         throw std::runtime_error("Не удалось открыть файл с текстами");
     }
 
-    std::string line;
-    while (std::getline(file, line))
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
     {
-        if (!line.empty())
-        {
-            texts_.push_back(line);
-        }
+        close(fd);
+        throw std::runtime_error("Файл с текстами пуст");
+    }
+
+    data_size_ = st.st_size;
+    void *ptr = mmap(nullptr, data_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        throw std::runtime_error("Не удалось открыть файл с текстами");
+    }
+    data_ = static_cast<const char *>(ptr);
+
+    uint64_t file_size = st.st_size;
+    int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    file_mtime_ns_ = mtime_ns;
+    std::string index_filename = getIndexFilename(filename);
+
+    if (!loadIndex(index_filename, file_size, mtime_ns))
+    {
+        buildIndex();
+        saveIndex(index_filename, file_size, mtime_ns);
     }
 
-    if (texts_.empty())
+    if (line_count_ == 0)
     {
         throw std::runtime_error("Файл с текстами пуст");
     }
 }
 
-std::string TextProvider::getRandomText()
+bool TextProvider::loadIndex(const std::string &index_filename, uint64_t file_size, int64_t mtime_ns)
+{
+    TextIndexHeader header;
+    CacheFile::Stamp stamp{"TIDX", INDEX_VERSION, file_size, mtime_ns};
+    bool mapped = index_cache_.map(index_filename, stamp, header, [](const TextIndexHeader &h) -> uint64_t
+                                   { return h.line_count == 0 ? 0 : sizeof(h) + h.line_count * sizeof(uint64_t); });
+    if (!mapped)
+        return false;
+
+    offsets_ = index_cache_.next<uint64_t>(header.line_count);
+    line_count_ = header.line_count;
+    return true;
+}
+
+void TextProvider::buildIndex()
+{
+    built_offsets_.clear();
+
+    const char *end = data_ + data_size_;
+    const char *line = data_;
+    while (line < end)
+    {
+        const char *eol = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+
+        // Пустые строки (в том числе из одного \r) пропускаем
+        size_t length = eol - line;
+        if (length > 0 && line[length - 1] == '\r')
+            --length;
+        if (length > 0)
+            built_offsets_.push_back(line - data_);
+
+        line = eol + 1;
+    }
+
+    offsets_ = built_offsets_.data();
+    line_count_ = built_offsets_.size();
+}
+
+void TextProvider::saveIndex(const std::string &index_filename, uint64_t file_size, int64_t mtime_ns)
+{
+    if (line_count_ == 0)
+        return;
+
+    TextIndexHeader header;
+    CacheFile::stamp(header, {"TIDX", INDEX_VERSION, file_size, mtime_ns});
+    header.line_count = line_count_;
+    CacheFile::write(index_filename, &header, sizeof(header), {{offsets_, line_count_ * sizeof(uint64_t)}});
+}
+
+std::string_view TextProvider::getText(size_t index) const
+{
+    const char *line = data_ + offsets_[index];
+    const char *end = data_ + data_size_;
+    const char *eol = static_cast<const char *>(std::memchr(line, '\n', end - line));
+    size_t length = (eol ? eol : end) - line;
+    if (length > 0 && line[length - 1] == '\r')
+        --length;
+    return std::string_view(line, length);
+}
+
+std::string_view TextProvider::getRandomText()
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, texts_.size() - 1);
+    std::uniform_int_distribution<size_t> dis(0, line_count_ - 1);
+    return getText(dis(gen_));
+}
 
-    return texts_[dis(gen)];
+void TextProvider::getRandomText(DecodedText &out)
+{
+    if (generator_)
+    {
+        generator_->generate(gen_, generated_);
+        if (!generated_.empty())
+        {
+            out.assign(generated_);
+            return;
+        }
+    }
+    out.assign(getRandomText());
 }
 
 std::string TextProvider::getLanguageFromFile(const std::string &filename)
@@ -47,4 +167,4 @@ std::string TextProvider::getLanguageFromFile(const std::string &filename)
         return "russian";
     }
     return "english";
-}
\ No newline at end of file
+}
@@ -1,15 +1,82 @@
 #pragma once
+#include <cstdint>
+#include <random>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "decoded_text.h"
+#include "cache_file.h"
 
+class MarkovModel;
+
+// Заголовок кэша индекса строк (<файл>.idx), за ним идут line_count смещений uint64_t
+struct TextIndexHeader
+{
+    char magic[4]; // "TIDX"
+    uint32_t version;
+    uint64_t file_size;  // размер и время изменения файла с текстами,
+    int64_t file_mtime_ns; // для которого построен индекс
+    uint64_t line_count;
+};
+static_assert(sizeof(TextIndexHeader) == 32, "TextIndexHeader must stay 32 bytes");
+
+// Файл с текстами отображается в память, индекс начал непустых строк строится один раз
+// и кэшируется на диске, поэтому запуск не зависит от размера корпуса.
+// Если корпус есть в наборе CorpusBundle, текст и индекс берутся оттуда без открытия файлов
 class TextProvider
 {
 public:
+    static const uint32_t INDEX_VERSION = 1;
+
     explicit TextProvider(const std::string &filename);
-    std::string getRandomText();
+    ~TextProvider();
+
+    TextProvider(const TextProvider &) = delete;
+    TextProvider &operator=(const TextProvider &) = delete;
+
+    // Строка из отображенного файла; действительна, пока жив TextProvider
+    std::string_view getRandomText();
+    // Случайный текст, сразу разобранный в коды символов с ширинами (буферы out переиспользуются).
+    // С генератором это новая строка марковской цепи, а не строка корпуса
+    void getRandomText(DecodedText &out);
+    std::string_view getText(size_t index) const;
+    void getText(size_t index, DecodedText &out) const { out.assign(getText(index)); }
+    size_t size() const { return line_count_; }
+
+    // Генератор случайных текстов по корпусу (nullptr - строки корпуса как есть); модель
+    // не копируется и должна жить, пока берутся тексты. Выбор по номеру (getText) он не затрагивает
+    void setGenerator(const MarkovModel *model) { generator_ = model; }
+
+    // Файл корпуса и его размер и время изменения - для проверки производных кэшей
+    const std::string &getFilename() const { return filename_; }
+    uint64_t getFileSize() const { return data_size_; }
+    int64_t getFileMtimeNs() const { return file_mtime_ns_; }
+    // Весь текст корпуса и смещения начал строк (для упаковки в набор)
+    std::string_view getData() const { return std::string_view(data_, data_size_); }
+    const uint64_t *getOffsets() const { return offsets_; }
+
     static std::string getLanguageFromFile(const std::string &filename);
+    static std::string getIndexFilename(const std::string &filename);
 
 private:
-    std::vector<std::string> texts_;
     void loadTexts(const std::string &filename);
-};
\ No newline at end of file
+    bool loadIndex(const std::string &index_filename, uint64_t file_size, int64_t mtime_ns);
+    void buildIndex();
+    void saveIndex(const std::string &index_filename, uint64_t file_size, int64_t mtime_ns);
+
+    std::string filename_;
+    const char *data_ = nullptr;
+    size_t data_size_ = 0;
+    bool bundled_ = false; // текст и индекс принадлежат набору
+    int64_t file_mtime_ns_ = 0;
+
+    // Смещения начал строк: либо из отображенного кэша, либо построенные в памяти
+    const uint64_t *offsets_ = nullptr;
+    size_t line_count_ = 0;
+    CacheFile index_cache_;
+    std::vector<uint64_t> built_offsets_;
+
+    std::mt19937 gen_;
+    const MarkovModel *generator_ = nullptr;
+    std::string generated_;
+};
@@ -0,0 +1,167 @@
+#include "text_stream.h"
+#include <algorithm>
+#include <cwchar>
+
+namespace
+{
+    // Пробелы в конце строки корпуса не набираются: абзац и так заканчивается разделителем
+    std::string_view trimRight(std::string_view text)
+    {
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+            text.remove_suffix(1);
+        return text;
+    }
+}
+
+TextStream::TextStream(const TextProvider &provider)
+    : provider_(provider) {}
+
+void TextStream::reset(size_t first_line)
+{
+    first_line_ = provider_.size() ? first_line % provider_.size() : 0;
+    seek(Position());
+}
+
+void TextStream::seek(const Position &position)
+{
+    position_ = position;
+}
+
+std::string_view TextStream::paragraph()
+{
+    if (paragraph_loaded_ != position_.item)
+    {
+        paragraph_ = trimRight(provider_.getText(lineIndex(position_.item)));
+        paragraph_loaded_ = position_.item;
+    }
+    return paragraph_;
+}
+
+int TextStream::glyphWidth(wchar_t c)
+{
+    // Управляющие символы и неизвестные wcwidth занимают одну колонку, как в DecodedText
+    uint32_t code = static_cast<uint32_t>(c);
+    if (code >= widths_.size())
+    {
+        int w = wcwidth(c);
+        return w < 0 ? 1 : w;
+    }
+    if (widths_[code] == 0)
+    {
+        int w = wcwidth(c);
+        widths_[code] = static_cast<int8_t>((w < 0 ? 1 : w) + 1);
+    }
+    return widths_[code] - 1;
+}
+
+bool TextStream::nextLine(int width, DecodedText &out)
+{
+    if (position_.item >= provider_.size())
+        return false;
+    out.utf8.clear();
+    out.chars.clear();
+    out.widths.clear();
+    out.columns.clear();
+    out.byte_offsets.clear();
+    out.width = 0;
+
+    // Символы добавляются, пока помещаются; строка рвется после последнего пробела,
+    // а слово длиннее строки - посередине
+    std::string_view text = paragraph();
+    size_t pos = position_.offset;
+    size_t break_chars = 0;
+    size_t break_pos = 0;
+    while (pos < text.size())
+    {
+        size_t char_start = pos;
+        wchar_t c = decodeUtf8Char(text, pos);
+        int w = glyphWidth(c);
+        if (w == 0 && out.chars.empty())
+            w = 1;
+
+        // Пробел остается в конце строки, даже если выступает за ширину
+        if (c != L' ' && w > 0 && !out.chars.empty() && out.width + w > static_cast<uint32_t>(width))
+        {
+            if (break_chars > 0)
+            {
+                if (break_chars < out.chars.size())
+                    out.utf8.resize(out.byte_offsets[break_chars]);
+                out.chars.resize(break_chars);
+                out.widths.resize(break_chars);
+                out.columns.resize(break_chars);
+                out.byte_offsets.resize(break_chars);
+                out.width = out.columns.back() + out.widths.back();
+                pos = break_pos;
+            }
+            else
+            {
+                pos = char_start;
+            }
+            out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+            position_.offset = static_cast<uint32_t>(pos);
+            return true;
+        }
+
+        out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+        out.utf8.append(text.data() + char_start, pos - char_start);
+        out.columns.push_back(w == 0 ? out.columns.back() : out.width);
+        out.chars.push_back(c);
+        out.widths.push_back(static_cast<uint8_t>(w));
+        out.width += w;
+        if (c == L' ')
+        {
+            break_chars = out.chars.size();
+            break_pos = pos;
+        }
+    }
+
+    // Абзац кончился: разделитель набирается пробелом, дальше следующий абзац с новой строки.
+    // После последнего абзаца документа разделителя нет, если строка не пустая
+    bool last = position_.item + 1 == provider_.size();
+    out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+    if (!last || out.chars.empty())
+    {
+        out.utf8.push_back(' ');
+        out.columns.push_back(out.width);
+        out.chars.push_back(L' ');
+        out.widths.push_back(1);
+        out.width += 1;
+        out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+    }
+    position_.item++;
+    position_.offset = 0;
+    return true;
+}
+
+int TextStream::progress(const Position &position) const
+{
+    std::string_view data = provider_.getData();
+    if (position.item >= provider_.size() || data.empty())
+        return 100;
+
+    // Абзацы после конца файла продолжаются с его начала
+    const uint64_t *offsets = provider_.getOffsets();
+    uint64_t first = offsets[first_line_];
+    uint64_t line = offsets[lineIndex(position.item)];
+    uint64_t done = (line >= first ? line - first : data.size() - first + line) + position.offset;
+    return static_cast<int>(std::min<uint64_t>(done * 100 / data.size(), 100));
+}
+
+void TextStream::copy(const Position &position, std::string &out) const
+{
+    out.clear();
+    uint64_t paragraphs = std::min<uint64_t>(position.item, provider_.size());
+    for (uint64_t p = 0; p < paragraphs; ++p)
+    {
+        out += trimRight(provider_.getText(lineIndex(p)));
+        out += ' ';
+    }
+    if (paragraphs == provider_.size())
+        return;
+
+    // Позиция на разделителе после абзаца указывает за его последний байт
+    std::string_view text = trimRight(provider_.getText(lineIndex(paragraphs)));
+    out.append(text.data(), std::min<size_t>(position.offset, text.size()));
+    if (position.offset > text.size())
+        out += ' ';
+}
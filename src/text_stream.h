@@ -0,0 +1,51 @@
+#pragma once
+#include "line_source.h"
+#include "text_provider.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Длинный документ из корпуса для режима длинного текста: строки корпуса (абзацы) идут подряд,
+// начиная с выбранной, и по кругу до нее же. Документ не разбирается целиком - перенос по словам
+// считается по одной экранной строке, когда она вот-вот покажется, поэтому память и время
+// на строку не зависят от того, абзац это или целая книга
+class TextStream : public LineSource
+{
+public:
+    explicit TextStream(const TextProvider &provider);
+
+    // Новый документ с абзаца first_line корпуса
+    void reset(size_t first_line);
+    // Экранная строка заканчивается пробелом, на котором перенесена, абзац - пробелом-разделителем.
+    // Позиция - номер абзаца от начала документа и байт от начала абзаца
+    bool nextLine(int width, DecodedText &out) override;
+    Position tell() const override { return position_; }
+    void seek(const Position &position) override;
+    Position locate(const Position &start, const DecodedText &line, size_t pos) const override
+    {
+        return {start.item, start.offset + line.byte_offsets[pos]};
+    }
+
+    // Доля документа по байтам корпуса
+    int progress(const Position &position) const override;
+    // Абзацы через пробел
+    void copy(const Position &position, std::string &out) const override;
+
+    size_t firstLine() const { return first_line_; }
+
+private:
+    size_t lineIndex(uint64_t paragraph) const { return (first_line_ + paragraph) % provider_.size(); }
+    // Абзац, на котором стоит position_; string_view кэшируется, чтобы не искать конец строки заново
+    std::string_view paragraph();
+    int glyphWidth(wchar_t c);
+
+    const TextProvider &provider_;
+    size_t first_line_ = 0;
+    Position position_;
+    std::string_view paragraph_;
+    uint64_t paragraph_loaded_ = UINT64_MAX;
+
+    // Ширины символов BMP по wcwidth: 0 - еще не спрашивали, иначе ширина + 1
+    std::array<int8_t, 0x10000> widths_{};
+};
@@ -0,0 +1,615 @@
+#include "typing_engine.h"
+#include "line_buffer.h"
+#include "alloc_counter.h"
+#include <algorithm>
+
+namespace
+{
+    // Сколько держится красная подсветка ошибки
+    const auto ERROR_FLASH_DURATION = std::chrono::milliseconds(100);
+    // Период обновления скорости, когда клавиши не нажимаются
+    const auto STATS_REFRESH_INTERVAL = std::chrono::milliseconds(250);
+    // Период обновления оверлея задержек: реже статистики, чтобы не искажать замеры
+    const auto OVERLAY_REFRESH_INTERVAL = std::chrono::milliseconds(500);
+    // Поля слева и справа от окна длинного текста и наименьшая ширина переноса
+    const int STREAM_MARGIN = 4;
+    const int STREAM_MIN_WIDTH = 8;
+    // Запас буферов строки окна: с пробелами и комбинируемыми символов больше, чем колонок
+    const size_t STREAM_LINE_CHARS = TypingEngine::STREAM_MAX_WIDTH * 4;
+}
+
+TypingEngine::TypingEngine(Renderer &renderer, KeystrokeLog *log, LatencyProfile *latency)
+    : renderer_(renderer), log_(log), keyboard_(renderer), latency_(latency) {}
+
+void TypingEngine::begin(const DecodedText &text, const KeyboardLayout &layout, wint_t first_key,
+                         Clock::time_point start)
+{
+    stream_ = nullptr;
+    text_ = &text;
+    line_ = 0;
+    first_visible_ = 0;
+    line_offset_ = 0;
+    startRound(layout, static_cast<int>(text.width), 1, first_key, start);
+}
+
+void TypingEngine::begin(LineSource &source, const KeyboardLayout &layout, wint_t first_key,
+                         Clock::time_point start)
+{
+    // Буферы строк окна выделяются один раз, дальше перенос только переписывает их
+    if (lines_.empty())
+    {
+        lines_.resize(STREAM_LINES);
+        line_starts_.resize(STREAM_LINES);
+        line_marks_.resize(STREAM_LINES);
+        for (DecodedText &line : lines_)
+        {
+            line.utf8.reserve(STREAM_LINE_CHARS * 4);
+            line.chars.reserve(STREAM_LINE_CHARS);
+            line.widths.reserve(STREAM_LINE_CHARS);
+            line.columns.reserve(STREAM_LINE_CHARS);
+            line.byte_offsets.reserve(STREAM_LINE_CHARS + 1);
+        }
+    }
+
+    stream_ = &source;
+    wrap_width_ = streamWidth(renderer_.getScreenSize().second);
+    loaded_ = 0;
+    next_start_ = 0;
+    line_ = 0;
+    first_visible_ = 0;
+    line_offset_ = 0;
+    while (loaded_ < STREAM_LINES && loadLine())
+    {
+    }
+    text_ = &lines_[0];
+    // Пробел на переносе может выступать за ширину строки на одну колонку
+    startRound(layout, wrap_width_ + 1, STREAM_LINES, first_key, start);
+}
+
+void TypingEngine::startRound(const KeyboardLayout &layout, int text_width, int text_height, wint_t first_key,
+                              Clock::time_point start)
+{
+    const std::wstring &wtext = text_->chars;
+    start_ = start;
+    end_ = start;
+    position_ = 0;
+    errors_ = 0;
+    time_up_ = false;
+    error_flash_.stop();
+    if (time_limit_ > Clock::duration::zero())
+        round_end_.start(start + time_limit_);
+    else
+        round_end_.stop();
+    stats_refresh_.start(start + STATS_REFRESH_INTERVAL);
+    if (overlay_visible_ && latency_)
+        overlay_refresh_.start(start + OVERLAY_REFRESH_INTERVAL);
+    else
+        overlay_refresh_.stop();
+
+    if (log_)
+    {
+        // Журнал длинного текста пишется блоками минимального размера
+        log_->beginSession(stream_ ? 0 : wtext.length(), start);
+        log_->record(start, 0, wtext[0], first_key, static_cast<wchar_t>(first_key) == wtext[0]);
+    }
+
+    // Позиции текста и клавиатуры по размеру экрана; дальше пересчитываются только при его смене
+    keyboard_layout_ = &layout;
+    layout_.setContent(text_width, text_height, KeyboardWidget::frameWidth(layout), KeyboardWidget::frameHeight());
+    auto [height, width] = renderer_.getScreenSize();
+    layout_.update(height, width);
+
+    // Первый кадр: текст, подсветка текущего символа и клавиатура
+    renderer_.beginFrame();
+    renderer_.clearScreen();
+
+    // Проверяем, была ли первая буква правильной
+    if (static_cast<wchar_t>(first_key) == wtext[0])
+    {
+        position_ = 1;
+        if (stream_ && position_ >= text_->length())
+            nextLine();
+    }
+
+    // Отображаем текст и клавиатуру после начала
+    drawText();
+    keyboard_.draw(layout, layout_.keyboard().top, layout_.keyboard().left, text_->chars[position_]);
+    if (overlay_visible_ && latency_)
+    {
+        displayLatencyOverlay();
+    }
+    renderer_.commitFrame();
+
+    // Текст из одного символа набран первым же нажатием
+    if (finished() && log_)
+    {
+        log_->endSession(false);
+    }
+}
+
+TypingEngine::RoundResult TypingEngine::run(InputSource &input)
+{
+    // Цикл событий: ввод обрабатывается сразу, а снятие подсветки ошибки
+    // и обновление статистики выполняются по таймерам, не задерживая ввод
+    while (!finished())
+    {
+        wint_t key;
+        bool hasInput = input.waitChar(key, waitTimeoutMs(Clock::now(), error_flash_, stats_refresh_,
+                                                          overlay_refresh_, round_end_));
+        auto eventTime = Clock::now();
+
+        if (!hasInput)
+        {
+            handleTimeout(eventTime);
+        }
+        else if (!handleInput(key, eventTime))
+        {
+            return RoundResult::Aborted;
+        }
+    }
+    return RoundResult::Completed;
+}
+
+bool TypingEngine::handleInput(wint_t key, Clock::time_point when)
+{
+    // Нажатие пришло уже после конца отведенного времени и не считается
+    if (timeUp(when))
+    {
+        return true;
+    }
+
+    if (latency_)
+    {
+        latency_->start(key_timer_, when);
+    }
+
+    // Весь вывод по одному событию уходит в терминал одним кадром
+    renderer_.beginFrame();
+
+    if (!handleKey(key, when))
+    {
+        renderer_.commitFrame();
+        // Длинный текст обычно заканчивают по ESC: набранное до него - результат раунда.
+        // Тест на время, прерванный до конца, результата не дает
+        end_ = when;
+        if (log_)
+            log_->endSession(stream_ == nullptr || time_limit_ != Clock::duration::zero());
+        return false;
+    }
+
+    handleTimers(when);
+    renderer_.commitFrame();
+
+    // Задержка считается только для нажатий, дошедших до отрисовки
+    mark(LatencyProfile::STAGE_FLUSH);
+    if (latency_)
+    {
+        latency_->finish(key_timer_);
+    }
+
+    if (finished())
+    {
+        end_ = Clock::now();
+        if (log_)
+            log_->endSession(false);
+    }
+    return true;
+}
+
+void TypingEngine::handleTimeout(Clock::time_point now)
+{
+    renderer_.beginFrame();
+    handleTimers(now);
+    renderer_.commitFrame();
+}
+
+bool TypingEngine::nextDeadline(Clock::time_point &deadline) const
+{
+    bool found = false;
+    for (const EventTimer *timer : {&error_flash_, &stats_refresh_, &overlay_refresh_, &round_end_})
+    {
+        if (timer->active() && (!found || timer->deadline() < deadline))
+        {
+            deadline = timer->deadline();
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool TypingEngine::handleKey(wint_t input, Clock::time_point when)
+{
+    // Проверяем специальные клавиши
+    if (input == static_cast<wint_t>(27) || // ESC
+        (!stream_ && (input == static_cast<wint_t>('q') || input == static_cast<wint_t>('Q'))))
+    {
+        key_timer_.active = false;
+        return false;
+    }
+
+    if (input == InputSource::KEY_SCREEN_RESIZE)
+    {
+        key_timer_.active = false;
+        relayout(when);
+        return true;
+    }
+
+    if (input == InputSource::KEY_DEBUG_OVERLAY && latency_)
+    {
+        key_timer_.active = false;
+        overlay_visible_ = !overlay_visible_;
+        if (overlay_visible_)
+        {
+            displayLatencyOverlay();
+            overlay_refresh_.start(when + OVERLAY_REFRESH_INTERVAL);
+        }
+        else
+        {
+            clearLatencyOverlay();
+            overlay_refresh_.stop();
+        }
+        return true;
+    }
+
+    uint64_t allocationsBefore = alloc_counter::count();
+    wchar_t current_wchar = text_->chars[position_];
+    bool correct = static_cast<wchar_t>(input) == current_wchar;
+
+    if (log_)
+    {
+        log_->record(when, static_cast<uint32_t>(line_offset_ + position_), current_wchar, input, correct);
+    }
+    mark(LatencyProfile::STAGE_CHECK);
+
+    // Сравниваем символы с приведением типов
+    if (correct)
+    {
+        // При правильном вводе
+        drawChar(position_, Renderer::COLOR_TYPED);
+        position_++;
+        error_flash_.stop();
+
+        // В длинном тексте курсор переходит на следующую строку, и окно прокручивается за ним
+        if (stream_ && position_ >= text_->length() && nextLine())
+        {
+            drawText();
+        }
+
+        // Подсвечиваем следующий символ
+        if (position_ < text_->length())
+        {
+            drawChar(position_, Renderer::COLOR_CURRENT);
+        }
+    }
+    else
+    {
+        // При ошибке подсвечиваем текущий символ красным до срабатывания таймера
+        drawChar(position_, Renderer::COLOR_ERROR);
+        error_flash_.start(when + ERROR_FLASH_DURATION);
+        errors_++;
+    }
+    mark(LatencyProfile::STAGE_DRAW);
+
+    displayRealtimeStats(when);
+    stats_refresh_.start(when + STATS_REFRESH_INTERVAL);
+    mark(LatencyProfile::STAGE_STATS);
+
+    keyboard_.highlight(text_->chars[position_]);
+    mark(LatencyProfile::STAGE_KEYBOARD);
+
+    keystroke_count_++;
+    keystroke_allocations_ += alloc_counter::count() - allocationsBefore;
+    return true;
+}
+
+bool TypingEngine::timeUp(Clock::time_point now)
+{
+    if (!round_end_.expired(now))
+        return time_up_;
+    round_end_.stop();
+    time_up_ = true;
+    end_ = round_end_.deadline();
+    if (log_)
+        log_->endSession(false);
+    return true;
+}
+
+void TypingEngine::handleTimers(Clock::time_point now)
+{
+    if (timeUp(now))
+    {
+        return;
+    }
+
+    // Возвращаем подсветку текущего символа после ошибки
+    if (error_flash_.expired(now))
+    {
+        error_flash_.stop();
+        drawChar(position_, Renderer::COLOR_CURRENT);
+    }
+
+    // Скорость обновляется и во время пауз в наборе
+    if (stats_refresh_.expired(now))
+    {
+        displayRealtimeStats(now);
+        stats_refresh_.start(now + STATS_REFRESH_INTERVAL);
+    }
+
+    if (overlay_refresh_.expired(now))
+    {
+        displayLatencyOverlay();
+        overlay_refresh_.start(now + OVERLAY_REFRESH_INTERVAL);
+    }
+}
+
+void TypingEngine::drawChar(size_t pos, int color)
+{
+    // Рисуем графему целиком, чтобы комбинируемые знаки остались со своей основой
+    size_t first = text_->clusterStart(pos);
+    size_t last = text_->clusterEnd(pos);
+    int row = layout_.text().top + static_cast<int>(line_ - first_visible_);
+    renderer_.moveCursor(row, layout_.text().left + text_->columns[first]);
+    renderer_.setColor(color);
+    renderer_.displayText(*text_, first, last);
+}
+
+void TypingEngine::drawText()
+{
+    if (!stream_)
+    {
+        drawLine(*text_, layout_.text().top, position_);
+    }
+    else
+    {
+        // Строки выше курсора набраны, ниже - нет; за концом документа строки окна пустые
+        for (int row = 0; row < STREAM_LINES; ++row)
+        {
+            uint64_t line = first_visible_ + row;
+            if (line >= loaded_)
+            {
+                clearRect({layout_.text().top + row, layout_.text().left, 1, layout_.text().width});
+                continue;
+            }
+            const DecodedText &text = lines_[line % STREAM_LINES];
+            drawLine(text, layout_.text().top + row, line < line_ ? text.length() : line > line_ ? 0 : position_);
+        }
+    }
+    if (position_ < text_->length())
+    {
+        drawChar(position_, error_flash_.active() ? Renderer::COLOR_ERROR : Renderer::COLOR_CURRENT);
+    }
+}
+
+void TypingEngine::drawLine(const DecodedText &line, int row, size_t typed)
+{
+    size_t length = line.length();
+    typed = std::min(typed, length);
+    renderer_.moveCursor(row, layout_.text().left);
+    renderer_.setColor(Renderer::COLOR_TYPED);
+    renderer_.displayText(line, 0, typed);
+    renderer_.setColor(Renderer::COLOR_UNTYPED);
+    renderer_.displayText(line, typed, length);
+
+    // Хвост прежней, более длинной строки на этом месте
+    int width = static_cast<int>(line.width);
+    if (width < layout_.text().width)
+    {
+        clearRect({row, layout_.text().left + width, 1, layout_.text().width - width});
+    }
+}
+
+int TypingEngine::streamWidth(int screen_width)
+{
+    return std::max(STREAM_MIN_WIDTH, std::min(STREAM_MAX_WIDTH, screen_width - 2 * STREAM_MARGIN));
+}
+
+bool TypingEngine::loadLine()
+{
+    // Слот строки, ушедшей из окна; перенос пишет в уже выделенные буферы
+    size_t slot = loaded_ % STREAM_LINES;
+    line_marks_[slot] = stream_->tell();
+    if (!stream_->nextLine(wrap_width_, lines_[slot]))
+        return false;
+    line_starts_[slot] = next_start_;
+    next_start_ += lines_[slot].length();
+    loaded_++;
+    return true;
+}
+
+bool TypingEngine::nextLine()
+{
+    if (line_ + 1 >= loaded_)
+        return false;
+    line_offset_ += text_->length();
+    line_++;
+    position_ = 0;
+    text_ = &lines_[line_ % STREAM_LINES];
+
+    // Курсор держится на второй строке окна, над ним остается только что набранная строка
+    if (line_ - first_visible_ > 1)
+        first_visible_ = line_ - 1;
+    while (loaded_ < first_visible_ + STREAM_LINES && loadLine())
+    {
+    }
+    return true;
+}
+
+void TypingEngine::rewrap(int width)
+{
+    // Перенос заново с верхней строки окна: ее начало в документе от ширины не зависит
+    uint64_t typed = line_offset_ + position_;
+    uint64_t base = first_visible_;
+    size_t slot = base % STREAM_LINES;
+    stream_->seek(line_marks_[slot]);
+    next_start_ = line_starts_[slot];
+    loaded_ = base;
+    wrap_width_ = width;
+
+    line_ = base;
+    while (loadLine())
+    {
+        line_ = loaded_ - 1;
+        slot = line_ % STREAM_LINES;
+        if (typed < line_starts_[slot] + lines_[slot].length())
+            break;
+    }
+    slot = line_ % STREAM_LINES;
+    text_ = &lines_[slot];
+    line_offset_ = line_starts_[slot];
+    position_ = typed - line_offset_;
+    first_visible_ = line_ > base ? line_ - 1 : base;
+    while (loaded_ < first_visible_ + STREAM_LINES && loadLine())
+    {
+    }
+}
+
+LineSource::Position TypingEngine::streamPosition() const
+{
+    return stream_->locate(line_marks_[line_ % STREAM_LINES], *text_, position_);
+}
+
+void TypingEngine::relayout(Clock::time_point now)
+{
+    LayoutRect old_text = layout_.text();
+    LayoutRect old_stats = layout_.stats();
+    LayoutRect old_keyboard = layout_.keyboard();
+    auto [height, width] = renderer_.getScreenSize();
+    // Длинный текст переносится под новую ширину; однострочный текст только сдвигается
+    if (stream_ && streamWidth(width) != wrap_width_)
+    {
+        rewrap(streamWidth(width));
+        layout_.setContent(wrap_width_ + 1, STREAM_LINES, KeyboardWidget::frameWidth(*keyboard_layout_),
+                           KeyboardWidget::frameHeight());
+    }
+    unsigned changed = layout_.update(height, width);
+
+    // Сначала стираются все старые места, потом рисуются новые: области могут пересекаться,
+    // поэтому перерисовывается и несдвинутая область, задетая стиранием
+    const LayoutRect *cleared[3];
+    int cleared_count = 0;
+    if (changed & ScreenLayout::REGION_TEXT)
+        cleared[cleared_count++] = &old_text;
+    if (changed & ScreenLayout::REGION_STATS)
+        cleared[cleared_count++] = &old_stats;
+    if (changed & ScreenLayout::REGION_KEYBOARD)
+        cleared[cleared_count++] = &old_keyboard;
+    for (int i = 0; i < cleared_count; ++i)
+        clearRect(*cleared[i]);
+
+    auto touched = [&](unsigned region, const LayoutRect &rect)
+    {
+        if (changed & region)
+            return true;
+        for (int i = 0; i < cleared_count; ++i)
+        {
+            if (intersects(*cleared[i], rect))
+                return true;
+        }
+        return false;
+    };
+    if (touched(ScreenLayout::REGION_TEXT, layout_.text()))
+        drawText();
+    if (touched(ScreenLayout::REGION_KEYBOARD, layout_.keyboard()))
+        keyboard_.draw(*keyboard_layout_, layout_.keyboard().top, layout_.keyboard().left,
+                       text_->chars[position_]);
+    if (touched(ScreenLayout::REGION_STATS, layout_.stats()))
+        displayRealtimeStats(now);
+    if (overlay_visible_ && latency_)
+    {
+        displayLatencyOverlay();
+    }
+}
+
+void TypingEngine::clearRect(const LayoutRect &rect)
+{
+    static const char SPACES[] = "                                                                ";
+    const int chunk = sizeof(SPACES) - 1;
+
+    // Часть, оставшаяся за краем нового экрана, уже не видна
+    int width = std::min(rect.width, layout_.width() - rect.left);
+    renderer_.resetColor();
+    for (int y = rect.top; y < rect.top + rect.height && y < layout_.height(); ++y)
+    {
+        renderer_.moveCursor(y, rect.left);
+        for (int x = 0; x < width; x += chunk)
+        {
+            renderer_.displayText(std::string_view(SPACES, std::min(chunk, width - x)));
+        }
+    }
+}
+
+void TypingEngine::displayRealtimeStats(Clock::time_point now)
+{
+    int typed = static_cast<int>(line_offset_ + position_);
+    double current_cpm = calculateCurrentCPM(typed, start_, now);
+    double accuracy = calculateAccuracy(errors_, typed > 0 ? typed : 1);
+
+    // Строка собирается в буфере на стеке: в цикле набора нет выделений памяти
+    LineBuffer<256> stats;
+    stats.append("Скорость: ").appendFixed(current_cpm, 1).append(" сим/мин | ")
+        .append("Точность: ").appendFixed(accuracy, 1).append("% | ")
+        .append("Ошибки: ").appendInt(errors_).append(" | ");
+    if (round_end_.active())
+    {
+        // В тесте на время вместо прогресса - оставшиеся секунды
+        auto left = std::chrono::ceil<std::chrono::seconds>(round_end_.deadline() - now).count();
+        stats.append("Осталось: ").appendInt(static_cast<int>(std::max<decltype(left)>(left, 0))).append(" с");
+    }
+    else
+    {
+        int progress = stream_ ? stream_->progress(streamPosition())
+                               : static_cast<int>((position_ * 100.0) / text_->length());
+        stats.append("Прогресс: ").appendInt(progress).append("%");
+    }
+
+    // Выводим новую статистику в последней строке экрана (строка очищается перед выводом)
+    renderer_.setColor(Renderer::COLOR_UNTYPED);
+    renderer_.displayTextCentered(stats.view(), layout_.stats().top - layout_.height() / 2);
+    renderer_.resetColor();
+}
+
+void TypingEngine::displayLatencyOverlay()
+{
+    // Таблица в левом верхнем углу: этап и его p50/p99/max в микросекундах
+    LineBuffer<64> line;
+    line.append("stage, us").padTo(10).append("p50").padTo(20).append("p99").padTo(30).append("max");
+
+    renderer_.setColor(Renderer::COLOR_UNTYPED);
+    renderer_.moveCursor(0, 0);
+    renderer_.displayText(line.view());
+    for (int stage = 0; stage < LatencyProfile::STAGE_COUNT; ++stage)
+    {
+        const LatencyHistogram &h = latency_->histogram(stage);
+        line.clear();
+        line.append(LatencyProfile::stageName(stage)).padTo(10)
+            .appendFixed(h.percentile(0.5) / 1000.0, 1).padTo(20)
+            .appendFixed(h.percentile(0.99) / 1000.0, 1).padTo(30)
+            .appendFixed(h.max() / 1000.0, 1).padTo(40);
+        renderer_.moveCursor(stage + 1, 0);
+        renderer_.displayText(line.view());
+    }
+    renderer_.resetColor();
+}
+
+void TypingEngine::clearLatencyOverlay()
+{
+    for (int y = 0; y <= LatencyProfile::STAGE_COUNT; ++y)
+    {
+        renderer_.clearLine(y);
+    }
+}
+
+double TypingEngine::calculateCurrentCPM(int chars, Clock::time_point start, Clock::time_point now)
+{
+    std::chrono::duration<double> duration = now - start;
+    double minutes = duration.count() / 60.0;
+    if (minutes < 0.0001)
+        return 0.0;
+    return chars / minutes;
+}
+
+double TypingEngine::calculateAccuracy(int errors, int totalChars)
+{
+    int limited_errors = std::min(errors, totalChars);
+    return 100.0 * (1.0 - static_cast<double>(limited_errors) / totalChars);
+}
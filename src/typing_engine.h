@@ -0,0 +1,151 @@
+#pragma once
+#include "renderer.h"
+#include "decoded_text.h"
+#include "keyboard_layout.h"
+#include "keyboard_widget.h"
+#include "keystroke_log.h"
+#include "event_timer.h"
+#include "latency_profile.h"
+#include "screen_layout.h"
+#include "line_source.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Логика одного раунда набора без привязки к терминалу: проверка нажатий, подсветка,
+// статистика в реальном времени и экранная клавиатура. Ввод приходит из InputSource,
+// вывод уходит в Renderer, поэтому раунд можно прогнать и без TTY
+class TypingEngine
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class RoundResult
+    {
+        Completed,
+        Aborted
+    };
+
+    // Строк в окне длинного текста и наибольшая ширина строки при переносе по словам
+    static constexpr int STREAM_LINES = 5;
+    static constexpr int STREAM_MAX_WIDTH = 72;
+
+    // log может быть nullptr - тогда нажатия не записываются, latency - тогда задержки не замеряются
+    TypingEngine(Renderer &renderer, KeystrokeLog *log, LatencyProfile *latency = nullptr);
+
+    // Начинает раунд с первого нажатия (оно же запускает отсчет времени) и рисует первый кадр
+    void begin(const DecodedText &text, const KeyboardLayout &layout, wint_t first_key, Clock::time_point start);
+    // Раунд длинного текста: строки источника идут через окно из STREAM_LINES строк, которое
+    // прокручивается за курсором. В памяти только строки окна; раунд заканчивается концом
+    // источника, ограничением времени или ESC
+    void begin(LineSource &source, const KeyboardLayout &layout, wint_t first_key, Clock::time_point start);
+    // Цикл событий до конца текста или выхода по ESC/Q (в длинном тексте Q - обычная буква)
+    RoundResult run(InputSource &input);
+
+    // Шаги цикла событий для внешнего цикла (например, epoll сервера).
+    // Нажатие: false - нажат выход, раунд прерван
+    bool handleInput(wint_t key, Clock::time_point when);
+    // Срабатывание таймеров без ввода
+    void handleTimeout(Clock::time_point now);
+    // Ближайший момент, когда нужно вызвать handleTimeout; false - таймеров нет
+    bool nextDeadline(Clock::time_point &deadline) const;
+    bool finished() const { return time_up_ || position_ >= text_->length(); }
+
+    // Ограничение времени раунда от первого нажатия (zero - без ограничения); действует
+    // на следующие begin. Нажатия после истечения не считаются, а длительность раунда равна limit
+    void setTimeLimit(Clock::duration limit) { time_limit_ = limit; }
+
+    int errors() const { return errors_; }
+    size_t position() const { return position_; }
+    // Набрано символов с начала раунда (в длинном тексте - по всем строкам)
+    uint64_t typedChars() const { return line_offset_ + position_; }
+    // Место курсора в источнике длинного текста
+    LineSource::Position streamPosition() const;
+    Clock::time_point startTime() const { return start_; }
+    Clock::time_point endTime() const { return end_; }
+
+    // Нажатия в цикле набора и выделения памяти при их обработке (при сборке с ALLOC_COUNT=1)
+    uint64_t keystrokeCount() const { return keystroke_count_; }
+    uint64_t keystrokeAllocations() const { return keystroke_allocations_; }
+
+    // Задержки по этапам (nullptr, если замер выключен)
+    const LatencyProfile *latency() const { return latency_; }
+    // Оверлей с p50/p99/max задержек в верхних строках экрана; переключается F2
+    void setLatencyOverlay(bool visible) { overlay_visible_ = visible; }
+
+    static double calculateCurrentCPM(int chars, Clock::time_point start, Clock::time_point now);
+    static double calculateAccuracy(int errors, int totalChars);
+
+private:
+    void startRound(const KeyboardLayout &layout, int text_width, int text_height, wint_t first_key,
+                    Clock::time_point start);
+    // false - нажат выход
+    bool handleKey(wint_t input, Clock::time_point when);
+    void handleTimers(Clock::time_point now);
+    // Время раунда вышло к моменту now: раунд завершается на границе ограничения
+    bool timeUp(Clock::time_point now);
+    void drawChar(size_t pos, int color);
+    // Текст целиком в цветах текущего состояния раунда
+    void drawText();
+    // Строка текста: первые typed символов набраны; остаток строки экрана до ширины текста стирается
+    void drawLine(const DecodedText &line, int row, size_t typed);
+
+    // Длинный текст: ширина переноса для ширины экрана
+    static int streamWidth(int screen_width);
+    // Переносит следующую строку документа в кольцо окна; false - документ кончился
+    bool loadLine();
+    // Курсор на следующую строку, окно прокручивается; false - строк больше нет
+    bool nextLine();
+    // Перенос строк окна под новую ширину; курсор остается на том же символе документа
+    void rewrap(int width);
+    // Новый размер экрана: сдвинувшиеся области стираются на старом месте и рисуются на новом
+    void relayout(Clock::time_point now);
+    void clearRect(const LayoutRect &rect);
+    void displayRealtimeStats(Clock::time_point now);
+    void mark(int stage)
+    {
+        if (latency_)
+            latency_->mark(key_timer_, stage);
+    }
+    void displayLatencyOverlay();
+    void clearLatencyOverlay();
+
+    Renderer &renderer_;
+    KeystrokeLog *log_;
+    KeyboardWidget keyboard_;
+
+    // Текущая строка: весь текст раунда или строка курсора из кольца окна
+    const DecodedText *text_ = nullptr;
+    const KeyboardLayout *keyboard_layout_ = nullptr;
+    ScreenLayout layout_;
+    size_t position_ = 0;
+    int errors_ = 0;
+    Clock::time_point start_{};
+    Clock::time_point end_{};
+
+    // Окно длинного текста: строка k документа лежит в lines_[k % STREAM_LINES]
+    LineSource *stream_ = nullptr;
+    std::vector<DecodedText> lines_;
+    std::vector<uint64_t> line_starts_;             // символов документа до строки
+    std::vector<LineSource::Position> line_marks_;  // начало строки в источнике
+    uint64_t loaded_ = 0;        // строк уже перенесено
+    uint64_t next_start_ = 0;    // символов до следующей переносимой строки
+    uint64_t line_ = 0;          // строка курсора
+    uint64_t first_visible_ = 0; // верхняя строка окна
+    uint64_t line_offset_ = 0;   // символов до строки курсора
+    int wrap_width_ = 0;
+
+    EventTimer error_flash_;
+    EventTimer stats_refresh_;
+    EventTimer overlay_refresh_;
+    EventTimer round_end_;
+    Clock::duration time_limit_{};
+    bool time_up_ = false;
+
+    LatencyProfile *latency_;
+    LatencyProfile::KeyTimer key_timer_;
+    bool overlay_visible_ = false;
+
+    uint64_t keystroke_count_ = 0;
+    uint64_t keystroke_allocations_ = 0;
+};
@@ -0,0 +1,354 @@
+#include "typing_server.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // Размер терминала, если клиент не прислал свой
+    const int DEFAULT_ROWS = 24;
+    const int DEFAULT_COLS = 80;
+
+    std::runtime_error systemError(const std::string &what)
+    {
+        return std::runtime_error(what + ": " + std::strerror(errno));
+    }
+
+    // Имя пользователя на другом конце сокета по его uid (подделать нельзя)
+    std::string peerUser(int fd)
+    {
+        ucred cred{};
+        socklen_t length = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0)
+            return std::string();
+
+        passwd pw;
+        passwd *result = nullptr;
+        char buffer[1024];
+        if (getpwuid_r(cred.uid, &pw, buffer, sizeof(buffer), &result) != 0 || !result)
+            return std::to_string(cred.uid);
+        return pw.pw_name;
+    }
+}
+
+TypingServer::TypingServer(const std::string &socket_path, const std::string &data_dir)
+    : socket_path_(socket_path)
+{
+    loadCorpora(data_dir);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+        throw systemError("Не удалось создать сокет");
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Слишком длинный путь сокета " + socket_path);
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    // Сокет от прошлого запуска мешает bind
+    unlink(socket_path.c_str());
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        throw systemError("Не удалось открыть сокет " + socket_path);
+    // Подключаться могут все пользователи машины
+    chmod(socket_path.c_str(), 0666);
+    if (listen(listen_fd_, SOMAXCONN) != 0)
+        throw systemError("Не удалось открыть сокет " + socket_path);
+
+    // SIGINT/SIGTERM приходят в цикл событий через signalfd, чтобы сервер завершался штатно
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    signal(SIGPIPE, SIG_IGN);
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0 || signal_fd_ < 0)
+        throw systemError("Не удалось запустить цикл событий");
+    watch(listen_fd_, EPOLLIN, EPOLL_CTL_ADD);
+    watch(signal_fd_, EPOLLIN, EPOLL_CTL_ADD);
+}
+
+TypingServer::~TypingServer()
+{
+    while (!clients_.empty())
+    {
+        closeClient(*clients_.begin()->second);
+    }
+    if (listen_fd_ >= 0)
+    {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+    }
+    if (signal_fd_ >= 0)
+        close(signal_fd_);
+    if (epoll_fd_ >= 0)
+        close(epoll_fd_);
+}
+
+void TypingServer::loadCorpora(const std::string &data_dir)
+{
+    // Каждый корпус загружается один раз: файл отображается в память, индекс строк берется из кэша
+    for (const auto &entry : std::filesystem::directory_iterator(data_dir))
+    {
+        if (entry.path().extension() != ".txt")
+            continue;
+
+        std::string language = entry.path().stem().string();
+        corpora_[language] = std::make_unique<TextProvider>(entry.path().string());
+        layouts_[language] = KeyboardLayout::load(language);
+    }
+
+    if (corpora_.empty())
+    {
+        throw std::runtime_error("No text files found in data directory");
+    }
+}
+
+void TypingServer::watch(int fd, uint32_t events, int op)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd_, op, fd, &event);
+}
+
+void TypingServer::run()
+{
+    epoll_event events[64];
+    while (true)
+    {
+        int count = epoll_wait(epoll_fd_, events, 64, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw systemError("Ошибка цикла событий");
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_)
+            {
+                acceptClients();
+            }
+            else if (fd == signal_fd_)
+            {
+                return;
+            }
+            else if (auto timer = timers_.find(fd); timer != timers_.end())
+            {
+                handleTimer(*timer->second);
+            }
+            else if (auto client = clients_.find(fd); client != clients_.end())
+            {
+                // Клиент мог быть отключен раньше в этой же пачке событий - тогда его здесь уже нет
+                handleClient(*client->second, events[i].events);
+            }
+        }
+    }
+}
+
+void TypingServer::acceptClients()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        auto client = std::make_unique<Client>();
+        client->fd = fd;
+        client->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        client->user = peerUser(fd);
+        if (client->timer_fd < 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(client->timer_fd, EPOLLIN, EPOLL_CTL_ADD);
+        timers_[client->timer_fd] = client.get();
+        clients_[fd] = std::move(client);
+        clients_served_++;
+    }
+}
+
+void TypingServer::handleClient(Client &client, uint32_t events)
+{
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+    {
+        char buffer[4096];
+        while (true)
+        {
+            ssize_t n = read(client.fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EAGAIN)
+                break;
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                closeClient(client);
+                return;
+            }
+
+            auto now = RemoteSession::Clock::now();
+            size_t used = 0;
+            if (!client.session && !readHello(client, buffer, n, used))
+            {
+                closeClient(client);
+                return;
+            }
+            if (client.session && used < static_cast<size_t>(n) &&
+                !client.session->onInput(buffer + used, n - used, now))
+            {
+                // Последний кадр отправляем, если получится, и отключаемся
+                flushClient(client);
+                closeClient(client);
+                return;
+            }
+        }
+    }
+
+    if (!flushClient(client))
+    {
+        closeClient(client);
+    }
+}
+
+void TypingServer::handleTimer(Client &client)
+{
+    uint64_t expirations;
+    if (read(client.timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+
+    if (client.session && !client.session->onTimeout(RemoteSession::Clock::now()))
+    {
+        flushClient(client);
+        closeClient(client);
+        return;
+    }
+    if (!flushClient(client))
+    {
+        closeClient(client);
+    }
+}
+
+bool TypingServer::readHello(Client &client, const char *data, size_t size, size_t &used)
+{
+    used = std::min(size, sizeof(ServerHello) - client.hello_size);
+    std::memcpy(reinterpret_cast<char *>(&client.hello) + client.hello_size, data, used);
+    client.hello_size += used;
+    if (client.hello_size < sizeof(ServerHello))
+        return true;
+
+    const ServerHello &hello = client.hello;
+    if (std::memcmp(hello.magic, "TSRV", 4) != 0 || hello.version != SERVER_PROTOCOL_VERSION)
+        return false;
+
+    std::string language(hello.language, strnlen(hello.language, sizeof(hello.language)));
+    auto corpus = corpora_.find(language);
+    if (corpus == corpora_.end())
+        corpus = corpora_.begin();
+    language = corpus->first;
+
+    // Результаты каждого пользователя хранятся отдельно: stats/<пользователь>_<язык>_*
+    StatsHistory *history = nullptr;
+    if (!(hello.flags & SERVER_HELLO_NO_STATS))
+    {
+        std::string stats_key = client.user.empty() ? language : client.user + "_" + language;
+        auto &entry = histories_[stats_key];
+        if (!entry)
+        {
+            // Поврежденная история не должна останавливать сервер: отключаем только этого клиента
+            try
+            {
+                entry = std::make_unique<StatsHistory>(stats_key);
+            }
+            catch (const std::exception &)
+            {
+                histories_.erase(stats_key);
+                return false;
+            }
+        }
+        history = entry.get();
+    }
+
+    int rows = hello.rows > 0 ? hello.rows : DEFAULT_ROWS;
+    int cols = hello.cols > 0 ? hello.cols : DEFAULT_COLS;
+    client.session = std::make_unique<RemoteSession>(*corpus->second, layouts_[language].get(), history,
+                                                     rows, cols, &latency_);
+    client.session->start();
+    return true;
+}
+
+bool TypingServer::flushClient(Client &client)
+{
+    if (!client.session)
+        return true;
+
+    std::string_view output = client.session->output();
+    size_t sent = 0;
+    while (sent < output.size())
+    {
+        ssize_t n = send(client.fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            break;
+        if (n < 0)
+            return false;
+        sent += n;
+    }
+    client.session->consumeOutput(sent);
+
+    size_t pending = output.size() - sent;
+    if (pending > MAX_PENDING_OUTPUT)
+        return false;
+
+    // Остаток отправится, когда сокет освободится
+    bool want_write = pending > 0;
+    if (want_write != client.want_write)
+    {
+        watch(client.fd, want_write ? EPOLLIN | EPOLLOUT : EPOLLIN, EPOLL_CTL_MOD);
+        client.want_write = want_write;
+    }
+
+    // Таймер клиента взводится на ближайший срок его движка (steady_clock - это CLOCK_MONOTONIC)
+    itimerspec spec{};
+    RemoteSession::Clock::time_point deadline;
+    if (client.session->nextDeadline(deadline))
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        if (ns <= 0)
+            ns = 1;
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+    }
+    timerfd_settime(client.timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    return true;
+}
+
+void TypingServer::closeClient(Client &client)
+{
+    int fd = client.fd;
+    timers_.erase(client.timer_fd);
+    close(client.timer_fd);
+    close(fd);
+    clients_.erase(fd);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "remote_session.h"
+#include "server_protocol.h"
+#include "text_provider.h"
+#include "keyboard_layout.h"
+#include "latency_profile.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Сервер для многих пользователей в одном процессе: принимает клиентов на Unix-сокете
+// и ведет все их сессии в одном цикле epoll. Корпуса текстов (отображенные в память файлы
+// с индексом) и раскладки загружаются один раз и общие для всех; на клиента приходятся
+// только его сессия, буфер вывода и таймер
+class TypingServer
+{
+public:
+    // Клиент, который не успевает забирать вывод, отключается
+    static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+    TypingServer(const std::string &socket_path, const std::string &data_dir = "data");
+    ~TypingServer();
+
+    TypingServer(const TypingServer &) = delete;
+    TypingServer &operator=(const TypingServer &) = delete;
+
+    // Цикл событий до SIGINT/SIGTERM
+    void run();
+
+    const LatencyProfile &getLatency() const { return latency_; }
+    uint64_t getClientsServed() const { return clients_served_; }
+
+private:
+    struct Client
+    {
+        int fd = -1;
+        int timer_fd = -1;
+        std::string user;
+        // Пока не пришел ServerHello целиком, сессии нет
+        ServerHello hello{};
+        size_t hello_size = 0;
+        std::unique_ptr<RemoteSession> session;
+        bool want_write = false;
+    };
+
+    void loadCorpora(const std::string &data_dir);
+    void acceptClients();
+    void handleClient(Client &client, uint32_t events);
+    void handleTimer(Client &client);
+    bool readHello(Client &client, const char *data, size_t size, size_t &used);
+    // Отправляет накопленный вывод и перезаводит таймер; false - клиента нужно отключить
+    bool flushClient(Client &client);
+    void closeClient(Client &client);
+    void watch(int fd, uint32_t events, int op);
+
+    std::string socket_path_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int signal_fd_ = -1;
+
+    std::map<std::string, std::unique_ptr<TextProvider>> corpora_;
+    std::map<std::string, std::unique_ptr<KeyboardLayout>> layouts_;
+    // Истории результатов пользователей загружаются при первом подключении и живут до выхода
+    std::map<std::string, std::unique_ptr<StatsHistory>> histories_;
+    LatencyProfile latency_;
+
+    // Клиенты по дескриптору сокета и по дескриптору таймера
+    std::unordered_map<int, std::unique_ptr<Client>> clients_;
+    std::unordered_map<int, Client *> timers_;
+    uint64_t clients_served_ = 0;
+};
@@ -1,30 +1,45 @@
 #include "typing_session.h"
-#include <iostream>
-#include <thread>
+#include <algorithm>
 #include <chrono>
 #include <vector>
 #include <string>
 #include "stats_saver.h"
 #include "stats_analyzer.h"
+#include "startup_profile.h"
 
-TypingSession::TypingSession(TextProvider &provider, ConsoleHandler &console, const std::string &language)
-    : textProvider_(provider), console_(console), language_(language) {}
+namespace
+{
+    // Сколько лучших текстов чередуется в тренировке n-грамм
+    const size_t DRILL_TEXTS = 32;
+    // Сколько самых слабых единиц ищется в текстах и из скольких лучших текстов выбирается
+    const size_t WEAK_UNITS = 6;
+    const size_t ADAPTIVE_TEXTS = 16;
+    // Каждый такой раунд текст случайный, чтобы модель видела и остальные символы
+    const size_t ADAPTIVE_EXPLORE = 4;
+    // Сколько последних текстов полосы сложности не повторяется
+    const size_t RECENT_TEXTS = 50;
+    // Ширина первой строки теста на время на экране начала
+    const int PREVIEW_WIDTH = 60;
+}
+
+TypingSession::TypingSession(TextProvider &provider, ConsoleHandler &console, const std::string &language,
+                             const KeyboardLayout *layout)
+    : textProvider_(provider), console_(console), language_(language), layout_(layout), history_(language),
+      stream_(provider), weakness_(language), keystrokeLog_(language), engine_(console, &keystrokeLog_, &latency_),
+      gen_(std::random_device{}())
+{
+    keystrokeLog_.setModel(&weakness_);
+    StartupProfile::shared().mark("история и модель слабых мест");
+}
 
 void TypingSession::start()
 {
     while (true)
     {
-        text_ = textProvider_.getRandomText();
-        std::wstring wtext;
-
-        // Конвертируем текст в wide string один раз
-        wchar_t *wstr = new wchar_t[text_.length() * 4 + 1];
-        size_t len = mbstowcs(wstr, text_.c_str(), text_.length() * 4);
-        if (len != static_cast<size_t>(-1))
-        {
-            wtext = std::wstring(wstr, len);
-        }
-        delete[] wstr;
+        // Текст приходит уже разобранным: коды символов, ширины и колонки.
+        // В длинном тексте это первый абзац документа - для экрана начала и выбора раскладки
+        nextText();
+        const std::wstring &wtext = text_.chars;
 
         if (wtext.empty())
         {
@@ -32,129 +47,77 @@ void TypingSession::start()
             return;
         }
 
-        int errors = 0;
-        int totalChars = wtext.length();
+        drawStartScreen();
+        StartupProfile::shared().mark("первый текст на экране");
 
-        console_.clearScreen();
-        console_.displayTextCentered("=== Typing Trainer ===", -5);
-        console_.displayTextCentered(text_, 0);
-        console_.displayTextCentered("Нажмите любую клавишу для начала или ESC для выхода...", 5);
+        // Если раскладка не задана явно, определяем ее по первой букве текста
+        const KeyboardLayout &layout = layout_ ? *layout_ : KeyboardLayout::forText(wtext);
 
-        // Определяем начальную раскладку по первой букве текста
-        bool is_russian = false;
-        for (wchar_t c : wtext)
+        wint_t ch = console_.getChar();
+        while (ch == InputSource::KEY_SCREEN_RESIZE)
         {
-            if (isRussianLetter(c))
-            {
-                is_russian = true;
-                break;
-            }
-            else if (isEnglishLetter(c))
-            {
-                is_russian = false;
-                break;
-            }
+            drawStartScreen();
+            ch = console_.getChar();
         }
-
-        wint_t ch = console_.getChar();
         if (ch == 27 || ch == 'q' || ch == 'Q')
         {
             break;
         }
 
-        console_.clearScreen();
-        auto startTime = std::chrono::steady_clock::now();
-        size_t currentPos = 0;
-
-        // Получаем размеры экрана и вычисляем позицию текста
-        auto [height, width] = console_.getScreenSize();
-        int text_y = height / 2;
-        int text_x = (width - wtext.length()) / 2;
-
-        // Проверяем, была ли первая буква правильной
-        if (static_cast<wchar_t>(ch) == wtext[0])
+        // Сам раунд ведет движок: ввод и отрисовка идут через консоль
+        bool streamed = longText_ || timedSeconds_ > 0;
+        LineSource &source = timedSeconds_ > 0 ? static_cast<LineSource &>(*wordStream_) : stream_;
+        if (streamed)
         {
-            console_.moveCursor(text_y, text_x);
-            console_.setColor(ConsoleHandler::COLOR_TYPED);
-            console_.displayText(wcharToUtf8(wtext[0]));
-            currentPos = 1;
+            engine_.begin(source, layout, ch, std::chrono::steady_clock::now());
         }
-
-        // Отображаем текст и клавиатуру после начала
-        console_.moveCursor(text_y, text_x + currentPos);
-        console_.setColor(ConsoleHandler::COLOR_UNTYPED);
-        console_.displayText(text_.substr(currentPos));
-        displayKeyboard(wtext[currentPos], is_russian);
-
-        while (currentPos < wtext.length())
+        else
         {
-            console_.moveCursor(text_y, text_x + currentPos);
-            console_.setColor(ConsoleHandler::COLOR_CURRENT);
-
-            // Получаем текущий символ как wide char
-            wchar_t current_wchar = wtext[currentPos];
-            std::string current_char = wcharToUtf8(current_wchar);
-            console_.displayText(current_char);
-
-            wint_t input = console_.getChar();
-
-            // Проверяем специальные клавиши
-            if (input == static_cast<wint_t>(27) || // ESC
-                input == static_cast<wint_t>('q') ||
-                input == static_cast<wint_t>('Q'))
-            {
-                return;
-            }
-
-            // Сравниваем символы с приведением типов
-            if (static_cast<wchar_t>(input) == current_wchar)
-            {
-                // При правильном вводе
-                console_.moveCursor(text_y, text_x + currentPos);
-                console_.setColor(ConsoleHandler::COLOR_TYPED);
-                console_.displayText(current_char);
-                currentPos++;
-
-                // Подсвечиваем следующий символ
-                if (currentPos < wtext.length())
-                {
-                    console_.moveCursor(text_y, text_x + currentPos);
-                    console_.setColor(ConsoleHandler::COLOR_CURRENT);
-                    console_.displayText(wcharToUtf8(wtext[currentPos]));
-                }
-            }
-            else
-            {
-                // При ошибке подсвечиваем текущий символ красным
-                console_.moveCursor(text_y, text_x + currentPos);
-                console_.setColor(ConsoleHandler::COLOR_ERROR);
-                console_.displayText(current_char);
-
-                // Небольшая пауза для отображения ошибки
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-                // Возвращаем подсветку текущего символа
-                console_.moveCursor(text_y, text_x + currentPos);
-                console_.setColor(ConsoleHandler::COLOR_CURRENT);
-                console_.displayText(current_char);
-
-                errors++;
-            }
-
-            displayRealtimeStats(errors, totalChars, startTime, currentPos);
-            displayKeyboard(wtext[currentPos], is_russian);
+            engine_.begin(text_, layout, ch, std::chrono::steady_clock::now());
+        }
+        TypingEngine::RoundResult result = engine_.run(console_);
+        // Длинный текст по ESC заканчивается с результатом, если что-то набрано,
+        // тест на время и обычный раунд - только если не прерваны
+        bool discard;
+        if (longText_ && timedSeconds_ == 0)
+            discard = engine_.typedChars() == 0;
+        else
+            discard = result == TypingEngine::RoundResult::Aborted;
+        if (discard)
+        {
+            weakness_.save();
+            return;
         }
 
-        auto endTime = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(endTime - startTime);
-
-        displayStats(errors, totalChars, duration);
+        int totalChars = static_cast<int>(engine_.typedChars());
+        std::chrono::duration<double> duration = engine_.endTime() - engine_.startTime();
 
-        console_.displayTextCentered("Нажмите ENTER для продолжения или ESC/Q для выхода...", 5);
+        // В историю идет только набранная часть документа или потока слов
+        if (streamed)
+        {
+            source.copy(engine_.streamPosition(), typedText_);
+        }
+        StatsHistory &history = timedSeconds_ > 0 ? *timedHistory_ : history_;
+        saveResults(history, streamed ? typedText_ : text_.utf8, engine_.errors(), totalChars, duration,
+                    keystrokeLog_.sessionId());
+        HistoryChart::View view;
+        console_.beginFrame();
+        displayResults(console_, &history, engine_.errors(), totalChars, duration, &view);
+        console_.commitFrame();
+
+        // Модель слабых мест пишется, когда экран результатов уже показан
+        weakness_.save();
         wint_t choice;
         do
         {
             choice = console_.getChar();
+            if (choice == InputSource::KEY_SCREEN_RESIZE || view.handleKey(choice))
+            {
+                // Экран результатов статичный: перестраивается целиком под новый размер или окно графика
+                console_.beginFrame();
+                displayResults(console_, &history, engine_.errors(), totalChars, duration, &view);
+                console_.commitFrame();
+            }
         } while (choice != '\n' && choice != 27 && choice != 'q' && choice != 'Q');
 
         if (choice == 27)
@@ -164,214 +127,218 @@ void TypingSession::start()
     }
 }
 
-void TypingSession::displayRealtimeStats(int errors, int totalChars,
-                                         std::chrono::steady_clock::time_point startTime,
-                                         size_t currentPos)
+void TypingSession::drawStartScreen()
 {
-    auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - startTime);
-
-    double current_cpm = calculateCurrentCPM(currentPos, startTime);
-    double accuracy = calculateAccuracy(errors, currentPos > 0 ? currentPos : 1);
-    int progress = static_cast<int>((currentPos * 100.0) / totalChars);
+    console_.beginFrame();
+    console_.clearScreen();
+    console_.displayTextCentered("=== Typing Trainer ===", -5);
+    if (timedSeconds_ > 0)
+    {
+        // Первая строка потока слов: с нее начнется тест
+        console_.displayTextCentered("Тест на " + std::to_string(timedSeconds_) +
+                                         " с, время пойдет с первого нажатия",
+                                     -2);
+        console_.displayTextCentered(text_, 0);
+    }
+    else if (longText_)
+    {
+        // Абзац может не поместиться в строку: показывается только место в корпусе
+        console_.displayTextCentered("Длинный текст с абзаца " + std::to_string(stream_.firstLine() + 1) + " из " +
+                                         std::to_string(textProvider_.size()) + ", конец набора - ESC",
+                                     0);
+    }
+    else
+    {
+        console_.displayTextCentered(text_, 0);
+    }
+    console_.displayTextCentered("Нажмите любую клавишу для начала или ESC для выхода...", 5);
+    console_.commitFrame();
+}
 
-    std::string stats =
-        "Скорость: " + std::to_string(current_cpm).substr(0, std::to_string(current_cpm).find(".") + 2) + " сим/мин | " +
-        "Точность: " + std::to_string(accuracy).substr(0, std::to_string(accuracy).find(".") + 2) + "% | " +
-        "Ошибки: " + std::to_string(errors) + " | " +
-        "Прогресс: " + std::to_string(progress) + "%";
+void TypingSession::setDrill(const NgramIndex *index, std::vector<uint64_t> keys,
+                             uint32_t min_length, uint32_t max_length)
+{
+    drillIndex_ = index;
+    drillKeys_ = std::move(keys);
+    drillMinLength_ = min_length;
+    drillMaxLength_ = max_length;
+    drillRound_ = 0;
+    if (drillIndex_)
+    {
+        drillIndex_->find(drillKeys_.data(), drillKeys_.size(), drillMinLength_, drillMaxLength_,
+                          DRILL_TEXTS, drillMatches_);
+    }
+}
 
-    auto [height, width] = console_.getScreenSize();
-    int stats_y = height - 6;
+void TypingSession::setDifficulty(const DifficultyIndex *index, int band)
+{
+    difficultyIndex_ = index;
+    difficultyBand_ = band;
+    recentTexts_.clear();
+    recentNext_ = 0;
+}
 
-    // Очищаем всю строку перед выводом новой статистики
-    console_.moveCursor(stats_y, 0);
-    console_.setColor(ConsoleHandler::COLOR_UNTYPED);
-    console_.displayText(std::string(width, ' '));
+void TypingSession::setAdaptive(const NgramIndex *index, uint32_t min_length, uint32_t max_length)
+{
+    adaptiveIndex_ = index;
+    adaptiveMinLength_ = min_length;
+    adaptiveMaxLength_ = max_length;
+    adaptiveRound_ = 0;
+}
 
-    // Выводим новую статистику
-    console_.displayTextCentered(stats, height - 6);
-    console_.resetColor();
+void TypingSession::setTimed(int seconds)
+{
+    timedSeconds_ = seconds;
+    engine_.setTimeLimit(std::chrono::seconds(seconds));
+    if (seconds <= 0)
+    {
+        return;
+    }
+    // Частотный список и таблица псевдонимов строятся один раз на язык
+    if (!words_)
+    {
+        words_ = std::make_unique<WordSampler>(textProvider_, language_);
+        wordStream_ = std::make_unique<WordStream>(*words_);
+        StartupProfile::shared().mark("частотный список слов");
+    }
+    timedHistory_ = std::make_unique<StatsHistory>(StatsSaver::modeKey(language_, "time" + std::to_string(seconds)));
 }
 
-void TypingSession::displayErrorChar(int y, int x, char expected)
+void TypingSession::nextText()
 {
-    console_.moveCursor(y, x);
-    console_.setColor(ConsoleHandler::COLOR_ERROR);
-    console_.displayText(std::string(1, expected), false);
-    console_.resetColor();
+    if (timedSeconds_ > 0)
+    {
+        // Новый поток слов; его первая строка - для экрана начала и выбора раскладки
+        wordStream_->reset(static_cast<uint64_t>(gen_()) << 32 ^ gen_());
+        wordStream_->nextLine(PREVIEW_WIDTH, text_);
+        wordStream_->seek(LineSource::Position());
+        return;
+    }
+    if (longText_)
+    {
+        std::uniform_int_distribution<size_t> pick(0, textProvider_.size() - 1);
+        stream_.reset(pick(gen_));
+        textProvider_.getText(stream_.firstLine(), text_);
+        return;
+    }
+    if (!drillMatches_.empty())
+    {
+        const NgramIndex::Match &match = drillMatches_[drillRound_++ % drillMatches_.size()];
+        textProvider_.getText(match.text, text_);
+        return;
+    }
+    if (difficultyIndex_)
+    {
+        uint32_t text = difficultyIndex_->pick(difficultyBand_, static_cast<uint64_t>(gen_()) << 32 ^ gen_(), recentTexts_);
+        if (recentTexts_.size() < RECENT_TEXTS)
+        {
+            recentTexts_.push_back(text);
+        }
+        else
+        {
+            recentTexts_[recentNext_++ % RECENT_TEXTS] = text;
+        }
+        textProvider_.getText(text, text_);
+        return;
+    }
+    if (adaptiveIndex_ && ++adaptiveRound_ % ADAPTIVE_EXPLORE != 0 && nextWeakText())
+    {
+        return;
+    }
+    // Без подходящих текстов тренировка сводится к случайному выбору
+    textProvider_.getRandomText(text_);
+    lastText_ = UINT32_MAX;
 }
 
-double TypingSession::calculateCurrentCPM(int chars, const std::chrono::steady_clock::time_point &startTime)
+bool TypingSession::nextWeakText()
 {
-    auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - startTime);
-    double minutes = duration.count() / 60.0;
-    if (minutes < 0.0001)
-        return 0.0;
-    return chars / minutes;
+    weakness_.weakest(WEAK_UNITS, weakUnits_);
+    if (weakUnits_.empty())
+    {
+        return false;
+    }
+    weakKeys_.clear();
+    for (const auto &unit : weakUnits_)
+    {
+        weakKeys_.push_back(unit.key);
+    }
+    adaptiveIndex_->find(weakKeys_.data(), weakKeys_.size(), adaptiveMinLength_, adaptiveMaxLength_,
+                         ADAPTIVE_TEXTS, adaptiveMatches_);
+
+    // Только что набранный текст не повторяется, из остальных лучших - случайный
+    adaptiveMatches_.erase(std::remove_if(adaptiveMatches_.begin(), adaptiveMatches_.end(),
+                                          [this](const NgramIndex::Match &match)
+                                          { return match.text == lastText_; }),
+                           adaptiveMatches_.end());
+    if (adaptiveMatches_.empty())
+    {
+        return false;
+    }
+    std::uniform_int_distribution<size_t> pick(0, adaptiveMatches_.size() - 1);
+    lastText_ = adaptiveMatches_[pick(gen_)].text;
+    textProvider_.getText(lastText_, text_);
+    return true;
 }
 
-void TypingSession::displayStats(int errors, int totalChars, std::chrono::seconds duration)
+void TypingSession::saveResults(StatsHistory &history, const std::string &text, int errors, int totalChars,
+                                std::chrono::duration<double> duration, uint64_t session_id)
 {
-    double cpm = calculateCPM(totalChars, duration);
-    double accuracy = calculateAccuracy(errors, totalChars);
-    
-    // Сохраняем результаты (только здесь!)
-    StatsSaver stats_saver;
+    StatsSaver stats_saver(history);
     stats_saver.saveResult(
-        language_,
-        cpm,
-        accuracy,
+        calculateCPM(totalChars, duration),
+        TypingEngine::calculateAccuracy(errors, totalChars),
         errors,
         totalChars,
         duration,
-        text_
+        text,
+        session_id
     );
+}
+
+void TypingSession::displayResults(Renderer &console, const StatsHistory *history,
+                                   int errors, int totalChars, std::chrono::duration<double> duration,
+                                   HistoryChart::View *view)
+{
+    double cpm = calculateCPM(totalChars, duration);
+    double accuracy = TypingEngine::calculateAccuracy(errors, totalChars);
+    
+    if (history)
+    {
+        // История и сравнительная статистика вместе с текущим результатом
+        StatsAnalyzer analyzer(console);
+        analyzer.displayStats(
+            *history,
+            cpm,
+            accuracy,
+            errors,
+            totalChars,
+            duration,
+            view
+        );
+        return;
+    }
     
     // Показываем текущую статистику
-    console_.clearScreen();
+    console.clearScreen();
     std::vector<std::string> stats = {
         "Результаты:",
         "Скорость: " + std::to_string(static_cast<int>(cpm)) + " символов в минуту",
         "Точность: " + std::to_string(static_cast<int>(accuracy)) + "%",
         "Ошибки: " + std::to_string(errors),
-        "Время: " + std::to_string(duration.count()) + " секунд"
+        "Время: " + std::to_string(static_cast<int>(duration.count())) + " секунд"
     };
     
-    int startY = -15;  // Увеличиваем отступ сверху
+    int startY = -static_cast<int>(stats.size()) / 2 - 1;
     for (const auto& line : stats) {
-        console_.displayTextCentered(line, startY++);
+        console.displayTextCentered(line, startY++);
     }
-    
-    // Отображаем историю и сравнительную статистику
-    StatsAnalyzer analyzer(console_);
-    analyzer.displayStats(
-        language_,
-        cpm,
-        accuracy,
-        errors,
-        totalChars,
-        duration
-    );
+    console.displayTextCentered(StatsAnalyzer::RESULTS_PROMPT, startY + 1);
 }
 
-double TypingSession::calculateCPM(int totalChars, std::chrono::seconds duration)
+double TypingSession::calculateCPM(int totalChars, std::chrono::duration<double> duration)
 {
     double minutes = duration.count() / 60.0;
     if (minutes < 0.0001)
         return 0.0;
     return totalChars / minutes;
 }
-
-double TypingSession::calculateAccuracy(int errors, int totalChars)
-{
-    int limited_errors = std::min(errors, totalChars);
-    return 100.0 * (1.0 - static_cast<double>(limited_errors) / totalChars);
-}
-
-// Добавляем вспомогательную функцию для конвертации wchar_t в UTF-8 string
-std::string TypingSession::wcharToUtf8(wchar_t wc)
-{
-    char buf[MB_CUR_MAX + 1];
-    int len = wctomb(buf, wc);
-    if (len > 0)
-    {
-        return std::string(buf, len);
-    }
-    return std::string(1, '?');
-}
-
-// Добавляем вспомогательные функции для определения типа символа
-bool TypingSession::isRussianLetter(wchar_t c)
-{
-    return (c >= L'А' && c <= L'я') || c == L'Ё' || c == L'ё';
-}
-
-bool TypingSession::isEnglishLetter(wchar_t c)
-{
-    return (c >= L'A' && c <= L'Z') || (c >= L'a' && c <= L'z');
-}
-
-void TypingSession::displayKeyboard(wchar_t currentChar, bool is_russian)
-{
-    // Определяем раскладки с фиксированными позициями
-    const std::vector<std::pair<std::string, int>> ru_row1 = {
-        {"Й", 3}, {"Ц", 6}, {"У", 9}, {"К", 12}, {"Е", 15}, {"Н", 18}, {"Г", 21}, {"Ш", 24}, {"Щ", 27}, {"З", 30}, {"Х", 33}, {"Ъ", 36}};
-    const std::vector<std::pair<std::string, int>> ru_row2 = {
-        {"Ф", 5}, {"Ы", 8}, {"В", 11}, {"А", 14}, {"П", 17}, {"Р", 20}, {"О", 23}, {"Л", 26}, {"Д", 29}, {"Ж", 32}, {"Э", 35}};
-    const std::vector<std::pair<std::string, int>> ru_row3 = {
-        {"Я", 7}, {"Ч", 10}, {"С", 13}, {"М", 16}, {"И", 19}, {"Т", 22}, {"Ь", 25}, {"Б", 28}, {"Ю", 31}, {".", 34}};
-
-    const std::vector<std::pair<std::string, int>> en_row1 = {
-        {"Q", 3}, {"W", 6}, {"E", 9}, {"R", 12}, {"T", 15}, {"Y", 18}, {"U", 21}, {"I", 24}, {"O", 27}, {"P", 30}, {"[", 33}, {"]", 36}};
-    const std::vector<std::pair<std::string, int>> en_row2 = {
-        {"A", 5}, {"S", 8}, {"D", 11}, {"F", 14}, {"G", 17}, {"H", 20}, {"J", 23}, {"K", 26}, {"L", 29}, {";", 32}, {"'", 35}};
-    const std::vector<std::pair<std::string, int>> en_row3 = {
-        {"Z", 7}, {"X", 10}, {"C", 13}, {"V", 16}, {"B", 19}, {"N", 22}, {"M", 25}, {",", 28}, {".", 31}, {"/", 34}};
-
-    auto &row1 = is_russian ? ru_row1 : en_row1;
-    auto &row2 = is_russian ? ru_row2 : en_row2;
-    auto &row3 = is_russian ? ru_row3 : en_row3;
-
-    // Получаем позицию для отображения клавиатуры
-    auto [height, width] = console_.getScreenSize();
-    int keyboard_y = height - 10;
-
-    // Увеличиваем ширину рамки
-    int frame_width = 44;
-    int start_x = (width - frame_width) / 2;
-
-    // Рисуем рамку со скругленными углами
-    console_.setColor(ConsoleHandler::COLOR_UNTYPED);
-    console_.moveCursor(keyboard_y, start_x);
-    console_.displayText("╭──────────────────────────────────────────╮");
-
-    for (int i = 1; i < 4; i++)
-    {
-        console_.moveCursor(keyboard_y + i, start_x);
-        console_.displayText("│");
-        console_.moveCursor(keyboard_y + i, start_x + frame_width - 1);
-        console_.displayText("│");
-    }
-
-    console_.moveCursor(keyboard_y + 4, start_x);
-    console_.displayText("╰──────────────────────────────────────────╯");
-
-    // Функция для отрисовки ряда клавиш
-    auto drawRow = [&](const std::vector<std::pair<std::string, int>> &row, int y)
-    {
-        for (const auto &[key, x] : row)
-        {
-            console_.moveCursor(y, start_x + x + 2);
-            console_.displayText(key);
-        }
-    };
-
-    // Отрисовываем все ряды клавиш
-    console_.setColor(ConsoleHandler::COLOR_UNTYPED);
-    drawRow(row1, keyboard_y + 1);
-    drawRow(row2, keyboard_y + 2);
-    drawRow(row3, keyboard_y + 3);
-
-    // Подсвечиваем текущую клавишу
-    std::string current = wcharToUtf8(std::towupper(currentChar));
-
-    for (const auto &rows : {row1, row2, row3})
-    {
-        for (const auto &[key, x] : rows)
-        {
-            if (key == current)
-            {
-                int y = keyboard_y + (rows == row1 ? 1 : rows == row2 ? 2
-                                                                      : 3);
-                console_.moveCursor(y, start_x + x + 2);
-                console_.setColor(ConsoleHandler::COLOR_CURRENT);
-                console_.displayText(key);
-                break;
-            }
-        }
-    }
-
-    console_.resetColor();
-}
\ No newline at end of file
@@ -1,33 +1,114 @@
 #pragma once
 #include "text_provider.h"
 #include "console_handler.h"
+#include "keystroke_log.h"
+#include "keyboard_layout.h"
+#include "typing_engine.h"
+#include "ngram_index.h"
+#include "difficulty_index.h"
+#include "weakness_model.h"
+#include "stats_history.h"
+#include "text_stream.h"
+#include "word_sampler.h"
+#include "word_stream.h"
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
 #include <string>
+#include <vector>
 
 class TypingSession
 {
 public:
-    TypingSession(TextProvider &provider, ConsoleHandler &console, const std::string &language);
+    // layout - раскладка для экранной клавиатуры; nullptr - выбирать по алфавиту текста
+    TypingSession(TextProvider &provider, ConsoleHandler &console, const std::string &language,
+                  const KeyboardLayout *layout = nullptr);
     void start();
 
+    // Нажатия в цикле набора и выделения памяти при их обработке (при сборке с ALLOC_COUNT=1)
+    uint64_t getKeystrokeCount() const { return engine_.keystrokeCount(); }
+    uint64_t getKeystrokeAllocations() const { return engine_.keystrokeAllocations(); }
+
+    // Задержки обработки нажатий по этапам и оверлей с ними (F2)
+    const LatencyProfile &getLatency() const { return latency_; }
+    void setLatencyOverlay(bool visible) { engine_.setLatencyOverlay(visible); }
+
+    // Тренировка n-грамм: тексты берутся по очереди из самых богатых ими текстов корпуса
+    // длиной [min_length, max_length]
+    void setDrill(const NgramIndex *index, std::vector<uint64_t> keys, uint32_t min_length, uint32_t max_length);
+
+    // Тексты полосы сложности band (1..DifficultyIndex::BAND_COUNT), кроме недавно набранных
+    void setDifficulty(const DifficultyIndex *index, int band);
+
+    // Подбор текстов по слабым местам: больше практики на символах и парах с наибольшей
+    // долей ошибок и самым медленным набором. Пока данных мало, тексты случайные
+    void setAdaptive(const NgramIndex *index, uint32_t min_length, uint32_t max_length);
+    const WeaknessModel &getWeakness() const { return weakness_; }
+
+    // Длинный текст: абзацы корпуса подряд со случайного, в окне из нескольких строк с прокруткой.
+    // Раунд идет до конца корпуса или до ESC, результат считается по набранному
+    void setLongText(bool enabled) { longText_ = enabled; }
+
+    // Тест на время: seconds секунд бесконечного потока частых слов языка (0 - выключен).
+    // Результаты идут в отдельную историю <язык>_time<seconds>; прерванный по ESC тест не сохраняется
+    void setTimed(int seconds);
+
+    // Результат раунда в историю; session_id - идентификатор сессии из журнала нажатий (0 - новый)
+    static void saveResults(StatsHistory &history, const std::string &text, int errors, int totalChars,
+                            std::chrono::duration<double> duration, uint64_t session_id = 0);
+    // Экран результатов раунда с подсказкой; history уже содержит результат (nullptr - без сравнения).
+    // Ничего не сохраняет, поэтому вызывается повторно при смене размера экрана и окна графика view
+    static void displayResults(Renderer &console, const StatsHistory *history,
+                               int errors, int totalChars, std::chrono::duration<double> duration,
+                               HistoryChart::View *view = nullptr);
+
 private:
     TextProvider &textProvider_;
     ConsoleHandler &console_;
     std::string language_;
-    std::string text_;
-
-    void displayRealtimeStats(int errors, int totalChars,
-                              std::chrono::steady_clock::time_point startTime,
-                              size_t currentPos);
-    void displayErrorChar(int y, int x, char expected);
-    void displayStats(int errors, int totalChars,
-                      std::chrono::seconds duration);
-    double calculateCPM(int totalChars, std::chrono::seconds duration);
-    double calculateCurrentCPM(int chars, const std::chrono::steady_clock::time_point &startTime);
-    double calculateAccuracy(int errors, int totalChars);
-    std::string wcharToUtf8(wchar_t wc);
-    void displayKeyboard(wchar_t currentChar);
-    bool isRussianLetter(wchar_t c);
-    bool isEnglishLetter(wchar_t c);
-    void displayKeyboard(wchar_t currentChar, bool is_russian);
+    const KeyboardLayout *layout_;
+    StatsHistory history_;
+    DecodedText text_;
+    TextStream stream_;
+    bool longText_ = false;
+    int timedSeconds_ = 0;
+    std::unique_ptr<WordSampler> words_;
+    std::unique_ptr<WordStream> wordStream_;
+    std::unique_ptr<StatsHistory> timedHistory_;
+    std::string typedText_;
+    // Модель объявлена до журнала: журнал при разрушении передает ей последний блок
+    WeaknessModel weakness_;
+    KeystrokeLog keystrokeLog_;
+    LatencyProfile latency_;
+    TypingEngine engine_;
+
+    const NgramIndex *drillIndex_ = nullptr;
+    std::vector<uint64_t> drillKeys_;
+    uint32_t drillMinLength_ = 0;
+    uint32_t drillMaxLength_ = 0;
+    std::vector<NgramIndex::Match> drillMatches_;
+    size_t drillRound_ = 0;
+
+    const DifficultyIndex *difficultyIndex_ = nullptr;
+    int difficultyBand_ = 0;
+    // Последние выданные тексты полосы, по кругу
+    std::vector<uint32_t> recentTexts_;
+    size_t recentNext_ = 0;
+
+    const NgramIndex *adaptiveIndex_ = nullptr;
+    uint32_t adaptiveMinLength_ = 0;
+    uint32_t adaptiveMaxLength_ = 0;
+    size_t adaptiveRound_ = 0;
+    uint32_t lastText_ = UINT32_MAX;
+    std::vector<WeaknessModel::Unit> weakUnits_;
+    std::vector<uint64_t> weakKeys_;
+    std::vector<NgramIndex::Match> adaptiveMatches_;
+    std::minstd_rand gen_;
+
+    void drawStartScreen();
+    void nextText();
+    bool nextWeakText();
+
+    static double calculateCPM(int totalChars, std::chrono::duration<double> duration);
 };
\ No newline at end of file
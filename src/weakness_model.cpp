@@ -0,0 +1,235 @@
+#include "weakness_model.h"
+#include "ngram_index.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    // Окно скользящего среднего: первые WINDOW наблюдений усредняются честно,
+    // дальше старые постепенно забываются, и модель следит за прогрессом
+    const uint32_t WINDOW = 64;
+    // Интервалы длиннее считаются паузой, а не скоростью набора
+    const float MAX_INTERVAL_MS = 2000.0f;
+    // Во сколько миллисекунд обходится ошибка (остановка, исправление, сбитый ритм)
+    const float ERROR_PENALTY_MS = 1000.0f;
+    // Вес средней цены при малом числе наблюдений: редкие единицы не всплывают из-за одной ошибки
+    const float PRIOR_ATTEMPTS = 8.0f;
+    // Меньше наблюдений - единица не попадает в слабые
+    const uint32_t MIN_ATTEMPTS = 3;
+    // Заполненность таблицы, после которой новые единицы не добавляются
+    const uint32_t MAX_USED = WeaknessModel::CAPACITY / 4 * 3;
+
+    bool isSeparator(uint32_t c)
+    {
+        return c < 0x20 || c == L' ' || c == 0xA0;
+    }
+}
+
+WeaknessModel::WeaknessModel(const std::string &language)
+    : filename_(getModelFilename(language)), table_(CAPACITY)
+{
+    load();
+}
+
+std::string WeaknessModel::getModelFilename(const std::string &language)
+{
+    return "stats/" + language + "_weakness.bin";
+}
+
+void WeaknessModel::load()
+{
+    std::memcpy(header_.magic, "WEAK", 4);
+    header_.version = FORMAT_VERSION;
+    header_.capacity = CAPACITY;
+    header_.entry_size = sizeof(WeaknessEntry);
+
+    // Файл другого формата или поврежденный просто начинается заново
+    std::ifstream file(filename_, std::ios::binary);
+    if (!file)
+        return;
+    WeaknessModelHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, "WEAK", 4) != 0 || header.version != FORMAT_VERSION ||
+        header.capacity != CAPACITY || header.entry_size != sizeof(WeaknessEntry))
+        return;
+    std::vector<WeaknessEntry> table(CAPACITY);
+    if (!file.read(reinterpret_cast<char *>(table.data()), CAPACITY * sizeof(WeaknessEntry)))
+        return;
+
+    header_ = header;
+    table_.swap(table);
+    used_ = static_cast<uint32_t>(std::count_if(table_.begin(), table_.end(),
+                                                [](const WeaknessEntry &entry)
+                                                { return entry.key != 0; }));
+}
+
+void WeaknessModel::save() const
+{
+    std::error_code ignored;
+    std::filesystem::create_directories(std::filesystem::path(filename_).parent_path(), ignored);
+
+    std::string tmp = filename_ + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return;
+        file.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+        file.write(reinterpret_cast<const char *>(table_.data()), CAPACITY * sizeof(WeaknessEntry));
+        if (!file)
+        {
+            file.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    std::rename(tmp.c_str(), filename_.c_str());
+}
+
+WeaknessEntry *WeaknessModel::slot(uint64_t key)
+{
+    size_t mask = CAPACITY - 1;
+    size_t index = (key * 0x9E3779B97F4A7C15ull) >> 20 & mask;
+    while (table_[index].key != key)
+    {
+        if (table_[index].key == 0)
+        {
+            if (used_ >= MAX_USED)
+                return nullptr;
+            used_++;
+            table_[index].key = key;
+            return &table_[index];
+        }
+        index = (index + 1) & mask;
+    }
+    return &table_[index];
+}
+
+const WeaknessEntry *WeaknessModel::find(uint64_t key) const
+{
+    if (key == 0)
+        return nullptr;
+    size_t mask = CAPACITY - 1;
+    size_t index = (key * 0x9E3779B97F4A7C15ull) >> 20 & mask;
+    while (table_[index].key != key)
+    {
+        if (table_[index].key == 0)
+            return nullptr;
+        index = (index + 1) & mask;
+    }
+    return &table_[index];
+}
+
+void WeaknessModel::update(WeaknessEntry &entry, bool error, float latency_ms)
+{
+    entry.attempts++;
+    entry.error_rate += ((error ? 1.0f : 0.0f) - entry.error_rate) / std::min(entry.attempts, WINDOW);
+    if (latency_ms > 0.0f)
+    {
+        entry.timed++;
+        entry.latency_ms += (latency_ms - entry.latency_ms) / std::min(entry.timed, WINDOW);
+    }
+}
+
+void WeaknessModel::update(uint64_t key, bool error, float latency_ms)
+{
+    if (key == 0)
+        return;
+    if (WeaknessEntry *entry = slot(key))
+        update(*entry, error, latency_ms);
+}
+
+void WeaknessModel::observe(const KeystrokeEvent *events, size_t count, bool last)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const KeystrokeEvent &event = events[i];
+        bool correct = (event.flags & KeystrokeLog::KEYSTROKE_CORRECT) != 0;
+
+        // Ошибкой считается неверная первая попытка на позиции
+        if (event.position != last_position_)
+        {
+            if (event.position != last_position_ + 1)
+            {
+                previous_char_ = 0;
+                previous_ns_ = 0;
+            }
+            last_position_ = event.position;
+            position_failed_ = !correct;
+        }
+        if (!correct)
+            continue;
+
+        // Позиция пройдена: интервал считается от правильного ввода предыдущего символа
+        float latency_ms = 0.0f;
+        if (previous_ns_ != 0 && event.timestamp_ns > previous_ns_)
+        {
+            latency_ms = (event.timestamp_ns - previous_ns_) / 1e6f;
+            if (latency_ms > MAX_INTERVAL_MS)
+                latency_ms = 0.0f;
+        }
+
+        update(header_.total, position_failed_, latency_ms);
+        if (!isSeparator(event.expected))
+        {
+            wchar_t gram[2] = {static_cast<wchar_t>(previous_char_), static_cast<wchar_t>(event.expected)};
+            update(NgramIndex::key(std::wstring_view(gram + 1, 1)), position_failed_, latency_ms);
+            if (previous_char_ != 0 && !isSeparator(previous_char_))
+                update(NgramIndex::key(std::wstring_view(gram, 2)), position_failed_, latency_ms);
+        }
+
+        previous_char_ = event.expected;
+        previous_ns_ = event.timestamp_ns;
+    }
+
+    if (last)
+    {
+        header_.sessions++;
+        last_position_ = UINT32_MAX;
+        position_failed_ = false;
+        previous_char_ = 0;
+        previous_ns_ = 0;
+    }
+}
+
+float WeaknessModel::cost(const WeaknessEntry &entry) const
+{
+    const WeaknessEntry &total = header_.total;
+    float total_cost = total.latency_ms + total.error_rate * ERROR_PENALTY_MS;
+    float latency = entry.timed ? entry.latency_ms : total.latency_ms;
+    float raw = latency + entry.error_rate * ERROR_PENALTY_MS;
+    // Оценка стягивается к средней, пока наблюдений мало
+    float weight = static_cast<float>(std::min(entry.attempts, WINDOW));
+    return (weight * raw + PRIOR_ATTEMPTS * total_cost) / (weight + PRIOR_ATTEMPTS);
+}
+
+void WeaknessModel::weakest(size_t limit, std::vector<Unit> &out) const
+{
+    out.clear();
+    const WeaknessEntry &total = header_.total;
+    float total_cost = total.latency_ms + total.error_rate * ERROR_PENALTY_MS;
+    for (const WeaknessEntry &entry : table_)
+    {
+        if (entry.key == 0 || entry.attempts < MIN_ATTEMPTS)
+            continue;
+        float unit_cost = cost(entry);
+        if (unit_cost > total_cost)
+            out.push_back({entry.key, unit_cost});
+    }
+
+    auto worse = [](const Unit &a, const Unit &b)
+    {
+        return a.cost_ms > b.cost_ms || (a.cost_ms == b.cost_ms && a.key < b.key);
+    };
+    if (out.size() > limit)
+    {
+        std::partial_sort(out.begin(), out.begin() + limit, out.end(), worse);
+        out.resize(limit);
+    }
+    else
+    {
+        std::sort(out.begin(), out.end(), worse);
+    }
+}
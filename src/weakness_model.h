@@ -0,0 +1,83 @@
+#pragma once
+#include "keystroke_log.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Показатели одной единицы набора (символа или пары символов).
+// Формат записи в файле совпадает с раскладкой структуры
+struct WeaknessEntry
+{
+    uint64_t key;       // ключ NgramIndex::key; 0 - свободная ячейка
+    uint32_t attempts;  // сколько раз единицу набирали
+    uint32_t timed;     // сколько из них с замеренным интервалом
+    float error_rate;   // доля ошибок с первой попытки, скользящее среднее
+    float latency_ms;   // интервал от предыдущего символа, скользящее среднее
+};
+static_assert(sizeof(WeaknessEntry) == 24, "WeaknessEntry must stay 24 bytes");
+
+// Заголовок файла модели: за ним CAPACITY записей таблицы
+struct WeaknessModelHeader
+{
+    char magic[4];      // "WEAK"
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t entry_size; // sizeof(WeaknessEntry)
+    uint64_t sessions;
+    WeaknessEntry total; // все нажатия вместе, key = 0
+    uint8_t padding[16];
+};
+static_assert(sizeof(WeaknessModelHeader) == 64, "WeaknessModelHeader must stay 64 bytes");
+
+// Модель слабых мест пользователя: доля ошибок и средний интервал для каждого символа
+// и каждой пары символов текста (ключи NgramIndex, без учета регистра, без пробелов).
+// Таблица фиксированного размера с открытой адресацией, хранится в stats/<язык>_weakness.bin
+// и обновляется по блокам журнала нажатий, то есть между нажатиями не стоит ничего
+class WeaknessModel
+{
+public:
+    static const uint32_t FORMAT_VERSION = 1;
+    static const uint32_t CAPACITY = 8192;
+
+    struct Unit
+    {
+        uint64_t key;
+        float cost_ms; // ожидаемая цена символа: интервал плюс штраф за ошибку
+    };
+
+    explicit WeaknessModel(const std::string &language);
+
+    // События одного блока журнала; last - блок завершает сессию
+    void observe(const KeystrokeEvent *events, size_t count, bool last);
+
+    // До limit самых слабых единиц (дороже средней), худшие первыми; out переиспользуется
+    void weakest(size_t limit, std::vector<Unit> &out) const;
+
+    // Единица по ключу или nullptr, если ее еще не набирали
+    const WeaknessEntry *find(uint64_t key) const;
+    const WeaknessEntry &total() const { return header_.total; }
+    uint64_t sessions() const { return header_.sessions; }
+
+    // Запись на диск через временный файл; ошибки записи не мешают тренировке
+    void save() const;
+
+    static std::string getModelFilename(const std::string &language);
+
+private:
+    void load();
+    WeaknessEntry *slot(uint64_t key);
+    void update(uint64_t key, bool error, float latency_ms);
+    static void update(WeaknessEntry &entry, bool error, float latency_ms);
+    float cost(const WeaknessEntry &entry) const;
+
+    std::string filename_;
+    WeaknessModelHeader header_{};
+    std::vector<WeaknessEntry> table_;
+    uint32_t used_ = 0;
+
+    // Состояние текущей сессии между блоками журнала
+    uint32_t last_position_ = UINT32_MAX; // позиция последнего нажатия
+    bool position_failed_ = false;        // на этой позиции уже была ошибка
+    uint32_t previous_char_ = 0;          // символ предыдущей позиции
+    uint64_t previous_ns_ = 0;            // время правильного ввода предыдущей позиции
+};
@@ -0,0 +1,165 @@
+#include "word_sampler.h"
+#include <algorithm>
+#include <cwctype>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    // Частоты по корпусу считаются не дальше этого размера: оценки хватает, а запуск не ждет
+    const size_t WORD_SCAN_BYTES = 8 << 20;
+
+    bool isWordChar(wchar_t c)
+    {
+        return std::iswalpha(c) || c == L'\'' || c == L'-' || c == 0x2019;
+    }
+
+    // Слово без окружающей пунктуации в нижнем регистре; пустое, если это не слово
+    void normalizeWord(std::wstring &word)
+    {
+        size_t first = 0;
+        size_t last = word.size();
+        while (first < last && !std::iswalnum(word[first]))
+            ++first;
+        while (last > first && !std::iswalnum(word[last - 1]))
+            --last;
+        word = word.substr(first, last - first);
+        for (wchar_t &c : word)
+        {
+            if (!isWordChar(c))
+            {
+                word.clear();
+                return;
+            }
+            c = std::towlower(c);
+        }
+    }
+}
+
+WordSampler::WordSampler(const TextProvider &provider, const std::string &language)
+{
+    std::vector<std::pair<std::wstring, uint64_t>> words;
+    loadList(getWordsFilename(language), words);
+    if (words.empty())
+        countCorpus(provider, words);
+    if (words.empty())
+        throw std::runtime_error("Нет слов для теста на время: " + provider.getFilename());
+
+    // Самые частые слова; при равной частоте порядок не зависит от хеш-таблицы
+    std::sort(words.begin(), words.end(), [](const auto &a, const auto &b)
+              { return a.second > b.second || (a.second == b.second && a.first < b.first); });
+    if (words.size() > MAX_WORDS)
+        words.resize(MAX_WORDS);
+
+    std::string utf8;
+    starts_.reserve(words.size() + 1);
+    counts_.reserve(words.size());
+    size_t chars = 0;
+    for (const auto &[word, count] : words)
+    {
+        starts_.push_back(static_cast<uint32_t>(chars));
+        counts_.push_back(count);
+        encodeUtf8(word, utf8);
+        chars += word.size();
+    }
+    starts_.push_back(static_cast<uint32_t>(chars));
+    text_.assign(utf8);
+
+    buildAliasTable();
+}
+
+std::string WordSampler::getWordsFilename(const std::string &language)
+{
+    return "data/words/" + language + ".words";
+}
+
+void WordSampler::loadList(const std::string &filename, std::vector<std::pair<std::wstring, uint64_t>> &words)
+{
+    std::ifstream file(filename);
+    std::string line;
+    std::wstring word;
+    while (std::getline(file, line))
+    {
+        // "слово частота"; без частоты слово считается встреченным один раз
+        size_t space = line.find_last_of(" \t");
+        uint64_t count = 1;
+        if (space != std::string::npos && line.find_first_not_of("0123456789", space + 1) == std::string::npos &&
+            space + 1 < line.size())
+        {
+            count = std::stoull(line.substr(space + 1));
+            line.resize(space);
+        }
+        decodeUtf8(line, word);
+        normalizeWord(word);
+        if (!word.empty() && count > 0)
+            words.emplace_back(word, count);
+    }
+}
+
+void WordSampler::countCorpus(const TextProvider &provider, std::vector<std::pair<std::wstring, uint64_t>> &words)
+{
+    std::string_view data = provider.getData();
+    if (data.size() > WORD_SCAN_BYTES)
+    {
+        size_t eol = data.rfind('\n', WORD_SCAN_BYTES);
+        data = data.substr(0, eol == std::string_view::npos ? WORD_SCAN_BYTES : eol);
+    }
+
+    std::unordered_map<std::wstring, uint64_t> counts;
+    std::wstring word;
+    size_t pos = 0;
+    while (pos <= data.size())
+    {
+        wchar_t c = pos < data.size() ? decodeUtf8Char(data, pos) : (++pos, L' ');
+        if (!std::iswspace(c))
+        {
+            word.push_back(c);
+            continue;
+        }
+        normalizeWord(word);
+        if (!word.empty())
+            counts[word]++;
+        word.clear();
+    }
+    words.assign(counts.begin(), counts.end());
+}
+
+void WordSampler::buildAliasTable()
+{
+    // Метод Vose: каждый столбец заполняется до 1/n долей своего слова и одного "большого"
+    size_t n = counts_.size();
+    double total = 0;
+    for (uint64_t count : counts_)
+        total += static_cast<double>(count);
+
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    for (size_t i = 0; i < n; ++i)
+    {
+        scaled[i] = counts_[i] * static_cast<double>(n) / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+
+    const double SCALE = 4294967296.0; // 2^32
+    threshold_.assign(n, static_cast<uint64_t>(SCALE));
+    alias_.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        alias_[i] = static_cast<uint32_t>(i);
+    while (!small.empty() && !large.empty())
+    {
+        uint32_t less = small.back();
+        small.pop_back();
+        uint32_t more = large.back();
+        threshold_[less] = static_cast<uint64_t>(scaled[less] * SCALE);
+        alias_[less] = more;
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // Остаток из-за округления - столбцы, целиком занятые своим словом (threshold = 2^32)
+}
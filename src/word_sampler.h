@@ -0,0 +1,52 @@
+#pragma once
+#include "decoded_text.h"
+#include "text_provider.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Частотный список слов языка и выбор слова пропорционально частоте за O(1).
+// Список берется из data/words/<язык>.words ("слово частота" в строке), а без него считается
+// по словам корпуса. Таблица псевдонимов (метод Vose) строится один раз при загрузке:
+// выбор слова - одно 64-битное случайное число, умножение и сравнение
+class WordSampler
+{
+public:
+    // Слов в списке не больше: редкий хвост корпуса тесту не нужен
+    static const size_t MAX_WORDS = 10000;
+
+    WordSampler(const TextProvider &provider, const std::string &language);
+
+    static std::string getWordsFilename(const std::string &language);
+
+    size_t size() const { return counts_.size(); }
+    uint64_t count(size_t word) const { return counts_[word]; }
+
+    // Случайное слово с вероятностью, пропорциональной частоте
+    size_t sample(std::mt19937_64 &gen) const
+    {
+        uint64_t r = gen();
+        // Старшие 32 бита выбирают столбец таблицы, младшие - между ним и его псевдонимом
+        size_t column = static_cast<size_t>(((r >> 32) * counts_.size()) >> 32);
+        return (r & 0xFFFFFFFFu) < threshold_[column] ? column : alias_[column];
+    }
+
+    // Слова подряд без разделителей, уже разобранные: символы, ширины и байты UTF-8.
+    // Слово word занимает символы [begin(word), end(word))
+    const DecodedText &text() const { return text_; }
+    size_t begin(size_t word) const { return starts_[word]; }
+    size_t end(size_t word) const { return starts_[word + 1]; }
+
+private:
+    void loadList(const std::string &filename, std::vector<std::pair<std::wstring, uint64_t>> &words);
+    void countCorpus(const TextProvider &provider, std::vector<std::pair<std::wstring, uint64_t>> &words);
+    void buildAliasTable();
+
+    DecodedText text_;
+    std::vector<uint32_t> starts_;
+    std::vector<uint64_t> counts_;
+    // Столбец i выбирает себя, если младшие 32 бита меньше threshold_[i], иначе alias_[i]
+    std::vector<uint64_t> threshold_;
+    std::vector<uint32_t> alias_;
+};
@@ -0,0 +1,127 @@
+#include "word_stream.h"
+#include <algorithm>
+
+WordStream::WordStream(const WordSampler &sampler)
+    : sampler_(sampler), ring_(RING_WORDS) {}
+
+void WordStream::reset(uint64_t seed)
+{
+    gen_.seed(seed);
+    generated_ = 0;
+    position_ = Position();
+    generate(LOOKAHEAD_WORDS);
+}
+
+void WordStream::generate(uint64_t until)
+{
+    while (generated_ < until)
+    {
+        ring_[generated_ % RING_WORDS] = static_cast<uint32_t>(sampler_.sample(gen_));
+        generated_++;
+    }
+}
+
+bool WordStream::nextLine(int width, DecodedText &out)
+{
+    // Запас слов вперед пополняется до того, как строка понадобится
+    generate(position_.item + LOOKAHEAD_WORDS);
+
+    out.utf8.clear();
+    out.chars.clear();
+    out.widths.clear();
+    out.columns.clear();
+    out.byte_offsets.clear();
+    out.width = 0;
+
+    const DecodedText &words = sampler_.text();
+    uint64_t item = position_.item;
+    uint32_t offset = position_.offset;
+    while (true)
+    {
+        generate(item + 1);
+        size_t w = word(item);
+        size_t first = sampler_.begin(w) + offset;
+        size_t last = sampler_.end(w);
+
+        // Слово целиком переходит на следующую строку, если в этой уже что-то есть
+        uint32_t rest = words.columns[last - 1] + words.widths[last - 1] - words.columns[first];
+        if (!out.chars.empty() && out.width + rest > static_cast<uint32_t>(width))
+            break;
+
+        for (size_t i = first; i < last; ++i)
+        {
+            int cw = words.widths[i];
+            if (cw == 0 && out.chars.empty())
+                cw = 1;
+            if (cw > 0 && !out.chars.empty() && out.width + cw > static_cast<uint32_t>(width))
+            {
+                // Слово длиннее строки: продолжение - на следующей
+                position_ = {item, static_cast<uint32_t>(i - sampler_.begin(w))};
+                out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+                return true;
+            }
+            out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+            out.utf8.append(words.utf8, words.byte_offsets[i], words.byte_offsets[i + 1] - words.byte_offsets[i]);
+            out.columns.push_back(cw == 0 ? out.columns.back() : out.width);
+            out.chars.push_back(words.chars[i]);
+            out.widths.push_back(static_cast<uint8_t>(cw));
+            out.width += cw;
+        }
+
+        // Пробел после слова остается в конце строки, даже если выступает за ширину
+        out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+        out.utf8.push_back(' ');
+        out.columns.push_back(out.width);
+        out.chars.push_back(L' ');
+        out.widths.push_back(1);
+        out.width += 1;
+        item++;
+        offset = 0;
+        if (out.width >= static_cast<uint32_t>(width))
+            break;
+    }
+    position_ = {item, offset};
+    out.byte_offsets.push_back(static_cast<uint32_t>(out.utf8.size()));
+    return true;
+}
+
+LineSource::Position WordStream::locate(const Position &start, const DecodedText &line, size_t pos) const
+{
+    // В словах нет пробелов: каждый пробел строки закрывает слово
+    Position position = start;
+    for (size_t i = 0; i < pos; ++i)
+    {
+        if (line.chars[i] == L' ')
+        {
+            position.item++;
+            position.offset = 0;
+        }
+        else
+        {
+            position.offset++;
+        }
+    }
+    return position;
+}
+
+void WordStream::copy(const Position &position, std::string &out) const
+{
+    out.clear();
+    const DecodedText &words = sampler_.text();
+    uint64_t first = generated_ > RING_WORDS ? generated_ - RING_WORDS : 0;
+    for (uint64_t item = std::max(first, position.item > RING_WORDS ? position.item - RING_WORDS : 0);
+         item < position.item; ++item)
+    {
+        size_t w = word(item);
+        out.append(words.utf8, words.byte_offsets[sampler_.begin(w)],
+                   words.byte_offsets[sampler_.end(w)] - words.byte_offsets[sampler_.begin(w)]);
+        out += ' ';
+    }
+    if (position.offset > 0 && position.item < generated_)
+    {
+        size_t w = word(position.item);
+        size_t begin = sampler_.begin(w);
+        out.append(words.utf8, words.byte_offsets[begin],
+                   words.byte_offsets[begin + position.offset] - words.byte_offsets[begin]);
+    }
+}
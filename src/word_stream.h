@@ -0,0 +1,46 @@
+#pragma once
+#include "line_source.h"
+#include "word_sampler.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Бесконечный поток слов для теста на время. Слова выбираются WordSampler по частоте
+// и складываются в кольцевой буфер с запасом вперед, поэтому к переходу курсора на новую
+// строку следующий экран слов уже готов. Позиция - номер слова от начала теста и символ в нем
+class WordStream : public LineSource
+{
+public:
+    // Слов в кольце: столько последних слов можно перенести заново и сохранить в истории
+    static const size_t RING_WORDS = 1024;
+    // Столько слов заготавливается вперед от начала выдаваемой строки - больше окна
+    static const size_t LOOKAHEAD_WORDS = 128;
+
+    explicit WordStream(const WordSampler &sampler);
+
+    // Новый поток слов
+    void reset(uint64_t seed);
+
+    // Слова через пробел; слово длиннее строки переносится посередине
+    bool nextLine(int width, DecodedText &out) override;
+    Position tell() const override { return position_; }
+    void seek(const Position &position) override { position_ = position; }
+    Position locate(const Position &start, const DecodedText &line, size_t pos) const override;
+
+    // У потока нет конца
+    int progress(const Position &) const override { return -1; }
+    // Последние RING_WORDS слов до position через пробел
+    void copy(const Position &position, std::string &out) const override;
+
+private:
+    size_t word(uint64_t index) const { return ring_[index % RING_WORDS]; }
+    // Дописывает в кольцо слова до номера until (не включая)
+    void generate(uint64_t until);
+
+    const WordSampler &sampler_;
+    std::mt19937_64 gen_;
+    std::vector<uint32_t> ring_;
+    uint64_t generated_ = 0;
+    Position position_;
+};